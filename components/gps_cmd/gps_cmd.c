@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include "gps_cmd.h"
+
+static const uint32_t bauds[] = {4800, 9600, 14400, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+static bool valid_baud(uint32_t baud)
+{
+    for (size_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++) {
+        if (bauds[i] == baud) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Completes "$<body>" in cmd with "*hh\r\n"
+static gps_status_t pmtk_finish(gps_cmd_t *cmd, int len)
+{
+    uint8_t checksum = 0;
+
+    if (len <= 0 || len + 5 > GPS_CMD_MAX_LENGTH) {
+        return GPS_MEM_LOW;
+    }
+    for (int i = 1; i < len; i++) {
+        checksum ^= cmd->data[i];
+    }
+    snprintf((char *)cmd->data + len, GPS_CMD_MAX_LENGTH - len, "*%02X\r\n", checksum);
+    cmd->len = len + 5;
+    return GPS_OKAY;
+}
+
+gps_status_t gps_cmd_pmtk_baud(uint32_t baud, gps_cmd_t *cmd)
+{
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    if (!valid_baud(baud)) {
+        return GPS_INV_ARG;
+    }
+    return pmtk_finish(cmd, snprintf((char *)cmd->data, GPS_CMD_MAX_LENGTH, "$PMTK251,%lu", (unsigned long)baud));
+}
+
+gps_status_t gps_cmd_pmtk_rate(uint16_t period_ms, gps_cmd_t *cmd)
+{
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    if (period_ms < 100 || period_ms > 10000) {
+        return GPS_INV_ARG;
+    }
+    return pmtk_finish(cmd, snprintf((char *)cmd->data, GPS_CMD_MAX_LENGTH, "$PMTK220,%u", period_ms));
+}
+
+gps_status_t gps_cmd_pmtk_sentences(uint32_t mask, gps_cmd_t *cmd)
+{
+    // PMTK314 fields in order, 19 in total, the ones after GSV are not used here
+    static const gps_sentence_t order[] = {GPS_SENTENCE_GLL, GPS_SENTENCE_RMC, GPS_SENTENCE_VTG,
+                                           GPS_SENTENCE_GGA, GPS_SENTENCE_GSA, GPS_SENTENCE_GSV};
+    char *out;
+    int len;
+
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    out = (char *)cmd->data;
+    len = snprintf(out, GPS_CMD_MAX_LENGTH, "$PMTK314");
+    for (int i = 0; i < 19; i++) {
+        bool on = i < (int)(sizeof(order) / sizeof(order[0])) && (mask & GPS_SENTENCE_BIT(order[i]));
+        out[len++] = ',';
+        out[len++] = on ? '1' : '0';
+    }
+    return pmtk_finish(cmd, len);
+}
+
+// Appends one UBX frame to cmd: sync, class, id, length, payload, Fletcher checksum
+static gps_status_t ubx_append(gps_cmd_t *cmd, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t *out = cmd->data + cmd->len;
+    uint8_t ck_a = 0, ck_b = 0;
+
+    if (cmd->len + len + 8 > GPS_CMD_MAX_LENGTH) {
+        return GPS_MEM_LOW;
+    }
+    out[0] = 0xB5;
+    out[1] = 0x62;
+    out[2] = cls;
+    out[3] = id;
+    out[4] = len & 0xFF;
+    out[5] = len >> 8;
+    memcpy(out + 6, payload, len);
+    for (uint16_t i = 2; i < len + 6; i++) {
+        ck_a += out[i];
+        ck_b += ck_a;
+    }
+    out[len + 6] = ck_a;
+    out[len + 7] = ck_b;
+    cmd->len += len + 8;
+    return GPS_OKAY;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+gps_status_t gps_cmd_ubx_baud(uint32_t baud, gps_cmd_t *cmd)
+{
+    uint8_t payload[20] = {0};
+
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    if (!valid_baud(baud)) {
+        return GPS_INV_ARG;
+    }
+    payload[0] = 1;                  // portID: UART1
+    put_u32(payload + 4, 0x000008D0); // mode: 8 data bits, no parity, 1 stop bit
+    put_u32(payload + 8, baud);
+    put_u16(payload + 12, 0x0007);   // inProtoMask: UBX, NMEA, RTCM
+    put_u16(payload + 14, 0x0003);   // outProtoMask: UBX, NMEA
+    cmd->len = 0;
+    return ubx_append(cmd, 0x06, 0x00, payload, sizeof(payload));
+}
+
+gps_status_t gps_cmd_ubx_rate(uint16_t period_ms, gps_cmd_t *cmd)
+{
+    uint8_t payload[6];
+
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    if (period_ms < 25) {
+        return GPS_INV_ARG;
+    }
+    put_u16(payload, period_ms);
+    put_u16(payload + 2, 1); // navRate: one fix per measurement
+    put_u16(payload + 4, 1); // timeRef: GPS time
+    cmd->len = 0;
+    return ubx_append(cmd, 0x06, 0x08, payload, sizeof(payload));
+}
+
+gps_status_t gps_cmd_ubx_sentences(uint32_t mask, gps_cmd_t *cmd)
+{
+    // Message ids of the NMEA class 0xF0
+    static const struct {
+        gps_sentence_t sentence;
+        uint8_t id;
+    } ids[] = {
+        {GPS_SENTENCE_GGA, 0x00}, {GPS_SENTENCE_GLL, 0x01}, {GPS_SENTENCE_GSA, 0x02},
+        {GPS_SENTENCE_GSV, 0x03}, {GPS_SENTENCE_RMC, 0x04}, {GPS_SENTENCE_VTG, 0x05},
+    };
+
+    if (cmd == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    cmd->len = 0;
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        uint8_t payload[3] = {0xF0, ids[i].id, (mask & GPS_SENTENCE_BIT(ids[i].sentence)) ? 1 : 0};
+        gps_status_t status = ubx_append(cmd, 0x06, 0x01, payload, sizeof(payload));
+        if (status != GPS_OKAY) {
+            return status;
+        }
+    }
+    return GPS_OKAY;
+}
+
+gps_status_t gps_cmd_baud(gps_cmd_protocol_t protocol, uint32_t baud, gps_cmd_t *cmd)
+{
+    return protocol == GPS_CMD_PROTOCOL_UBX ? gps_cmd_ubx_baud(baud, cmd) : gps_cmd_pmtk_baud(baud, cmd);
+}
+
+gps_status_t gps_cmd_rate(gps_cmd_protocol_t protocol, uint16_t period_ms, gps_cmd_t *cmd)
+{
+    return protocol == GPS_CMD_PROTOCOL_UBX ? gps_cmd_ubx_rate(period_ms, cmd) : gps_cmd_pmtk_rate(period_ms, cmd);
+}
+
+gps_status_t gps_cmd_sentences(gps_cmd_protocol_t protocol, uint32_t mask, gps_cmd_t *cmd)
+{
+    return protocol == GPS_CMD_PROTOCOL_UBX ? gps_cmd_ubx_sentences(mask, cmd) : gps_cmd_pmtk_sentences(mask, cmd);
+}
+
+gps_status_t gps_cmd_switch_baud(const gps_cmd_port_t *port, gps_cmd_protocol_t protocol, uint32_t from,
+                                 uint32_t to)
+{
+    gps_cmd_t cmd;
+    gps_status_t status;
+
+    if (port == NULL) {
+        return GPS_PTR_TO_NULL;
+    }
+    status = gps_cmd_baud(protocol, to, &cmd);
+    if (status != GPS_OKAY) {
+        return status;
+    }
+    port->set_baud(port->ctx, from);
+    if (port->wait_sentence(port->ctx, port->timeout_ms)) {
+        status = port->write(port->ctx, cmd.data, cmd.len);
+        if (status != GPS_OKAY) {
+            return status;
+        }
+    }
+    // The receiver answers at the new rate, or was already running at it
+    port->set_baud(port->ctx, to);
+    if (port->wait_sentence(port->ctx, port->timeout_ms)) {
+        return GPS_OKAY;
+    }
+    port->set_baud(port->ctx, from);
+    return GPS_TIMEOUT;
+}
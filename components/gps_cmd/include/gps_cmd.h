@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* Commands that configure the receiver: baud rate, navigation rate and the NMEA
+ * sentences it sends. MediaTek receivers take checksummed $PMTK sentences,
+ * u-blox receivers UBX-CFG messages with a Fletcher checksum. The encoders only
+ * build bytes, gps_cmd_switch_baud() sends them through a gps_cmd_port_t. */
+
+#define GPS_CMD_MAX_LENGTH (80)
+
+typedef enum {
+    GPS_CMD_PROTOCOL_MTK, /*!< $PMTK sentences */
+    GPS_CMD_PROTOCOL_UBX, /*!< UBX-CFG binary messages */
+} gps_cmd_protocol_t;
+
+typedef struct {
+    uint8_t data[GPS_CMD_MAX_LENGTH]; /*!< Bytes to write to the receiver */
+    uint8_t len;                      /*!< Bytes in data */
+} gps_cmd_t;
+
+/* $PMTK251: serial baud rate. */
+gps_status_t gps_cmd_pmtk_baud(uint32_t baud, gps_cmd_t *cmd);
+
+/* $PMTK220: fix interval, 100 to 10000 ms. */
+gps_status_t gps_cmd_pmtk_rate(uint16_t period_ms, gps_cmd_t *cmd);
+
+/* $PMTK314: sends the sentence types in mask (GPS_SENTENCE_BIT()) with every
+ * fix and disables all others. */
+gps_status_t gps_cmd_pmtk_sentences(uint32_t mask, gps_cmd_t *cmd);
+
+/* UBX-CFG-PRT: UART1 at baud, 8N1, UBX and NMEA in and out. */
+gps_status_t gps_cmd_ubx_baud(uint32_t baud, gps_cmd_t *cmd);
+
+/* UBX-CFG-RATE: measurement period, 25 to 65535 ms, one fix per measurement. */
+gps_status_t gps_cmd_ubx_rate(uint16_t period_ms, gps_cmd_t *cmd);
+
+/* UBX-CFG-MSG: one UBX-CFG-MSG per sentence type, the types in mask are sent
+ * with every fix on the current port, all others are disabled. */
+gps_status_t gps_cmd_ubx_sentences(uint32_t mask, gps_cmd_t *cmd);
+
+/* The same commands for either protocol. */
+gps_status_t gps_cmd_baud(gps_cmd_protocol_t protocol, uint32_t baud, gps_cmd_t *cmd);
+gps_status_t gps_cmd_rate(gps_cmd_protocol_t protocol, uint16_t period_ms, gps_cmd_t *cmd);
+gps_status_t gps_cmd_sentences(gps_cmd_protocol_t protocol, uint32_t mask, gps_cmd_t *cmd);
+
+/* What gps_cmd_switch_baud() needs from the serial port, so the sequence runs
+ * on the ESP32 UART as well as against a simulated receiver. */
+typedef struct {
+    gps_status_t (*write)(void *ctx, const uint8_t *data, size_t len); /*!< Returns once the bytes are sent */
+    void (*set_baud)(void *ctx, uint32_t baud);                        /*!< Changes the local baud rate */
+    bool (*wait_sentence)(void *ctx, uint32_t timeout_ms);             /*!< true when a valid sentence arrived */
+    void *ctx;                                                         /*!< User argument of the callbacks */
+    uint32_t timeout_ms;                                               /*!< How long to listen at a baud rate */
+} gps_cmd_port_t;
+
+/* Moves the receiver and the local port from baud from to baud to. A receiver
+ * that is silent at from but answers at to, e.g. after a restart of the ESP32
+ * alone, is left as it is. Returns GPS_TIMEOUT with the port back at from when
+ * the receiver is not heard at to after the command. */
+gps_status_t gps_cmd_switch_baud(const gps_cmd_port_t *port, gps_cmd_protocol_t protocol, uint32_t from,
+                                 uint32_t to);
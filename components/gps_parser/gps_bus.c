@@ -0,0 +1,121 @@
+#include "gps_bus.h"
+
+void gps_bus_init(gps_bus_t *bus)
+{
+    memset(bus, 0, sizeof(gps_bus_t));
+    for (int i = 0; i < GPS_BUS_MAX_SUBSCRIBERS; i++) {
+        atomic_init(&bus->slots[i].next, GPS_BUS_NONE);
+    }
+    for (int t = 0; t < GPS_TOPIC_MAX; t++) {
+        atomic_init(&bus->head[t], GPS_BUS_NONE);
+    }
+}
+
+gps_status_t gps_bus_subscribe(gps_bus_t *bus, uint8_t topic, gps_bus_cb_t cb, void *arg, uint8_t *handle)
+{
+    if (topic == GPS_SENTENCE_UNKNOWN || topic >= GPS_TOPIC_MAX || cb == NULL) {
+        return GPS_INV_ARG;
+    }
+    uint8_t free_slot = 0;
+    while (free_slot < GPS_BUS_MAX_SUBSCRIBERS && bus->slots[free_slot].cb != NULL) {
+        free_slot++;
+    }
+    if (free_slot == GPS_BUS_MAX_SUBSCRIBERS) {
+        return GPS_MEM_LOW;
+    }
+    gps_bus_slot_t *slot = &bus->slots[free_slot];
+    slot->cb = cb;
+    slot->arg = arg;
+    slot->topic = topic;
+    atomic_store_explicit(&slot->next, GPS_BUS_NONE, memory_order_relaxed);
+
+    // Appended, a dispatch sees the slot only once it is complete
+    _Atomic uint8_t *link = &bus->head[topic];
+    uint8_t i;
+    while ((i = atomic_load_explicit(link, memory_order_relaxed)) != GPS_BUS_NONE) {
+        link = &bus->slots[i].next;
+    }
+    atomic_store_explicit(link, free_slot, memory_order_release);
+    if (handle) {
+        *handle = free_slot;
+    }
+    return GPS_OKAY;
+}
+
+void gps_bus_unsubscribe(gps_bus_t *bus, uint8_t handle)
+{
+    if (handle >= GPS_BUS_MAX_SUBSCRIBERS || bus->slots[handle].cb == NULL) {
+        return;
+    }
+    gps_bus_slot_t *slot = &bus->slots[handle];
+    _Atomic uint8_t *link = &bus->head[slot->topic];
+    uint8_t i;
+    while ((i = atomic_load_explicit(link, memory_order_relaxed)) != handle) {
+        link = &bus->slots[i].next;
+    }
+    atomic_store_explicit(link, atomic_load_explicit(&slot->next, memory_order_relaxed), memory_order_release);
+    slot->cb = NULL;
+}
+
+static void notify(gps_bus_t *bus, gps_bus_msg_t *msg, uint8_t topic)
+{
+    uint8_t i = atomic_load_explicit(&bus->head[topic], memory_order_acquire);
+    msg->topic = topic;
+    while (i != GPS_BUS_NONE) {
+        const gps_bus_slot_t *slot = &bus->slots[i];
+        // Read first, the callback may unsubscribe itself
+        i = atomic_load_explicit(&slot->next, memory_order_acquire);
+        gps_bus_cb_t cb = slot->cb;
+        if (cb) {
+            bus->dispatched++;
+            cb(msg, slot->arg);
+        }
+    }
+}
+
+// 1 with a valid fix, 0 without, -1 for sentences that do not say or left their fix fields empty
+static int fix_status(const gps_t *data)
+{
+    if (!(data->fields & GPS_FIELD_FIX)) {
+        return -1;
+    }
+    switch (data->sentence) {
+        case GPS_SENTENCE_GGA:
+            return data->fix != GPS_FIX_INVALID;
+        case GPS_SENTENCE_RMC:
+        case GPS_SENTENCE_UBX_PVT:
+            return data->valid;
+        default:
+            return -1;
+    }
+}
+
+void gps_bus_dispatch(gps_bus_t *bus, const gps_t *data, const char *sentence, uint16_t len,
+                      const gps_fields_t *fields)
+{
+    if (data->status != GPS_OKAY || data->sentence == GPS_SENTENCE_UNKNOWN || data->sentence >= GPS_SENTENCE_MAX) {
+        return;
+    }
+    gps_bus_msg_t msg = {.data = data, .sentence = sentence, .len = len, .fields = fields};
+    notify(bus, &msg, data->sentence);
+
+    int fixed = fix_status(data);
+    if (fixed < 0) {
+        return;
+    }
+    if (fixed != bus->fixed) {
+        bus->fixed = fixed;
+        notify(bus, &msg, fixed ? GPS_EVENT_FIX_ACQUIRED : GPS_EVENT_FIX_LOST);
+    }
+    if (!fixed) {
+        return;
+    }
+    // Only what this sentence sent, the parser still holds the position and date of older ones
+    if (data->fields & GPS_FIELD_POSITION) {
+        notify(bus, &msg, GPS_EVENT_POSITION);
+    }
+    if (!bus->time_valid && (data->fields & GPS_FIELD_TIME) && (data->fields & GPS_FIELD_DATE)) {
+        bus->time_valid = true;
+        notify(bus, &msg, GPS_EVENT_TIME_VALID);
+    }
+}
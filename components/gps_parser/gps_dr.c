@@ -0,0 +1,133 @@
+#include <math.h>
+#include "gps_dr.h"
+
+#define DEG_TO_RAD    (0.017453292519943295f)
+#define KNOTS_TO_MPS  (0.514444f)
+#define E7_Q16_PER_MS (655360000.0f) /*!< 1e-7 degrees in Q16 per ms of one degree per second */
+#define LON_E7_TURN   (3600000000LL)
+#define LAT_E7_MAX    (900000000)
+
+// accel * dt^2 / 2 in cm for dt in ms, as a Q32 factor of dt^2
+#define ACCEL_Q32 ((uint64_t)GPS_DR_ACCEL_CM_S2 * 4294967296ULL / 2000000u)
+
+static inline int32_t clamp_i32(float v) {
+    return v > 2147483000.0f ? 2147483000 : v < -2147483000.0f ? -2147483000 : (int32_t)v;
+}
+
+// Longitude difference or sum brought back into [-180, 180) degrees
+static inline int32_t wrap_lon(int64_t lon_e7) {
+    if (lon_e7 >= LON_E7_TURN / 2) {
+        lon_e7 -= LON_E7_TURN;
+    } else if (lon_e7 < -LON_E7_TURN / 2) {
+        lon_e7 += LON_E7_TURN;
+    }
+    return (int32_t)lon_e7;
+}
+
+// Length of one degree of latitude and of longitude in meters on the WGS84 ellipsoid
+static void meters_per_degree(int32_t lat_e7, float *lat_m, float *lon_m)
+{
+    float phi = lat_e7 * 1e-7f * DEG_TO_RAD;
+    *lat_m = 111132.92f - 559.82f * cosf(2 * phi) + 1.175f * cosf(4 * phi);
+    *lon_m = 111412.84f * cosf(phi) - 93.5f * cosf(3 * phi);
+    // Closer than about 1 km to a pole the eastward speed is meaningless
+    if (*lon_m < 10.0f) {
+        *lon_m = 10.0f;
+    }
+}
+
+void gps_dr_init(gps_dr_t *dr, uint32_t max_age_ms, uint32_t blend_ms)
+{
+    memset(dr, 0, sizeof(gps_dr_t));
+    // The error estimate squares the age in 32 bits
+    dr->max_age_ms = max_age_ms > UINT16_MAX ? UINT16_MAX : max_age_ms;
+    dr->blend_ms = blend_ms;
+    dr->fix_error_cm = GPS_DR_UERE_CM;
+}
+
+bool gps_dr_update(gps_dr_t *dr, const gps_epoch_fix_t *fix, uint32_t now_ms)
+{
+    const gps_t *data = &fix->data;
+    uint32_t has = fix->sentences;
+
+    if (!(data->fields & GPS_FIELD_POSITION) ||
+        ((has & GPS_EPOCH_HAS_FIX) ? data->fix == GPS_FIX_INVALID : !data->valid) ||
+        (dr->valid && data->utc_ms <= dr->fix_ms)) {
+        return false;
+    }
+
+    float lat_m, lon_m;
+    meters_per_degree(data->latitude_e7, &lat_m, &lon_m);
+
+    // Where the last fix would have put us, faded out from here on
+    gps_dr_position_t predicted;
+    int32_t lat_offset = 0, lon_offset = 0;
+    bool recent = gps_dr_at(dr, data->utc_ms, &predicted);
+    if (recent && dr->blend_ms) {
+        lat_offset = predicted.lat_e7 - data->latitude_e7;
+        lon_offset = wrap_lon((int64_t)predicted.lon_e7 - data->longitude_e7);
+    }
+    dr->lat_offset = lat_offset;
+    dr->lon_offset = lon_offset;
+    dr->lat_fade = dr->blend_ms ? (int32_t)(((int64_t)lat_offset << 16) / dr->blend_ms) : 0;
+    dr->lon_fade = dr->blend_ms ? (int32_t)(((int64_t)lon_offset << 16) / dr->blend_ms) : 0;
+    dr->offset_cm = (uint32_t)(hypotf(lat_offset * lat_m, lon_offset * lon_m) * 1e-5f);
+    dr->offset_fade = dr->blend_ms ? (uint32_t)(((uint64_t)dr->offset_cm << 16) / dr->blend_ms) : 0;
+
+    if (data->fields & GPS_FIELD_COURSE) {
+        float speed = data->speed * KNOTS_TO_MPS;
+        float course = data->cog * DEG_TO_RAD;
+        dr->lat_rate = clamp_i32(speed * cosf(course) * E7_Q16_PER_MS / lat_m);
+        dr->lon_rate = clamp_i32(speed * sinf(course) * E7_Q16_PER_MS / lon_m);
+    } else if (recent) {
+        // GGA only, the speed between the last two fixes
+        int64_t dt = data->utc_ms - dr->fix_ms;
+        dr->lat_rate = (int32_t)(((int64_t)(data->latitude_e7 - dr->lat_e7) << 16) / dt);
+        dr->lon_rate = (int32_t)(((int64_t)wrap_lon((int64_t)data->longitude_e7 - dr->lon_e7) << 16) / dt);
+    } else {
+        dr->lat_rate = 0;
+        dr->lon_rate = 0;
+    }
+
+    float dop = !(data->fields & GPS_FIELD_DOP) ? 0.0f
+              : (has & GPS_EPOCH_HAS_HDOP) ? data->dop_h
+              : data->dop_p;
+    if (dop > 0.0f) {
+        dr->fix_error_cm = (uint32_t)(dop * GPS_DR_UERE_CM);
+    }
+    dr->fix_ms = data->utc_ms;
+    dr->fix_now_ms = now_ms;
+    dr->lat_e7 = data->latitude_e7;
+    dr->lon_e7 = data->longitude_e7;
+    dr->valid = true;
+    return true;
+}
+
+bool gps_dr_at(const gps_dr_t *dr, int64_t utc_ms, gps_dr_position_t *out)
+{
+    int64_t age = utc_ms - dr->fix_ms;
+    bool recent = dr->valid && age <= dr->max_age_ms && age >= -(int64_t)dr->max_age_ms;
+    int32_t dt = age > dr->max_age_ms ? (int32_t)dr->max_age_ms
+               : age < -(int64_t)dr->max_age_ms ? -(int32_t)dr->max_age_ms : (int32_t)age;
+
+    int64_t lat = dr->lat_e7 + (((int64_t)dr->lat_rate * dt) >> 16);
+    int64_t lon = dr->lon_e7 + (((int64_t)dr->lon_rate * dt) >> 16);
+    uint32_t offset_cm = 0;
+    if (dt <= 0) {
+        lat += dr->lat_offset;
+        lon += dr->lon_offset;
+        offset_cm = dr->offset_cm;
+    } else if ((uint32_t)dt < dr->blend_ms) {
+        lat += dr->lat_offset - (((int64_t)dr->lat_fade * dt) >> 16);
+        lon += dr->lon_offset - (((int64_t)dr->lon_fade * dt) >> 16);
+        offset_cm = dr->offset_cm - (uint32_t)(((uint64_t)dr->offset_fade * (uint32_t)dt) >> 16);
+    }
+    out->lat_e7 = lat > LAT_E7_MAX ? LAT_E7_MAX : lat < -LAT_E7_MAX ? -LAT_E7_MAX : (int32_t)lat;
+    out->lon_e7 = wrap_lon(lon);
+    out->age_ms = (int32_t)(age > INT32_MAX ? INT32_MAX : age < -INT32_MAX ? -INT32_MAX : age);
+
+    uint32_t dt2 = (uint32_t)(dt < 0 ? -dt : dt);
+    dt2 *= dt2;
+    out->error_cm = recent ? dr->fix_error_cm + offset_cm + (uint32_t)((dt2 * ACCEL_Q32) >> 32) : UINT32_MAX;
+    return recent;
+}
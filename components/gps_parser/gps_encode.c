@@ -0,0 +1,267 @@
+#include "gps_encode.h"
+
+#define SCRATCH (128) /*!< Longer than any sentence the encoders write, whatever the values */
+
+static const char talker_ids[][2] = {
+    [GPS_TALKER_UNKNOWN] = {'G', 'P'}, [GPS_TALKER_GP] = {'G', 'P'}, [GPS_TALKER_GL] = {'G', 'L'},
+    [GPS_TALKER_GA] = {'G', 'A'},      [GPS_TALKER_GB] = {'G', 'B'}, [GPS_TALKER_BD] = {'B', 'D'},
+    [GPS_TALKER_GQ] = {'G', 'Q'},      [GPS_TALKER_GI] = {'G', 'I'}, [GPS_TALKER_GN] = {'G', 'N'},
+};
+
+static const uint32_t powers_of_ten[] = {1, 10, 100, 1000, 10000, 100000};
+
+static char *put_uint(char *p, uint32_t value, uint8_t width)
+{
+    char digits[10];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n < width) {
+        digits[n++] = '0';
+    }
+    while (n) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+// value rounded to decimals digits after the point, e.g. "-40.6"
+static char *put_fixed(char *p, float value, uint8_t decimals)
+{
+    uint32_t scale = powers_of_ten[decimals];
+    float scaled = value < 0.0f ? -value * scale : value * scale;
+    uint32_t fixed = scaled >= 4.0e9f ? 4000000000u : (uint32_t)(scaled + 0.5f);
+
+    if (value < 0.0f && fixed) {
+        *p++ = '-';
+    }
+    p = put_uint(p, fixed / scale, 1);
+    *p++ = '.';
+    return put_uint(p, fixed % scale, decimals);
+}
+
+// "ddmm.mmmmm,N" or "dddmm.mmmmm,E" of 1e-7 degrees
+static char *put_coordinate(char *p, int32_t e7, uint8_t degree_digits, char positive, char negative)
+{
+    uint32_t value = e7 < 0 ? -(uint32_t)e7 : (uint32_t)e7;
+    uint32_t degrees = value / 10000000u;
+    // Minutes in 1e-5, rounded
+    uint32_t minutes = (uint32_t)(((uint64_t)(value % 10000000u) * 60u + 50u) / 100u);
+    if (minutes == 6000000u) {
+        degrees++;
+        minutes = 0;
+    }
+    p = put_uint(p, degrees, degree_digits);
+    p = put_uint(p, minutes / 100000u, 2);
+    *p++ = '.';
+    p = put_uint(p, minutes % 100000u, 5);
+    *p++ = ',';
+    *p++ = e7 < 0 ? negative : positive;
+    return p;
+}
+
+// "hhmmss.ss"
+static char *put_time(char *p, uint32_t time_ms)
+{
+    p = put_uint(p, time_ms / 3600000u, 2);
+    p = put_uint(p, time_ms / 60000u % 60u, 2);
+    p = put_uint(p, time_ms / 1000u % 60u, 2);
+    *p++ = '.';
+    return put_uint(p, time_ms % 1000u / 10u, 2);
+}
+
+static char *begin(char *p, gps_talker_t talker, const char *formatter)
+{
+    const char *id = talker_ids[talker < sizeof(talker_ids) / sizeof(talker_ids[0]) ? talker : 0];
+    *p++ = '$';
+    *p++ = id[0];
+    *p++ = id[1];
+    *p++ = formatter[0];
+    *p++ = formatter[1];
+    *p++ = formatter[2];
+    return p;
+}
+
+// Appends "*hh\r\n" and copies the sentence out if it fits
+static size_t finish(char *buf, char *p, char *out, size_t size)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t checksum = 0;
+    for (const char *c = buf + 1; c < p; c++) {
+        checksum ^= (uint8_t)*c;
+    }
+    *p++ = '*';
+    *p++ = hex[checksum >> 4];
+    *p++ = hex[checksum & 0x0F];
+    *p++ = '\r';
+    *p++ = '\n';
+    size_t len = p - buf;
+    if (len > size) {
+        return 0;
+    }
+    memcpy(out, buf, len);
+    return len;
+}
+
+size_t gps_encode_gga(const gps_t *data, gps_talker_t talker, char *out, size_t size)
+{
+    char buf[SCRATCH];
+    char *p = begin(buf, talker, "GGA");
+
+    *p++ = ',';
+    p = put_time(p, data->time_ms);
+    *p++ = ',';
+    p = put_coordinate(p, data->latitude_e7, 2, 'N', 'S');
+    *p++ = ',';
+    p = put_coordinate(p, data->longitude_e7, 3, 'E', 'W');
+    *p++ = ',';
+    p = put_uint(p, data->fix, 1);
+    *p++ = ',';
+    p = put_uint(p, data->sats_in_use, 2);
+    *p++ = ',';
+    p = put_fixed(p, data->dop_h, 2);
+    *p++ = ',';
+    p = put_fixed(p, data->altitude, 1);
+    *p++ = ',';
+    *p++ = 'M';
+    *p++ = ',';
+    p = put_fixed(p, data->geoid_height, 1);
+    *p++ = ',';
+    *p++ = 'M';
+    *p++ = ',';
+    *p++ = ',';
+    return finish(buf, p, out, size);
+}
+
+size_t gps_encode_gsa(const gps_t *data, gps_talker_t talker, char *out, size_t size)
+{
+    char buf[SCRATCH];
+    char *p = begin(buf, talker, "GSA");
+
+    *p++ = ',';
+    *p++ = data->mode ? data->mode : 'A';
+    *p++ = ',';
+    p = put_uint(p, data->fix_mode ? data->fix_mode : GPS_MODE_INVALID, 1);
+    for (int i = 0; i < GPS_MAX_SATELLITES_IN_USE; i++) {
+        *p++ = ',';
+        if (data->sats_id_in_use[i]) {
+            p = put_uint(p, data->sats_id_in_use[i], 2);
+        }
+    }
+    *p++ = ',';
+    p = put_fixed(p, data->dop_p, 2);
+    *p++ = ',';
+    p = put_fixed(p, data->dop_h, 2);
+    *p++ = ',';
+    p = put_fixed(p, data->dop_v, 2);
+    return finish(buf, p, out, size);
+}
+
+size_t gps_encode_rmc(const gps_t *data, gps_talker_t talker, char *out, size_t size)
+{
+    char buf[SCRATCH];
+    char *p = begin(buf, talker, "RMC");
+
+    *p++ = ',';
+    p = put_time(p, data->time_ms);
+    *p++ = ',';
+    *p++ = data->valid ? 'A' : 'V';
+    *p++ = ',';
+    p = put_coordinate(p, data->latitude_e7, 2, 'N', 'S');
+    *p++ = ',';
+    p = put_coordinate(p, data->longitude_e7, 3, 'E', 'W');
+    *p++ = ',';
+    p = put_fixed(p, data->speed, 3);
+    *p++ = ',';
+    p = put_fixed(p, data->cog, 2);
+    *p++ = ',';
+    p = put_uint(p, data->date.day, 2);
+    p = put_uint(p, data->date.month, 2);
+    p = put_uint(p, data->date.year % 100u, 2);
+    *p++ = ',';
+    *p++ = ',';
+    *p++ = ',';
+    *p++ = data->valid ? 'A' : 'N';
+    return finish(buf, p, out, size);
+}
+
+size_t gps_encode_vtg(const gps_t *data, gps_talker_t talker, char *out, size_t size)
+{
+    char buf[SCRATCH];
+    char *p = begin(buf, talker, "VTG");
+
+    *p++ = ',';
+    p = put_fixed(p, data->cog, 2);
+    *p++ = ',';
+    *p++ = 'T';
+    *p++ = ',';
+    *p++ = ',';
+    *p++ = 'M';
+    *p++ = ',';
+    p = put_fixed(p, data->speed, 3);
+    *p++ = ',';
+    *p++ = 'N';
+    *p++ = ',';
+    p = put_fixed(p, data->speed * 1.852f, 3);
+    *p++ = ',';
+    *p++ = 'K';
+    *p++ = ',';
+    *p++ = data->valid ? 'A' : 'N';
+    return finish(buf, p, out, size);
+}
+
+size_t gps_encode_gsv(const gps_t *data, gps_talker_t talker, char *out, size_t size)
+{
+    const gps_satellite_t *sats[GPS_MAX_SATELLITES_IN_VIEW];
+    uint8_t count = 0;
+    size_t len = 0;
+
+    for (uint8_t i = 0; i < data->sats_in_view; i++) {
+        if (data->sats_desc_in_view[i].talker == talker) {
+            sats[count++] = &data->sats_desc_in_view[i];
+        }
+    }
+    uint8_t total = count ? (count + 3) / 4 : 1;
+    for (uint8_t number = 1; number <= total; number++) {
+        char buf[SCRATCH];
+        char *p = begin(buf, talker, "GSV");
+        *p++ = ',';
+        p = put_uint(p, total, 1);
+        *p++ = ',';
+        p = put_uint(p, number, 1);
+        *p++ = ',';
+        p = put_uint(p, count, 2);
+        for (uint8_t i = (number - 1) * 4; i < count && i < number * 4; i++) {
+            *p++ = ',';
+            p = put_uint(p, sats[i]->num, 2);
+            *p++ = ',';
+            p = put_uint(p, sats[i]->elevation, 2);
+            *p++ = ',';
+            p = put_uint(p, sats[i]->azimuth, 3);
+            *p++ = ',';
+            if (sats[i]->snr) {
+                p = put_uint(p, sats[i]->snr, 2);
+            }
+        }
+        size_t n = finish(buf, p, out + len, size - len);
+        if (n == 0) {
+            return 0;
+        }
+        len += n;
+    }
+    return len;
+}
+
+size_t gps_encode(const gps_t *data, gps_sentence_t type, gps_talker_t talker, char *out, size_t size)
+{
+    switch (type) {
+        case GPS_SENTENCE_GGA: return gps_encode_gga(data, talker, out, size);
+        case GPS_SENTENCE_GSA: return gps_encode_gsa(data, talker, out, size);
+        case GPS_SENTENCE_GSV: return gps_encode_gsv(data, talker, out, size);
+        case GPS_SENTENCE_RMC: return gps_encode_rmc(data, talker, out, size);
+        case GPS_SENTENCE_VTG: return gps_encode_vtg(data, talker, out, size);
+        default: return 0;
+    }
+}
@@ -0,0 +1,168 @@
+#include "gps_epoch.h"
+
+void gps_epoch_init(gps_epoch_t *epoch, uint32_t timeout_ms, gps_epoch_cb_t on_fix, void *arg)
+{
+    memset(epoch, 0, sizeof(gps_epoch_t));
+    epoch->timeout_ms = timeout_ms;
+    epoch->on_fix = on_fix;
+    epoch->arg = arg;
+}
+
+void gps_epoch_flush(gps_epoch_t *epoch)
+{
+    if (!epoch->open) {
+        return;
+    }
+    epoch->published++;
+    if (epoch->on_fix) {
+        epoch->on_fix(&epoch->fix, epoch->arg);
+    }
+    epoch->open = false;
+}
+
+void gps_epoch_poll(gps_epoch_t *epoch, uint32_t now_ms)
+{
+    if (epoch->open && now_ms - epoch->last_update_ms >= epoch->timeout_ms) {
+        gps_epoch_flush(epoch);
+    }
+}
+
+static void open_epoch(gps_epoch_t *epoch, uint32_t key)
+{
+    memset(&epoch->fix, 0, sizeof(gps_epoch_fix_t));
+    epoch->time_key = key;
+    epoch->open = true;
+}
+
+/* Copies the members the decoder of the sentence type writes, for the member
+ * groups the sentence actually sent. Empty or masked out fields leave the
+ * epoch's values alone instead of bringing back the parser's older ones. */
+static void merge(gps_t *dst, const gps_t *src)
+{
+    uint16_t set = src->fields;
+
+    if (set & GPS_FIELD_TIME) {
+        dst->tim = src->tim;
+        dst->time_ms = src->time_ms;
+        dst->utc_ms = src->utc_ms;
+    }
+    if (set & GPS_FIELD_DATE) {
+        dst->date = src->date;
+        dst->utc_day = src->utc_day;
+        dst->date_day = src->date_day;
+        dst->utc_ms = src->utc_ms;
+    }
+    if (set & GPS_FIELD_POSITION) {
+        dst->latitude = src->latitude;
+        dst->longitude = src->longitude;
+        dst->latitude_e7 = src->latitude_e7;
+        dst->longitude_e7 = src->longitude_e7;
+    }
+    switch (src->sentence) {
+        case GPS_SENTENCE_GGA:
+            if (set & GPS_FIELD_FIX) {
+                dst->fix = src->fix;
+            }
+            if (set & GPS_FIELD_SATS) {
+                dst->sats_in_use = src->sats_in_use;
+            }
+            if (set & GPS_FIELD_DOP) {
+                dst->dop_h = src->dop_h;
+            }
+            if (set & GPS_FIELD_ALTITUDE) {
+                dst->altitude = src->altitude;
+                dst->geoid_height = src->geoid_height;
+            }
+            break;
+        case GPS_SENTENCE_GSA:
+            if (set & GPS_FIELD_FIX) {
+                dst->mode = src->mode;
+                dst->fix_mode = src->fix_mode;
+            }
+            if (set & GPS_FIELD_DOP) {
+                dst->dop_p = src->dop_p;
+                dst->dop_h = src->dop_h;
+                dst->dop_v = src->dop_v;
+            }
+            break;
+        case GPS_SENTENCE_RMC:
+            if (set & GPS_FIELD_FIX) {
+                dst->valid = src->valid;
+            }
+            if (set & GPS_FIELD_SPEED) {
+                dst->speed = src->speed;
+            }
+            if (set & GPS_FIELD_COURSE) {
+                dst->cog = src->cog;
+            }
+            break;
+        case GPS_SENTENCE_GSV:
+            // Set only by the last message of a complete group
+            if (set & GPS_FIELD_SATS_IN_VIEW) {
+                dst->sats_in_view = src->sats_in_view;
+                memcpy(dst->sats_desc_in_view, src->sats_desc_in_view, src->sats_in_view * sizeof(gps_satellite_t));
+            }
+            break;
+        case GPS_SENTENCE_VTG:
+            if (set & GPS_FIELD_SPEED) {
+                dst->speed = src->speed;
+                dst->speedkmh = src->speedkmh;
+            }
+            break;
+        case GPS_SENTENCE_UBX_PVT:
+            if (set & GPS_FIELD_FIX) {
+                dst->valid = src->valid;
+                dst->fix = src->fix;
+                dst->fix_mode = src->fix_mode;
+            }
+            if (set & GPS_FIELD_SATS) {
+                dst->sats_in_use = src->sats_in_use;
+            }
+            if (set & GPS_FIELD_ALTITUDE) {
+                dst->altitude = src->altitude;
+                dst->geoid_height = src->geoid_height;
+            }
+            if (set & GPS_FIELD_SPEED) {
+                dst->speed = src->speed;
+                dst->speedkmh = src->speedkmh;
+            }
+            if (set & GPS_FIELD_COURSE) {
+                dst->cog = src->cog;
+            }
+            if (set & GPS_FIELD_DOP) {
+                dst->dop_p = src->dop_p;
+            }
+            break;
+        default:
+            break;
+    }
+    dst->fields |= set;
+    dst->talker = src->talker;
+    dst->sentence = src->sentence;
+    dst->status = GPS_OKAY;
+}
+
+void gps_epoch_add(gps_epoch_t *epoch, const gps_t *data, uint32_t now_ms)
+{
+    if (data->status != GPS_OKAY || data->sentence == GPS_SENTENCE_UNKNOWN) {
+        return;
+    }
+    gps_epoch_poll(epoch, now_ms);
+
+    // Only a sentence that sent its time (GGA, RMC, NAV-PVT) keys an epoch, the others join the open one
+    if (data->fields & GPS_FIELD_TIME) {
+        uint32_t key = data->time_ms;
+        if (epoch->open && key != epoch->time_key) {
+            gps_epoch_flush(epoch);
+        }
+        if (!epoch->open) {
+            open_epoch(epoch, key);
+        }
+    } else if (!epoch->open) {
+        return;
+    }
+
+    merge(&epoch->fix.data, data);
+    epoch->fix.sentences |= GPS_SENTENCE_BIT(data->sentence);
+    epoch->last_update_ms = now_ms;
+}
@@ -0,0 +1,363 @@
+#include <math.h>
+#include "gps_fence.h"
+
+#define MAX_GRID     (4096)     /*!< Cells per row and per column */
+#define MAX_CELLS    (1u << 18) /*!< 1 MB of cell table at most */
+#define CELLS_FACTOR (2)        /*!< Cells per fence */
+#define M_PER_E7     (0.0111195f)
+#define DEG_TO_RAD   (0.017453292519943295f)
+
+// Cell of a coordinate at or past the south west corner, the difference always fits in 32 unsigned bits
+static inline uint32_t grid_row(const gps_fence_index_t *index, int32_t lat_e7) {
+    return ((uint32_t)lat_e7 - (uint32_t)index->lat_min) / (uint32_t)index->cell_lat;
+}
+
+static inline uint32_t grid_col(const gps_fence_index_t *index, int32_t lon_e7) {
+    return ((uint32_t)lon_e7 - (uint32_t)index->lon_min) / (uint32_t)index->cell_lon;
+}
+
+static inline bool in_box(const gps_fence_t *fence, int32_t lat_e7, int32_t lon_e7) {
+    return lat_e7 >= fence->lat_min && lat_e7 <= fence->lat_max && lon_e7 >= fence->lon_min &&
+           lon_e7 <= fence->lon_max;
+}
+
+// Cells of the grid a fence's bounding box overlaps
+static uint32_t fence_cells(const gps_fence_index_t *index, const gps_fence_t *fence, uint32_t *r0, uint32_t *r1,
+                            uint32_t *c0, uint32_t *c1)
+{
+    *r0 = grid_row(index, fence->lat_min);
+    *r1 = grid_row(index, fence->lat_max);
+    *c0 = grid_col(index, fence->lon_min);
+    *c1 = grid_col(index, fence->lon_max);
+    return (*r1 - *r0 + 1) * (*c1 - *c0 + 1);
+}
+
+static void bounding_box(const gps_fence_polygon_t *polygon, gps_fence_t *fence)
+{
+    fence->lat_min = fence->lat_max = polygon->vertices[0];
+    fence->lon_min = fence->lon_max = polygon->vertices[1];
+    for (uint16_t v = 1; v < polygon->count; v++) {
+        int32_t lat = polygon->vertices[2 * v], lon = polygon->vertices[2 * v + 1];
+        fence->lat_min = lat < fence->lat_min ? lat : fence->lat_min;
+        fence->lat_max = lat > fence->lat_max ? lat : fence->lat_max;
+        fence->lon_min = lon < fence->lon_min ? lon : fence->lon_min;
+        fence->lon_max = lon > fence->lon_max ? lon : fence->lon_max;
+    }
+}
+
+// Grid over the union of the boxes, about CELLS_FACTOR roughly square cells per fence
+static void plan_grid(const gps_fence_polygon_t *fences, size_t count, gps_fence_index_t *index)
+{
+    int32_t lat_min = INT32_MAX, lat_max = -INT32_MAX, lon_min = INT32_MAX, lon_max = -INT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        gps_fence_t box;
+        bounding_box(&fences[i], &box);
+        lat_min = box.lat_min < lat_min ? box.lat_min : lat_min;
+        lat_max = box.lat_max > lat_max ? box.lat_max : lat_max;
+        lon_min = box.lon_min < lon_min ? box.lon_min : lon_min;
+        lon_max = box.lon_max > lon_max ? box.lon_max : lon_max;
+    }
+    if (count == 0) {
+        lat_min = lat_max = lon_min = lon_max = 0;
+    }
+    int64_t height = (int64_t)lat_max - lat_min + 1;
+    int64_t width = (int64_t)lon_max - lon_min + 1;
+    double cells = (double)count * CELLS_FACTOR;
+    cells = cells < 1 ? 1 : cells > MAX_CELLS ? MAX_CELLS : cells;
+
+    // A degree of longitude is shorter than one of latitude away from the equator
+    double shrink = cos((lat_min + lat_max) * 0.5e-7 * DEG_TO_RAD);
+    double cols = sqrt(cells * width * shrink / height);
+    cols = cols < 1 ? 1 : cols > MAX_GRID ? MAX_GRID : cols;
+    double rows = cells / cols;
+    rows = rows < 1 ? 1 : rows > MAX_GRID ? MAX_GRID : rows;
+
+    index->cell_lat = (int32_t)((height + (int64_t)rows - 1) / (int64_t)rows);
+    index->cell_lon = (int32_t)((width + (int64_t)cols - 1) / (int64_t)cols);
+    index->rows = (uint16_t)((height + index->cell_lat - 1) / index->cell_lat);
+    index->cols = (uint16_t)((width + index->cell_lon - 1) / index->cell_lon);
+    index->lat_min = lat_min;
+    index->lon_min = lon_min;
+}
+
+size_t gps_fence_build(const gps_fence_polygon_t *fences, size_t count, void *out, size_t size)
+{
+    gps_fence_index_t plan;
+    uint32_t vertex_count = 0, entry_count = 0, r0, r1, c0, c1;
+
+    memset(&plan, 0, sizeof(plan));
+    for (size_t i = 0; i < count; i++) {
+        if (fences[i].count < 3 || fences[i].vertices == NULL) {
+            return 0;
+        }
+        vertex_count += fences[i].count;
+    }
+    plan_grid(fences, count, &plan);
+    for (size_t i = 0; i < count; i++) {
+        gps_fence_t box;
+        bounding_box(&fences[i], &box);
+        entry_count += fence_cells(&plan, &box, &r0, &r1, &c0, &c1);
+    }
+    plan.fence_count = count;
+    plan.vertex_count = vertex_count;
+    plan.entry_count = entry_count;
+
+    uint32_t cells = (uint32_t)plan.rows * plan.cols;
+    size_t total = sizeof(gps_fence_index_t) + (cells + 1 + entry_count) * sizeof(uint32_t) +
+                   count * sizeof(gps_fence_t) + vertex_count * 2 * sizeof(int32_t);
+    if (out == NULL || size < total) {
+        return total;
+    }
+
+    gps_fence_index_t *index = out;
+    *index = plan;
+    index->magic[0] = 'G';
+    index->magic[1] = 'F';
+    index->version = GPS_FENCE_VERSION;
+    index->size = total;
+    uint32_t *start = (uint32_t *)gps_fence_cells(index);
+    uint32_t *entries = (uint32_t *)gps_fence_entries(index);
+    gps_fence_t *table = (gps_fence_t *)gps_fence_table(index);
+    int32_t *vertices = (int32_t *)gps_fence_vertices(index);
+
+    uint32_t first = 0;
+    for (size_t i = 0; i < count; i++) {
+        bounding_box(&fences[i], &table[i]);
+        table[i].id = fences[i].id;
+        table[i].first = first;
+        table[i].count = fences[i].count;
+        memcpy(vertices + 2 * first, fences[i].vertices, fences[i].count * 2 * sizeof(int32_t));
+        first += fences[i].count;
+    }
+
+    // Counting sort of the entries by cell, start[c + 1] first counts the entries of cell c
+    memset(start, 0, (cells + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) {
+        fence_cells(index, &table[i], &r0, &r1, &c0, &c1);
+        for (uint32_t r = r0; r <= r1; r++) {
+            for (uint32_t c = c0; c <= c1; c++) {
+                start[r * plan.cols + c + 1]++;
+            }
+        }
+    }
+    for (uint32_t c = 0; c < cells; c++) {
+        start[c + 1] += start[c];
+    }
+    for (size_t i = 0; i < count; i++) {
+        fence_cells(index, &table[i], &r0, &r1, &c0, &c1);
+        for (uint32_t r = r0; r <= r1; r++) {
+            for (uint32_t c = c0; c <= c1; c++) {
+                entries[start[r * plan.cols + c]++] = i;
+            }
+        }
+    }
+    // Filling moved every start to the end of its cell, which is the start of the next
+    for (uint32_t c = cells; c > 0; c--) {
+        start[c] = start[c - 1];
+    }
+    start[0] = 0;
+    return total;
+}
+
+// Every offset the tracker follows stays inside its table, whatever the partition holds
+static bool tables_valid(const gps_fence_index_t *index)
+{
+    const uint32_t *start = gps_fence_cells(index);
+    const uint32_t *entries = gps_fence_entries(index);
+    const gps_fence_t *table = gps_fence_table(index);
+    uint32_t cells = (uint32_t)index->rows * index->cols;
+
+    if (start[0] != 0) {
+        return false;
+    }
+    for (uint32_t c = 0; c < cells; c++) {
+        if (start[c + 1] < start[c]) {
+            return false;
+        }
+    }
+    for (uint32_t e = 0; e < index->entry_count; e++) {
+        if (entries[e] >= index->fence_count) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < index->fence_count; i++) {
+        if (table[i].count < 3 || table[i].first > index->vertex_count ||
+            table[i].count > index->vertex_count - table[i].first) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const gps_fence_index_t *gps_fence_load(const void *data, size_t size)
+{
+    const gps_fence_index_t *index = data;
+
+    if (data == NULL || ((uintptr_t)data & 3) || size < sizeof(gps_fence_index_t) || index->magic[0] != 'G' ||
+        index->magic[1] != 'F' || index->version != GPS_FENCE_VERSION || index->size > size ||
+        index->rows == 0 || index->cols == 0 || index->cell_lat <= 0 || index->cell_lon <= 0) {
+        return NULL;
+    }
+    uint64_t cells = (uint64_t)index->rows * index->cols;
+    uint64_t expected = sizeof(gps_fence_index_t) + (cells + 1 + index->entry_count) * sizeof(uint32_t) +
+                        (uint64_t)index->fence_count * sizeof(gps_fence_t) +
+                        (uint64_t)index->vertex_count * 2 * sizeof(int32_t);
+    if (expected != index->size || gps_fence_cells(index)[cells] != index->entry_count || !tables_valid(index)) {
+        return NULL;
+    }
+    return index;
+}
+
+bool gps_fence_contains(const gps_fence_index_t *index, uint32_t fence, int32_t lat_e7, int32_t lon_e7)
+{
+    const gps_fence_t *f = &gps_fence_table(index)[fence];
+    const int32_t *v = gps_fence_vertices(index) + 2 * f->first;
+    bool inside = false;
+
+    if (!in_box(f, lat_e7, lon_e7)) {
+        return false;
+    }
+    // Crossings of a ray towards the east, the products of two differences fit in 64 bits
+    int32_t lat_a = v[2 * (f->count - 1)], lon_a = v[2 * (f->count - 1) + 1];
+    for (uint32_t i = 0; i < f->count; i++) {
+        int32_t lat_b = v[2 * i], lon_b = v[2 * i + 1];
+        if ((lat_a > lat_e7) != (lat_b > lat_e7)) {
+            int64_t dy = (int64_t)lat_b - lat_a;
+            int64_t lhs = ((int64_t)lon_e7 - lon_a) * dy;
+            int64_t rhs = ((int64_t)lon_b - lon_a) * ((int64_t)lat_e7 - lat_a);
+            inside ^= dy > 0 ? lhs < rhs : lhs > rhs;
+        }
+        lat_a = lat_b;
+        lon_a = lon_b;
+    }
+    return inside;
+}
+
+// Distance in meters from the point to the nearest edge of the fence
+static float edge_distance(const gps_fence_index_t *index, uint32_t fence, int32_t lat_e7, int32_t lon_e7)
+{
+    const gps_fence_t *f = &gps_fence_table(index)[fence];
+    const int32_t *v = gps_fence_vertices(index) + 2 * f->first;
+    float shrink = cosf(lat_e7 * 1e-7f * DEG_TO_RAD);
+    float best = INFINITY;
+
+    // Local meters around the point, north and east
+    float ay = (v[2 * (f->count - 1)] - lat_e7) * M_PER_E7;
+    float ax = ((int64_t)v[2 * (f->count - 1) + 1] - lon_e7) * M_PER_E7 * shrink;
+    for (uint32_t i = 0; i < f->count; i++) {
+        float by = (v[2 * i] - lat_e7) * M_PER_E7;
+        float bx = ((int64_t)v[2 * i + 1] - lon_e7) * M_PER_E7 * shrink;
+        float dx = bx - ax, dy = by - ay;
+        float len2 = dx * dx + dy * dy;
+        float t = len2 > 0.0f ? -(ax * dx + ay * dy) / len2 : 0.0f;
+        t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+        float px = ax + t * dx, py = ay + t * dy;
+        float d2 = px * px + py * py;
+        best = d2 < best ? d2 : best;
+        ax = bx;
+        ay = by;
+    }
+    return sqrtf(best);
+}
+
+void gps_fence_tracker_init(gps_fence_tracker_t *tracker, const gps_fence_index_t *index, uint32_t *inside,
+                            float margin_m, gps_fence_cb_t on_event, void *arg)
+{
+    memset(tracker, 0, sizeof(gps_fence_tracker_t));
+    tracker->index = index;
+    tracker->inside = inside;
+    tracker->margin_m = margin_m;
+    tracker->on_event = on_event;
+    tracker->arg = arg;
+    memset(inside, 0, GPS_FENCE_WORDS(index->fence_count) * sizeof(uint32_t));
+}
+
+static inline bool is_inside(const gps_fence_tracker_t *tracker, uint32_t fence) {
+    return tracker->inside[fence / 32] & (1u << (fence % 32));
+}
+
+static void set_inside(gps_fence_tracker_t *tracker, uint32_t fence, bool inside)
+{
+    if (inside) {
+        tracker->inside[fence / 32] |= 1u << (fence % 32);
+        if (tracker->active_count < GPS_FENCE_MAX_INSIDE) {
+            tracker->active[tracker->active_count++] = fence;
+        } else {
+            tracker->overflow = true;
+        }
+    } else {
+        tracker->inside[fence / 32] &= ~(1u << (fence % 32));
+        for (uint8_t i = 0; i < tracker->active_count; i++) {
+            if (tracker->active[i] == fence) {
+                tracker->active[i] = tracker->active[--tracker->active_count];
+                break;
+            }
+        }
+    }
+    tracker->events++;
+    if (tracker->on_event) {
+        tracker->on_event(gps_fence_table(tracker->index)[fence].id, inside, tracker->arg);
+    }
+}
+
+// Changes the state of a fence the point is on the other side of, once it is far enough past the edge
+static inline void track(gps_fence_tracker_t *tracker, uint32_t fence, bool inside, int32_t lat_e7, int32_t lon_e7)
+{
+    if (inside != is_inside(tracker, fence) &&
+        (tracker->margin_m <= 0.0f || edge_distance(tracker->index, fence, lat_e7, lon_e7) >= tracker->margin_m)) {
+        set_inside(tracker, fence, inside);
+    }
+}
+
+// Leaves the fences whose box the point is outside of, which its cell does not list
+static void leave_distant(gps_fence_tracker_t *tracker, int32_t lat_e7, int32_t lon_e7)
+{
+    const gps_fence_t *table = gps_fence_table(tracker->index);
+
+    if (!tracker->overflow) {
+        for (int i = tracker->active_count - 1; i >= 0; i--) {
+            uint32_t fence = tracker->active[i];
+            if (!in_box(&table[fence], lat_e7, lon_e7)) {
+                track(tracker, fence, false, lat_e7, lon_e7);
+            }
+        }
+        return;
+    }
+    // Too many fences entered to list them, walk the bit set and list them again if they fit now
+    uint32_t set = 0;
+    tracker->active_count = 0;
+    for (uint32_t w = 0; w < GPS_FENCE_WORDS(tracker->index->fence_count); w++) {
+        for (uint32_t bits = tracker->inside[w]; bits; bits &= bits - 1) {
+            uint32_t fence = w * 32 + __builtin_ctz(bits);
+            if (!in_box(&table[fence], lat_e7, lon_e7)) {
+                track(tracker, fence, false, lat_e7, lon_e7);
+            }
+            if (is_inside(tracker, fence)) {
+                if (set < GPS_FENCE_MAX_INSIDE) {
+                    tracker->active[set] = fence;
+                }
+                set++;
+            }
+        }
+    }
+    tracker->active_count = set < GPS_FENCE_MAX_INSIDE ? set : GPS_FENCE_MAX_INSIDE;
+    tracker->overflow = set > GPS_FENCE_MAX_INSIDE;
+}
+
+void gps_fence_check(gps_fence_tracker_t *tracker, int32_t lat_e7, int32_t lon_e7)
+{
+    const gps_fence_index_t *index = tracker->index;
+
+    // Off the grid the point is outside every box
+    if (lat_e7 >= index->lat_min && lon_e7 >= index->lon_min) {
+        uint32_t row = grid_row(index, lat_e7), col = grid_col(index, lon_e7);
+        if (row < index->rows && col < index->cols) {
+            const uint32_t *start = gps_fence_cells(index) + row * index->cols + col;
+            const uint32_t *entries = gps_fence_entries(index);
+            for (uint32_t e = start[0]; e < start[1]; e++) {
+                track(tracker, entries[e], gps_fence_contains(index, entries[e], lat_e7, lon_e7), lat_e7, lon_e7);
+            }
+        }
+    }
+    leave_distant(tracker, lat_e7, lon_e7);
+}
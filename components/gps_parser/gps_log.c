@@ -0,0 +1,412 @@
+#include <math.h>
+#include <string.h>
+#include "gps_log.h"
+
+// Record tag, which groups of values follow the time
+#define TAG_POSITION (0x01)
+#define TAG_ALTITUDE (0x02)
+#define TAG_SPEED    (0x04)
+#define TAG_COURSE   (0x08)
+#define TAG_STATUS   (0x10) /*!< fix, fix_mode, valid, sats and hdop, stored absolute */
+#define TAG_DATE     (0x20) /*!< Stored absolute, year 0 before the first RMC */
+#define TAG_RESERVED (0x40)
+#define TAG_KEY      (0x80) /*!< Every group, stored absolute */
+#define TAG_ALL      (0x3F)
+#define TAG_UNUSED   (0xFF) /*!< Rest of the block is unused */
+
+#define BLOCK_HEADER (3)
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Difference that wraps like the int32_t values do, so every delta fits
+static inline int32_t delta(int32_t value, int32_t base) {
+    return (int32_t)((uint32_t)value - (uint32_t)base);
+}
+
+static inline int32_t undelta(int32_t base, int32_t d) {
+    return (int32_t)((uint32_t)base + (uint32_t)d);
+}
+
+static inline uint8_t *put_uvarint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint8_t *put_svarint(uint8_t *p, int32_t v) {
+    return put_uvarint(p, zigzag(v));
+}
+
+static inline bool get_uvarint(const uint8_t **p, const uint8_t *end, uint32_t *v) {
+    uint32_t result = 0;
+    for (unsigned shift = 0; shift < 35 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool get_svarint(const uint8_t **p, const uint8_t *end, int32_t *v) {
+    uint32_t u;
+    if (!get_uvarint(p, end, &u)) {
+        return false;
+    }
+    *v = unzigzag(u);
+    return true;
+}
+
+static inline int32_t quantize(float value, float scale) {
+    return (int32_t)lroundf(value * scale);
+}
+
+void gps_log_record_from_fix(const gps_epoch_fix_t *fix, const gps_log_record_t *prev, gps_log_record_t *rec)
+{
+    const gps_t *data = &fix->data;
+    uint32_t has = fix->sentences;
+    uint16_t set = data->fields;
+
+    if (prev != NULL) {
+        *rec = *prev;
+    } else {
+        memset(rec, 0, sizeof(gps_log_record_t));
+    }
+    rec->time_ms = data->time_ms;
+    if (set & GPS_FIELD_DATE) {
+        rec->date = data->date;
+    }
+    if (set & GPS_FIELD_COURSE) {
+        rec->course_cdeg = quantize(data->cog, 100.0f);
+    }
+    if (set & GPS_FIELD_POSITION) {
+        rec->lat_e7 = data->latitude_e7;
+        rec->lon_e7 = data->longitude_e7;
+    }
+    if (set & GPS_FIELD_ALTITUDE) {
+        rec->alt_dm = quantize(data->altitude, 10.0f);
+    }
+    if (set & GPS_FIELD_SATS) {
+        rec->sats = data->sats_in_use;
+    }
+    if (set & GPS_FIELD_SPEED) {
+        rec->speed_ckn = quantize(data->speed, 100.0f);
+    }
+    // The fix group is spread over sentences, GGA has fix, RMC valid and GSA the mode
+    if ((set & GPS_FIELD_FIX) && (has & GPS_EPOCH_HAS_DATE)) {
+        rec->valid = data->valid;
+    }
+    if ((set & GPS_FIELD_FIX) && (has & GPS_EPOCH_HAS_FIX)) {
+        rec->fix = data->fix;
+    }
+    if ((set & GPS_FIELD_FIX) && (has & GPS_EPOCH_HAS_FIX_MODE)) {
+        rec->fix_mode = data->fix_mode;
+    }
+    if ((set & GPS_FIELD_DOP) && (has & GPS_EPOCH_HAS_HDOP)) {
+        int32_t hdop = quantize(data->dop_h, 100.0f);
+        rec->hdop_c = hdop < 0 ? 0 : hdop > UINT16_MAX ? UINT16_MAX : hdop;
+    }
+}
+
+static inline bool same_status(const gps_log_record_t *a, const gps_log_record_t *b) {
+    return a->fix == b->fix && a->fix_mode == b->fix_mode && a->valid == b->valid && a->sats == b->sats &&
+           a->hdop_c == b->hdop_c;
+}
+
+static inline bool same_date(const gps_log_record_t *a, const gps_log_record_t *b) {
+    return a->date.year == b->date.year && a->date.month == b->date.month && a->date.day == b->date.day;
+}
+
+// Encodes rec as a keyframe when base is NULL, returns the end of the record
+static uint8_t *encode(const gps_log_record_t *rec, const gps_log_record_t *base, uint8_t *p)
+{
+    uint8_t tag = TAG_KEY | TAG_ALL;
+    gps_log_record_t zero = {0};
+
+    if (base != NULL) {
+        tag = 0;
+        tag |= (rec->lat_e7 != base->lat_e7 || rec->lon_e7 != base->lon_e7) ? TAG_POSITION : 0;
+        tag |= rec->alt_dm != base->alt_dm ? TAG_ALTITUDE : 0;
+        tag |= rec->speed_ckn != base->speed_ckn ? TAG_SPEED : 0;
+        tag |= rec->course_cdeg != base->course_cdeg ? TAG_COURSE : 0;
+        tag |= !same_status(rec, base) ? TAG_STATUS : 0;
+        tag |= !same_date(rec, base) ? TAG_DATE : 0;
+    } else {
+        base = &zero;
+    }
+
+    *p++ = tag;
+    if (tag & TAG_KEY) {
+        p = put_uvarint(p, rec->time_ms);
+    } else {
+        p = put_svarint(p, delta(rec->time_ms, base->time_ms));
+    }
+    if (tag & TAG_POSITION) {
+        p = put_svarint(p, delta(rec->lat_e7, base->lat_e7));
+        p = put_svarint(p, delta(rec->lon_e7, base->lon_e7));
+    }
+    if (tag & TAG_ALTITUDE) {
+        p = put_svarint(p, delta(rec->alt_dm, base->alt_dm));
+    }
+    if (tag & TAG_SPEED) {
+        p = put_svarint(p, delta(rec->speed_ckn, base->speed_ckn));
+    }
+    if (tag & TAG_COURSE) {
+        p = put_svarint(p, delta(rec->course_cdeg, base->course_cdeg));
+    }
+    if (tag & TAG_STATUS) {
+        *p++ = (rec->fix & 0x03) | ((rec->fix_mode & 0x03) << 2) | (rec->valid ? 0x10 : 0);
+        *p++ = rec->sats;
+        p = put_uvarint(p, rec->hdop_c);
+    }
+    if (tag & TAG_DATE) {
+        p = put_uvarint(p, rec->date.year);
+        *p++ = rec->date.month;
+        *p++ = rec->date.day;
+    }
+    return p;
+}
+
+void gps_log_writer_init(gps_log_writer_t *writer, uint32_t block_size, gps_log_write_t write, void *arg)
+{
+    memset(writer, 0, sizeof(gps_log_writer_t));
+    writer->block_size = block_size < 2 * GPS_LOG_MAX_RECORD ? 2 * GPS_LOG_MAX_RECORD : block_size;
+    writer->write = write;
+    writer->arg = arg;
+}
+
+static bool pad_block(gps_log_writer_t *writer)
+{
+    static const uint8_t unused[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    };
+    // Once begun the padding must be finished, the reader takes 0xFF as the end of the block
+    writer->padding = true;
+    while (writer->offset < writer->block_size) {
+        uint32_t n = writer->block_size - writer->offset;
+        n = n < sizeof(unused) ? n : sizeof(unused);
+        if (!writer->write(unused, n, writer->arg)) {
+            return false;
+        }
+        writer->offset += n;
+        writer->bytes += n;
+    }
+    writer->offset = 0;
+    writer->padding = false;
+    return true;
+}
+
+bool gps_log_write(gps_log_writer_t *writer, const gps_log_record_t *rec)
+{
+    uint8_t buf[GPS_LOG_MAX_RECORD];
+    uint8_t *end = encode(rec, writer->offset ? &writer->last : NULL, buf);
+
+    if (writer->padding || (writer->offset && writer->offset + (end - buf) > writer->block_size)) {
+        if (!pad_block(writer)) {
+            return false;
+        }
+    }
+    if (writer->offset == 0) {
+        buf[0] = GPS_LOG_MAGIC1;
+        buf[1] = GPS_LOG_MAGIC2;
+        buf[2] = GPS_LOG_VERSION;
+        end = encode(rec, NULL, buf + BLOCK_HEADER);
+    }
+    size_t len = end - buf;
+    if (!writer->write(buf, len, writer->arg)) {
+        // Nothing was stored, the next record goes where this one would have
+        return false;
+    }
+    writer->offset += len;
+    writer->bytes += len;
+    writer->records++;
+    writer->last = *rec;
+    return true;
+}
+
+bool gps_log_write_fix(gps_log_writer_t *writer, const gps_epoch_fix_t *fix)
+{
+    gps_log_record_t rec;
+    gps_log_record_from_fix(fix, writer->records ? &writer->last : NULL, &rec);
+    return gps_log_write(writer, &rec);
+}
+
+void gps_log_reader_init(gps_log_reader_t *reader, const uint8_t *data, size_t size, uint32_t block_size)
+{
+    memset(reader, 0, sizeof(gps_log_reader_t));
+    reader->data = data;
+    reader->size = size;
+    reader->block_size = block_size < 2 * GPS_LOG_MAX_RECORD ? 2 * GPS_LOG_MAX_RECORD : block_size;
+}
+
+// Decodes the record at *p onto base, false when it does not fit before end or is malformed
+static bool decode(const uint8_t **p, const uint8_t *end, gps_log_record_t *rec)
+{
+    const uint8_t *q = *p;
+    uint8_t tag = *q++;
+    int32_t v, w;
+    uint32_t u;
+
+    if (tag & TAG_RESERVED) {
+        return false;
+    }
+    if (tag & TAG_KEY) {
+        memset(rec, 0, sizeof(gps_log_record_t));
+        if (!get_uvarint(&q, end, &u)) {
+            return false;
+        }
+        rec->time_ms = u;
+    } else {
+        if (!get_svarint(&q, end, &v)) {
+            return false;
+        }
+        rec->time_ms = undelta(rec->time_ms, v);
+    }
+    if (tag & TAG_POSITION) {
+        if (!get_svarint(&q, end, &v) || !get_svarint(&q, end, &w)) {
+            return false;
+        }
+        rec->lat_e7 = undelta(rec->lat_e7, v);
+        rec->lon_e7 = undelta(rec->lon_e7, w);
+    }
+    if (tag & TAG_ALTITUDE) {
+        if (!get_svarint(&q, end, &v)) {
+            return false;
+        }
+        rec->alt_dm = undelta(rec->alt_dm, v);
+    }
+    if (tag & TAG_SPEED) {
+        if (!get_svarint(&q, end, &v)) {
+            return false;
+        }
+        rec->speed_ckn = undelta(rec->speed_ckn, v);
+    }
+    if (tag & TAG_COURSE) {
+        if (!get_svarint(&q, end, &v)) {
+            return false;
+        }
+        rec->course_cdeg = undelta(rec->course_cdeg, v);
+    }
+    if (tag & TAG_STATUS) {
+        if (end - q < 2) {
+            return false;
+        }
+        rec->fix = q[0] & 0x03;
+        rec->fix_mode = (q[0] >> 2) & 0x03;
+        rec->valid = q[0] & 0x10;
+        rec->sats = q[1];
+        q += 2;
+        if (!get_uvarint(&q, end, &u) || u > UINT16_MAX) {
+            return false;
+        }
+        rec->hdop_c = u;
+    }
+    if (tag & TAG_DATE) {
+        if (!get_uvarint(&q, end, &u) || u > UINT16_MAX || end - q < 2) {
+            return false;
+        }
+        rec->date.year = u;
+        rec->date.month = q[0];
+        rec->date.day = q[1];
+        q += 2;
+    }
+    *p = q;
+    return true;
+}
+
+static inline bool block_header(const uint8_t *p, const uint8_t *end) {
+    return end - p > BLOCK_HEADER && p[0] == GPS_LOG_MAGIC1 && p[1] == GPS_LOG_MAGIC2 && p[2] == GPS_LOG_VERSION &&
+           (p[BLOCK_HEADER] & TAG_KEY) && p[BLOCK_HEADER] != TAG_UNUSED;
+}
+
+bool gps_log_read(gps_log_reader_t *reader, gps_log_record_t *rec)
+{
+    while (reader->pos < reader->size) {
+        size_t block = reader->pos - reader->pos % reader->block_size;
+        size_t block_end = block + reader->block_size < reader->size ? block + reader->block_size : reader->size;
+        const uint8_t *p = reader->data + reader->pos;
+        const uint8_t *end = reader->data + block_end;
+
+        if (reader->pos == block) {
+            if (!block_header(p, end)) {
+                reader->bad_blocks++;
+                reader->pos = block_end;
+                continue;
+            }
+            p += BLOCK_HEADER;
+        } else if (*p == TAG_UNUSED) {
+            reader->pos = block_end;
+            continue;
+        }
+        if (!decode(&p, end, &reader->last)) {
+            reader->bad_blocks++;
+            reader->pos = block_end;
+            continue;
+        }
+        reader->pos = p - reader->data;
+        *rec = reader->last;
+        return true;
+    }
+    return false;
+}
+
+uint64_t gps_log_record_key(const gps_log_record_t *rec)
+{
+    int32_t day = rec->date.year ? gps_days_from_civil(&rec->date) : 0;
+    return (uint64_t)(day > 0 ? day : 0) * 86400000u + rec->time_ms;
+}
+
+// Key of the keyframe that starts block b, false for an erased or corrupted block
+static bool block_key(const gps_log_reader_t *reader, size_t b, uint64_t *key)
+{
+    size_t start = b * reader->block_size;
+    size_t end = start + reader->block_size < reader->size ? start + reader->block_size : reader->size;
+    const uint8_t *p = reader->data + start + BLOCK_HEADER;
+    gps_log_record_t rec;
+
+    if (!block_header(reader->data + start, reader->data + end) || !decode(&p, reader->data + end, &rec)) {
+        return false;
+    }
+    *key = gps_log_record_key(&rec);
+    return true;
+}
+
+bool gps_log_seek(gps_log_reader_t *reader, uint64_t key)
+{
+    size_t lo = 0, hi = (reader->size + reader->block_size - 1) / reader->block_size;
+    bool found = false;
+
+    // Last readable block with a keyframe not later than key, in [lo, hi)
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t b = mid;
+        uint64_t k = 0;
+        while (b < hi && !block_key(reader, b, &k)) {
+            b++;
+        }
+        if (b == hi) {
+            hi = mid;
+        } else if (k <= key) {
+            reader->pos = b * reader->block_size;
+            found = true;
+            lo = b + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (!found) {
+        reader->pos = 0;
+    }
+    return found;
+}
@@ -1,498 +1,748 @@
-// #define LOG_LOCAL_LEVEL ESP_LOG_ERROR //as per ESP32 logging guidelines LOG_LOCAL_LEVEL is defined before including esp_log.h
-#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "sdkconfig.h"
+// As per ESP32 logging guidelines LOG_LOCAL_LEVEL is defined before including esp_log.h,
+// levels below it are compiled out together with their arguments
+#define LOG_LOCAL_LEVEL CONFIG_GPS_PARSER_LOG_LEVEL
 #include "gps_parser.h"
+#include "gps_scan.h"
+#include "gps_parser_priv.h"
 static const char *TAG = "Parser";
 
-static uint8_t calculate_checksum(const char *sentence) {
+static inline int8_t hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Splits the sentence into fields and verifies its checksum in a single pass.
+static gps_status_t tokenize(const char *sentence, uint16_t len, gps_fields_t *fields) {
+    const uint8_t *p = (const uint8_t *)sentence;
     uint8_t checksum = 0;
-    for (uint8_t i = 1; sentence[i] != '*'; i++) {
-        checksum ^= sentence[i];
+    size_t i = 1;
+
+    fields->count = 0;
+    fields->start[0] = 1;
+    // The kernel stops at every byte outside the field alphabet, only '*' and
+    // a ',' beyond GPS_MAX_FIELDS end the sentence here
+    for (;;) {
+        i = gps_scan_fields(p, i, len, fields, &checksum);
+        if (i == len || p[i] == '*') {
+            break;
+        }
+        if (p[i] == ',') {
+            return GPS_INV_SENTENCE;
+        }
+        checksum ^= p[i++];
+    }
+    // '*' must be followed by two hex digits
+    if (i + 2 >= len) {
+        return GPS_INV_SENTENCE;
+    }
+    fields->start[++fields->count] = i + 1;
+
+    int8_t hi = hex_value(sentence[i + 1]);
+    int8_t lo = hex_value(sentence[i + 2]);
+    if (hi < 0 || lo < 0) {
+        return GPS_INV_SENTENCE;
+    }
+    if (((hi << 4) | lo) != checksum) {
+        return GPS_CRC_ERROR;
     }
-    return checksum;
+    return GPS_OKAY;
 }
 
-static inline void parse_time(char *utc_time, uint8_t *hours, uint8_t *minutes, float *seconds) {
-    // Check if the time string is in the correct format
-    if (strlen(utc_time) != 9) {
-        ESP_LOGE(TAG,"Time string length invalid.");
-        return;
+// Decodes the leading decimal digits of a field, stops at the first non digit.
+static uint32_t parse_uint(const char *field, uint8_t len) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < len && field[i] >= '0' && field[i] <= '9'; i++) {
+        value = value * 10 + (field[i] - '0');
+    }
+    return value;
+}
+
+// Decodes a "[-]ddd.ddd" field without the locale and heap cost of strtof.
+static float parse_float(const char *field, uint8_t len) {
+    static const float scale[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f};
+    uint32_t mantissa = 0;
+    uint8_t decimals = 0, digits = 0, i = 0;
+    bool negative = false, fraction = false;
+
+    if (len > 0 && (field[0] == '-' || field[0] == '+')) {
+        negative = (field[0] == '-');
+        i++;
+    }
+    for (; i < len; i++) {
+        if (field[i] == '.' && !fraction) {
+            fraction = true;
+            continue;
+        }
+        // NMEA fields never carry more than 9 significant digits
+        if (field[i] < '0' || field[i] > '9' || digits == 9 || decimals == 9) {
+            break;
+        }
+        mantissa = mantissa * 10 + (field[i] - '0');
+        digits += (mantissa != 0);
+        decimals += fraction;
     }
+    float value = (float)mantissa / scale[decimals];
+    return negative ? -value : value;
+}
 
-    char *tmp_hour_str = strndup(utc_time, 2);
-    char *tmp_minutes_str = strndup(utc_time + 2, 2);
+static inline uint8_t two_digits(const char *field) {
+    return (field[0] - '0') * 10 + (field[1] - '0');
+}
 
-    // Extract hours, minutes, and seconds
-    int parsed_hours = atoi(tmp_hour_str) + GMT;
-    if (parsed_hours >= 24) {
-        parsed_hours %= 24; // Keep hours within 0-23 range
+static inline bool all_digits(const char *field, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        if (field[i] < '0' || field[i] > '9') return false;
     }
-    *hours = parsed_hours;
-    *minutes = atoi(tmp_minutes_str);
-    *seconds = atof(utc_time + 4);
+    return true;
+}
 
-    free(tmp_hour_str);
-    free(tmp_minutes_str);    
+// Decodes "hhmmss[.sss]" straight from the sentence, digits past the ms are dropped
+static inline void parse_time(const char *utc_time, uint8_t len, gps_t *data) {
+    // Check if the time string is in the correct format
+    if (len < 6 || !all_digits(utc_time, 6)) {
+        ESP_LOGE(TAG,"Time string length invalid.");
+        return;
+    }
+    uint32_t hours = two_digits(utc_time);
+    uint32_t minutes = two_digits(utc_time + 2);
+    uint32_t seconds = two_digits(utc_time + 4);
+    // 60 is a leap second
+    if (hours > 23 || minutes > 59 || seconds > 60) {
+        ESP_LOGE(TAG,"Time string invalid.");
+        return;
+    }
+    uint32_t ms = 0, scale = 100;
+    if (len > 7 && utc_time[6] == '.') {
+        for (uint8_t i = 7; i < len && scale > 0 && utc_time[i] >= '0' && utc_time[i] <= '9'; i++) {
+            ms += (utc_time[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    gps_set_time(data, ((hours * 60 + minutes) * 60 + seconds) * 1000 + ms);
 }
 
-static inline void parse_date(char *date_string, uint8_t *day, uint8_t *month, uint16_t *year)
+// Decodes "ddmmyy" straight from the sentence
+static inline void parse_date(const char *date_string, uint8_t len, gps_t *data)
 {
     // Check if the date string is in the correct format
-    if (strlen(date_string) != 6) {
+    if (len != 6 || !all_digits(date_string, 6)) {
         ESP_LOGE(TAG,"Date string length invalid.");
         return;
     }
+    uint8_t day = two_digits(date_string);
+    uint8_t month = two_digits(date_string + 2);
+    if (day < 1 || day > 31 || month < 1 || month > 12) {
+        ESP_LOGE(TAG,"Date string invalid.");
+        return;
+    }
+    // The year is sent as YY
+    gps_set_date(data, day, month, two_digits(date_string + 4) + 2000);
+}
+
+#define MS_PER_DAY (86400000)
+
+static inline void update_utc(gps_t *data) {
+    data->utc_ms = (int64_t)data->utc_day * MS_PER_DAY + data->time_ms;
+}
 
-    char *tmp_day_str = strndup(date_string, 2);
-    char *tmp_month_str = strndup(date_string + 2, 2);
-    char *tmp_year_str = strndup(date_string+4, 2);
+void gps_set_time(gps_t *data, uint32_t time_ms)
+{
+    if (time_ms + MS_PER_DAY / 2 < data->time_ms) {
+        data->utc_day++;
+    }
+    data->time_ms = time_ms;
+    data->tim.hour = time_ms / 3600000;
+    data->tim.minute = time_ms / 60000 % 60;
+    data->tim.thousand = time_ms % 1000;
+    data->tim.second = (time_ms % 60000) / 1000.0f;
+    data->fields |= GPS_FIELD_TIME;
+    update_utc(data);
+}
 
-    // Extract day, month, and year
-    *day = atoi(tmp_day_str);
-    *month = atoi(tmp_month_str);
-    *year = atoi(tmp_year_str) + 2000; // Assuming year is represented in YY format
+void gps_set_date(gps_t *data, uint8_t day, uint8_t month, uint16_t year)
+{
+    gps_date_t *date = &data->date;
+    data->fields |= GPS_FIELD_DATE;
+    if (date->day != day || date->month != month || date->year != year) {
+        date->day = day;
+        date->month = month;
+        date->year = year;
+        data->date_day = gps_days_from_civil(date);
+    }
+    // Also when the date did not change, gps_set_time() may have moved utc_day on
+    data->utc_day = data->date_day;
+    update_utc(data);
+}
 
-    free(tmp_day_str);
-    free(tmp_month_str);
-    free(tmp_year_str);
+int32_t gps_days_from_civil(const gps_date_t *date)
+{
+    // Howard Hinnant's algorithm, years start in March so the leap day is last
+    int32_t y = (int32_t)date->year - (date->month <= 2);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * ((date->month + 9) % 12) + 2) / 5 + date->day - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
 }
 
-// Function to parse latitude or longitude from the NMEA sentence
-static float parse_coordinate(const char *coord, uint8_t *item_length) {
+static int16_t utc_offset_min = CONFIG_GPS_PARSER_UTC_OFFSET;
+
+void gps_set_utc_offset(int16_t minutes)
+{
+    utc_offset_min = minutes;
+}
 
-    if (*item_length < 9) {
+int16_t gps_get_utc_offset(void)
+{
+    return utc_offset_min;
+}
+
+void gps_local_time(int64_t utc_ms, gps_date_t *date, gps_time_t *tim)
+{
+    int64_t local = utc_ms + (int64_t)utc_offset_min * 60000;
+    int32_t days = (int32_t)(local / MS_PER_DAY);
+    int32_t ms = (int32_t)(local % MS_PER_DAY);
+    if (ms < 0) {
+        ms += MS_PER_DAY;
+        days--;
+    }
+    tim->hour = ms / 3600000;
+    tim->minute = ms / 60000 % 60;
+    tim->thousand = ms % 1000;
+    tim->second = (ms % 60000) / 1000.0f;
+    gps_civil_from_days(days, date);
+}
+
+void gps_civil_from_days(int32_t days, gps_date_t *date)
+{
+    // Inverse of gps_days_from_civil()
+    int32_t z = days + 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int32_t doe = z - era * 146097;
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+    date->day = doy - (153 * mp + 2) / 5 + 1;
+    date->month = mp < 10 ? mp + 3 : mp - 9;
+    date->year = yoe + era * 400 + (date->month <= 2);
+}
+
+/* Decodes a "ddmm.mmmmm" latitude or "dddmm.mmmmm" longitude into 1e-7 degrees
+ * using integer arithmetic only. Returns false if the field is malformed. */
+bool gps_decode_coordinate(const char *coord, uint8_t item_length, int32_t *value) {
+    uint8_t dot = 0;
+    while (dot < item_length && coord[dot] != '.') {
+        dot++;
+    }
+    // At least one degree digit and two minute digits before the '.'
+    if (dot < 3 || dot > 5 || !all_digits(coord, dot)) {
+        ESP_LOGE(TAG,"Coord string invalid.");
+        return false;
+    }
+
+    uint32_t degrees = parse_uint(coord, dot - 2);
+    // Minutes scaled by 1e7, fraction digits beyond the 7th are dropped
+    uint32_t minutes = two_digits(coord + dot - 2);
+    uint8_t decimals = 0;
+    for (uint8_t i = dot + 1; i < item_length && decimals < 7; i++, decimals++) {
+        if (coord[i] < '0' || coord[i] > '9') {
+            break;
+        }
+        minutes = minutes * 10 + (coord[i] - '0');
+    }
+    for (; decimals < 7; decimals++) {
+        minutes *= 10;
+    }
+    if (degrees > 180 || minutes >= 600000000u) {
         ESP_LOGE(TAG,"Coord string invalid.");
-        return 0;
-    }
-    float tmp_value = strtof(coord,NULL);
-    int degrees = ((int)tmp_value) / 100;
-    float minutes = tmp_value - (degrees * 100);
-    // Calculate the coordinate value
-    return degrees + minutes / 60.0;
-}
-
-static void parse_gga(const char *sentence, uint16_t len, gps_t *data_struct) {
-    float tmp_latitude = 0.0;
-    float tmp_longitude = 0.0;
-
-    uint8_t i = 0, item_idx = 0;
-    char current_idx[20] = "";
-    uint8_t item_length = 0;
-
-    // Iterate through the sentence character by character upto null character
-    while(sentence[i] != '\0') {
-        if (sentence[i] == ',' || sentence[i] == '*') {
-            // Null-terminate the current field buffer
-            current_idx[item_length] = '\0';
-            switch (item_idx) {
-                case 1: // Time
-                    if (item_length > 0) {
-                        parse_time(current_idx, &(data_struct->tim.hour), &(data_struct->tim.minute), &(data_struct->tim.second));
-                        ESP_LOGI(TAG,"Time:%d:%d:%f", data_struct->tim.hour, data_struct->tim.minute, data_struct->tim.second);
-                    }
-                    break;
-                case 2: // Latitude
-                    if (item_length > 0) {
-                        tmp_latitude = parse_coordinate(current_idx, &item_length);
-                    }
-                    break;
-                case 3: // Latitude direction (N/S)
-                    if (item_length > 0) {
-                        if (current_idx[0] == 'S' || current_idx[0] == 's') {
-                            data_struct->latitude = tmp_latitude * -1;
-                        } else if (current_idx[0] == 'N' || current_idx[0] == 'n') {
-                            data_struct->latitude = tmp_latitude;
-                        }
-                        ESP_LOGI(TAG, "latitude: %f",data_struct->latitude);
-                    }
-                    break;
-                case 4: // Longitude
-                    if (item_length > 0) {
-                        tmp_longitude = parse_coordinate(current_idx, &item_length);
-                    }
-                    break;
-                case 5: // Longitude direction (E/W)
-                    if (item_length > 0) {
-                        if (current_idx[0] == 'W' || current_idx[0] == 'w') {
-                            data_struct->longitude = tmp_longitude * -1;
-                        } else if (current_idx[0] == 'E' || current_idx[0] == 'e') {
-                            data_struct->longitude = tmp_longitude;
-                        }
-                        ESP_LOGI(TAG, "longitude: %f",data_struct->longitude);
-                    }
-                    break;
-                case 6: // Fix quality
-                    if (item_length > 0) {
-                        data_struct->fix = atoi(current_idx);
-                        ESP_LOGI(TAG, "fix: %d",data_struct->fix);
-                    }
-                    break;
-                case 7: // Number of satellites
-                    if (item_length > 0) {
-                        data_struct->sats_in_use = atoi(current_idx);
-                        ESP_LOGI(TAG, "Sats: %d",data_struct->sats_in_use);
-                    }
-                    break;
-                case 8: // HDOP
-                    if (item_length > 0) {
-                        data_struct->dop_h = atof(current_idx);
-                        ESP_LOGI(TAG, "HDOP %f",data_struct->dop_h);
-                    }
-                    break;
-                case 9: // Altitude
-                    if (item_length > 0) {
-                        data_struct->altitude = atof(current_idx);
-                    }
-                    break;
-                case 11: // Geoid height above WGS84 ellipsoid
-                    if (item_length > 0) {
-                        data_struct->geoid_height = atof(current_idx);
-                        ESP_LOGI(TAG, "altitude: %f",data_struct->altitude);                        
-                    }
-                    // ESP_LOGI(TAG,"altitude above ellipsoid: %f\r\n", gps.altitude);
-                    break;
-                default:
-                    break;
-            }
-
-            // Reset the current field buffer and length
-            memset(current_idx, 0, sizeof(current_idx));
-            item_length = 0;
-
-            // Move to the next field index
-            item_idx++;
-
-            // Skip the '*' character
-            if (sentence[i] == '*') {
+        return false;
+    }
+    *value = (int32_t)(degrees * 10000000u + (minutes + 30) / 60);
+    return true;
+}
+
+// Stores a signed coordinate in 1e-7 degrees together with its float form
+static inline void set_coordinate(int32_t value, int32_t *fixed, float *degrees) {
+    *fixed = value;
+    *degrees = value / 1e7f;
+}
+
+/* Stores the coordinate decoded from the field before with the sign of its
+ * hemisphere letter. Returns false and leaves the coordinate alone when either
+ * field was empty or malformed. */
+static inline bool set_hemisphere(char letter, char positive, char negative, bool decoded, int32_t value,
+                                  int32_t *fixed, float *degrees) {
+    letter &= ~0x20; // Upper case
+    if (!decoded || (letter != positive && letter != negative)) {
+        return false;
+    }
+    set_coordinate(letter == negative ? -value : value, fixed, degrees);
+    return true;
+}
+
+/* gps_t fields each GGA field feeds, fields that feed nothing are never read */
+static const uint16_t gga_interest[GPS_MAX_FIELDS] = {
+    [1] = GPS_FIELD_TIME,
+    [2] = GPS_FIELD_POSITION, [3] = GPS_FIELD_POSITION, [4] = GPS_FIELD_POSITION, [5] = GPS_FIELD_POSITION,
+    [6] = GPS_FIELD_FIX,
+    [7] = GPS_FIELD_SATS,
+    [8] = GPS_FIELD_DOP,
+    [9] = GPS_FIELD_ALTITUDE, [11] = GPS_FIELD_ALTITUDE,
+};
+
+static void parse_gga(const char *sentence, const gps_fields_t *fields, uint32_t interest, gps_t *data_struct) {
+    int32_t tmp_latitude = 0;
+    int32_t tmp_longitude = 0;
+    bool has_latitude = false, has_longitude = false;
+    uint8_t halves = 0;
+
+    // Walk the fields in place, field 0 is the address
+    for (uint8_t item_idx = 1; item_idx < fields->count; item_idx++) {
+        if (!(gga_interest[item_idx] & interest)) {
+            continue;
+        }
+        const char *field = sentence + fields->start[item_idx];
+        uint8_t item_length = field_len(fields, item_idx);
+        if (item_length == 0) {
+            continue;
+        }
+        switch (item_idx) {
+            case 1: // Time
+                parse_time(field, item_length, data_struct);
+                ESP_LOGI(TAG,"Time:%d:%d:%f", data_struct->tim.hour, data_struct->tim.minute, data_struct->tim.second);
+                break;
+            case 2: // Latitude
+                has_latitude = gps_decode_coordinate(field, item_length, &tmp_latitude);
+                break;
+            case 3: // Latitude direction (N/S)
+                halves += set_hemisphere(field[0], 'N', 'S', has_latitude, tmp_latitude, &data_struct->latitude_e7,
+                                         &data_struct->latitude);
+                ESP_LOGI(TAG, "latitude: %f",data_struct->latitude);
+                break;
+            case 4: // Longitude
+                has_longitude = gps_decode_coordinate(field, item_length, &tmp_longitude);
+                break;
+            case 5: // Longitude direction (E/W)
+                halves += set_hemisphere(field[0], 'E', 'W', has_longitude, tmp_longitude, &data_struct->longitude_e7,
+                                         &data_struct->longitude);
+                ESP_LOGI(TAG, "longitude: %f",data_struct->longitude);
+                break;
+            case 6: // Fix quality
+                data_struct->fix = parse_uint(field, item_length);
+                data_struct->fields |= GPS_FIELD_FIX;
+                ESP_LOGI(TAG, "fix: %d",data_struct->fix);
+                break;
+            case 7: // Number of satellites
+                data_struct->sats_in_use = parse_uint(field, item_length);
+                data_struct->fields |= GPS_FIELD_SATS;
+                ESP_LOGI(TAG, "Sats: %d",data_struct->sats_in_use);
+                break;
+            case 8: // HDOP
+                data_struct->dop_h = parse_float(field, item_length);
+                data_struct->fields |= GPS_FIELD_DOP;
+                ESP_LOGI(TAG, "HDOP %f",data_struct->dop_h);
+                break;
+            case 9: // Altitude
+                data_struct->altitude = parse_float(field, item_length);
+                data_struct->fields |= GPS_FIELD_ALTITUDE;
+                break;
+            case 11: // Geoid height above WGS84 ellipsoid
+                data_struct->geoid_height = parse_float(field, item_length);
+                ESP_LOGI(TAG, "altitude: %f",data_struct->altitude);
+                break;
+            default:
                 break;
-            }
-        } else {
-            // Append the character to the current field buffer
-            current_idx[item_length++] = sentence[i];
         }
-        i++;
+    }
+    if (halves == 2) {
+        data_struct->fields |= GPS_FIELD_POSITION;
     }
 }
 
+static const uint16_t gsa_interest[GPS_MAX_FIELDS] = {
+    [1] = GPS_FIELD_FIX, [2] = GPS_FIELD_FIX,
+    [15] = GPS_FIELD_DOP, [16] = GPS_FIELD_DOP, [17] = GPS_FIELD_DOP,
+};
+
 // Function to parse the GSA sentence
-static void parse_gsa(const char *sentence, uint16_t length, gps_t *data_struct) {
-    uint8_t i = 0, item_idx = 0;
-    bool empty_field = false; // Flag to track if the current field is empty
-    char current_idx[20] = ""; // Buffer to store the current field
-    uint8_t item_length = 0; // Length of the current field
-
-    while (sentence[i] != '\0') {
-        if (sentence[i] == ',' || sentence[i] == '*') {
-            // Handle empty field
-            if (empty_field) {
-
-            } else {
-                // Null-terminate the current field buffer
-                current_idx[item_length] = '\0';
-                // Store the current field
-                switch (item_idx) {
-                    case 1: // Mode (A/M)
-                        if (item_length > 0) {
-                            data_struct->mode = current_idx[0];
-                            ESP_LOGI(TAG,"GPS Mode: %c", data_struct->mode);
-                        } else {
-                            ESP_LOGE(TAG,"GPS Mode field empty.\r\n");
-                        }
-                        break;
-                    case 2: // Fix Mode
-                        if (!empty_field) {
-                            data_struct->fix_mode = atoi(current_idx);
-                            ESP_LOGI(TAG,"fix mode: %d", data_struct->fix_mode);
-                        } else {
-                            ESP_LOGE(TAG,"Fix Mode field is empty.");
-                        }
-                        break;
-                    case 15: // PDOP
-                        if (!empty_field) {
-                            data_struct->dop_p = atof(current_idx);
-                            ESP_LOGI(TAG,"PDOP: %f", data_struct->dop_p);
-                        } else {
-                            ESP_LOGE(TAG,"PDOP field is empty.");
-                        }
-                        break;
-                    case 16: // HDOP
-                        if (!empty_field) {
-                            data_struct->dop_h = atof(current_idx);
-                            ESP_LOGI(TAG,"HDOP: %f", data_struct->dop_h);
-                        } else {
-                            ESP_LOGE(TAG,"HDOP field is empty.");
-                        }
-                        break;
-                    case 17: // VDOP
-                        if (!empty_field) {
-                            data_struct->dop_v = atof(current_idx);
-                            ESP_LOGI(TAG,"VDOP: %f", data_struct->dop_v);
-                        } else {
-                            ESP_LOGE(TAG,"VDOP field is empty.");
-                        }
-                        break;
-                    default:
-                        break;
+static void parse_gsa(const char *sentence, const gps_fields_t *fields, uint32_t interest, gps_t *data_struct) {
+    for (uint8_t item_idx = 1; item_idx < fields->count; item_idx++) {
+        if (!(gsa_interest[item_idx] & interest)) {
+            continue;
+        }
+        const char *field = sentence + fields->start[item_idx];
+        uint8_t item_length = field_len(fields, item_idx);
+        switch (item_idx) {
+            case 1: // Mode (A/M)
+                if (item_length > 0) {
+                    data_struct->mode = field[0];
+                    data_struct->fields |= GPS_FIELD_FIX;
+                    ESP_LOGI(TAG,"GPS Mode: %c", data_struct->mode);
+                } else {
+                    ESP_LOGE(TAG,"GPS Mode field empty.\r\n");
                 }
-                // Reset the current field buffer and length
-                memset(current_idx, 0, sizeof(current_idx));
-                item_length = 0;
-                // Move to the next field
-                item_idx++;
-            }
-            // Reset the empty field flag
-            empty_field = false;
-        } else {
-            // Append the character to the current field buffer
-            current_idx[item_length++] = sentence[i];
+                break;
+            case 2: // Fix Mode
+                if (item_length > 0) {
+                    data_struct->fix_mode = parse_uint(field, item_length);
+                    data_struct->fields |= GPS_FIELD_FIX;
+                    ESP_LOGI(TAG,"fix mode: %d", data_struct->fix_mode);
+                } else {
+                    ESP_LOGE(TAG,"Fix Mode field is empty.");
+                }
+                break;
+            case 15: // PDOP
+                if (item_length > 0) {
+                    data_struct->dop_p = parse_float(field, item_length);
+                    data_struct->fields |= GPS_FIELD_DOP;
+                    ESP_LOGI(TAG,"PDOP: %f", data_struct->dop_p);
+                } else {
+                    ESP_LOGE(TAG,"PDOP field is empty.");
+                }
+                break;
+            case 16: // HDOP
+                if (item_length > 0) {
+                    data_struct->dop_h = parse_float(field, item_length);
+                    data_struct->fields |= GPS_FIELD_DOP;
+                    ESP_LOGI(TAG,"HDOP: %f", data_struct->dop_h);
+                } else {
+                    ESP_LOGE(TAG,"HDOP field is empty.");
+                }
+                break;
+            case 17: // VDOP
+                if (item_length > 0) {
+                    data_struct->dop_v = parse_float(field, item_length);
+                    data_struct->fields |= GPS_FIELD_DOP;
+                    ESP_LOGI(TAG,"VDOP: %f", data_struct->dop_v);
+                } else {
+                    ESP_LOGE(TAG,"VDOP field is empty.");
+                }
+                break;
+            default:
+                break;
         }
-        i++;
     }
 }
 
-static void parse_rmc(const char *sentence, uint16_t len, gps_t *data_struct) {
-    uint8_t i = 0, item_idx = 0;
-    bool empty_field = false; // Flag to track if the current field is empty
-    char current_idx[20] = ""; // Buffer to store the current field
-    uint8_t item_length = 0; // Length of the current field
+static const uint16_t rmc_interest[GPS_MAX_FIELDS] = {
+    [1] = GPS_FIELD_TIME,
+    [2] = GPS_FIELD_FIX,
+    [3] = GPS_FIELD_POSITION, [4] = GPS_FIELD_POSITION, [5] = GPS_FIELD_POSITION, [6] = GPS_FIELD_POSITION,
+    [7] = GPS_FIELD_SPEED,
+    [8] = GPS_FIELD_COURSE,
+    [9] = GPS_FIELD_DATE,
+};
 
+static void parse_rmc(const char *sentence, const gps_fields_t *fields, uint32_t interest, gps_t *data_struct) {
     // Temporary variables to store latitude and longitude
-    float tmp_latitude = 0.0;
-    float tmp_longitude = 0.0;
-
-    // Iterate through the sentence character by character
-    while (sentence[i] != '\0') {
-        if (sentence[i] == ',' || sentence[i] == '*') {
-            // Handle empty field
-            if (empty_field) {
-  
-            } else {
-                // Null-terminate the current field buffer
-                current_idx[item_length] = '\0';
-                // Store or process the current field based on its index
-                switch (item_idx) {
-                    case 1: // Time
-                        if (item_length >= 6) {
-                            // Assuming time format is HHMMSS
-                            parse_time(current_idx, &(data_struct->tim.hour), &(data_struct->tim.minute), &(data_struct->tim.second));
-                            ESP_LOGI(TAG,"Time: %d:%d:%f", data_struct->tim.hour, data_struct->tim.minute, data_struct->tim.second);
-                        }
-                        break;
-                    case 2: // Validity
-                        if(item_length > 0){
-                            data_struct->valid = (current_idx[0] == 'A') ? true : false;
-                            ESP_LOGI(TAG,"Validity status: %d", data_struct->valid);
-                        }
-                        break;
-                    case 3: // Latitude
-                        if (item_length > 0) {
-                            tmp_latitude = parse_coordinate(current_idx, &item_length);
-                        }
-                        break;
-                    case 4: // Latitude direction (N/S)
-                        if (item_length > 0) {
-                            if (current_idx[0] == 'S' || current_idx[0] == 's') {
-                                data_struct->latitude = tmp_latitude * -1;
-                            } else if (current_idx[0] == 'N' || current_idx[0] == 'n') {
-                                data_struct->latitude = tmp_latitude;
-                            }
-                            ESP_LOGI(TAG, "latitude: %f",data_struct->latitude);
-                        }
-                        break;
-                    case 5: // Longitude
-                        if (item_length > 0) {
-                            tmp_longitude = parse_coordinate(current_idx, &item_length);
-                        }
-                        break;
-                    case 6: // Longitude direction (E/W)
-                        if (item_length > 0) {
-                            if (current_idx[0] == 'W' || current_idx[0] == 'w') {
-                                data_struct->longitude = tmp_longitude * -1;
-                            } else if (current_idx[0] == 'E' || current_idx[0] == 'e') {
-                                data_struct->longitude = tmp_longitude;
-                            }
-                            ESP_LOGI(TAG, "longitude: %f",data_struct->longitude);
-                        }
-                        break;
-                    case 7: // Speed (Knots)
-                        if (item_length > 0) {
-                            data_struct->speed = atof(current_idx);
-                            ESP_LOGI(TAG, "speed: %f",data_struct->speed);
-                        }
-                        break;
-                    case 8: // Course over ground
-                        if (item_length > 0) {
-                            data_struct->cog = atof(current_idx);
-                            ESP_LOGI(TAG, "cog: %f",data_struct->cog);
-                        }
-                        break;
-                    case 9: // Date
-                        if (item_length >= 6) {
-                            // Assuming date format is DDMMYY
-                            parse_date(current_idx, &(data_struct->date.day), &(data_struct->date.month), &(data_struct->date.year));
-                            ESP_LOGI(TAG, "date: %d/%d/%d", data_struct->date.day, data_struct->date.month, data_struct->date.year);
-                        }
-                        break;
-                    default:
-                        break;
+    int32_t tmp_latitude = 0;
+    int32_t tmp_longitude = 0;
+    bool has_latitude = false, has_longitude = false;
+    uint8_t halves = 0;
+
+    for (uint8_t item_idx = 1; item_idx < fields->count; item_idx++) {
+        if (!(rmc_interest[item_idx] & interest)) {
+            continue;
+        }
+        const char *field = sentence + fields->start[item_idx];
+        uint8_t item_length = field_len(fields, item_idx);
+        if (item_length == 0) {
+            continue;
+        }
+        // Store or process the current field based on its index
+        switch (item_idx) {
+            case 1: // Time
+                if (item_length >= 6) {
+                    // Assuming time format is HHMMSS
+                    parse_time(field, item_length, data_struct);
+                    ESP_LOGI(TAG,"Time: %d:%d:%f", data_struct->tim.hour, data_struct->tim.minute, data_struct->tim.second);
                 }
-                // Reset the current field buffer and length
-                memset(current_idx, 0, sizeof(current_idx));
-                item_length = 0;
-                // Move to the next field index
-                item_idx++;
-            }
-            // Reset the empty field flag
-            empty_field = false;
-        } else {
-            // Append the character to the current field buffer
-            current_idx[item_length++] = sentence[i];
+                break;
+            case 2: // Validity
+                data_struct->valid = (field[0] == 'A') ? true : false;
+                data_struct->fields |= GPS_FIELD_FIX;
+                ESP_LOGI(TAG,"Validity status: %d", data_struct->valid);
+                break;
+            case 3: // Latitude
+                has_latitude = gps_decode_coordinate(field, item_length, &tmp_latitude);
+                break;
+            case 4: // Latitude direction (N/S)
+                halves += set_hemisphere(field[0], 'N', 'S', has_latitude, tmp_latitude, &data_struct->latitude_e7,
+                                         &data_struct->latitude);
+                ESP_LOGI(TAG, "latitude: %f",data_struct->latitude);
+                break;
+            case 5: // Longitude
+                has_longitude = gps_decode_coordinate(field, item_length, &tmp_longitude);
+                break;
+            case 6: // Longitude direction (E/W)
+                halves += set_hemisphere(field[0], 'E', 'W', has_longitude, tmp_longitude, &data_struct->longitude_e7,
+                                         &data_struct->longitude);
+                ESP_LOGI(TAG, "longitude: %f",data_struct->longitude);
+                break;
+            case 7: // Speed (Knots)
+                data_struct->speed = parse_float(field, item_length);
+                data_struct->fields |= GPS_FIELD_SPEED;
+                ESP_LOGI(TAG, "speed: %f",data_struct->speed);
+                break;
+            case 8: // Course over ground
+                data_struct->cog = parse_float(field, item_length);
+                data_struct->fields |= GPS_FIELD_COURSE;
+                ESP_LOGI(TAG, "cog: %f",data_struct->cog);
+                break;
+            case 9: // Date
+                if (item_length >= 6) {
+                    // Assuming date format is DDMMYY
+                    parse_date(field, item_length, data_struct);
+                    ESP_LOGI(TAG, "date: %d/%d/%d", data_struct->date.day, data_struct->date.month, data_struct->date.year);
+                }
+                break;
+            default:
+                break;
         }
-        i++;
+    }
+    if (halves == 2) {
+        data_struct->fields |= GPS_FIELD_POSITION;
     }
 }
 
 
-static void parse_vtg(const char *sentence, uint16_t len, gps_t *data_struct) {
-    uint8_t i = 0, item_idx = 0;
-    bool empty_field = false; // Flag to track if the current field is empty
-    char current_field[20] = ""; // Buffer to store the current field
-    uint8_t item_length = 0; // Length of the current field
-
-    // Iterate through the sentence character by character
-    while (sentence[i] != '\0') {
-        if (sentence[i] == ',' || sentence[i] == '*') {
-            // Handle empty field
-            if (empty_field) {
-            } else {
-                // Null-terminate the current field buffer
-                current_field[item_length] = '\0';
-                // Store or process the current field based on its index
-                switch (item_idx) {
-                    case 5: // Ground speed in knots
-                        if (item_length > 0) {
-                            // Parse and store the value if it's not empty
-                            data_struct->speed = atof(current_field);
-                            ESP_LOGI(TAG, "speed: %f", data_struct->speed);
-                        }
-                        break;
-                    case 7: // Ground speed in kilometers per hour
-                        if (item_length > 0) {
-                            // Parse and store the value if it's not empty
-                            // Assuming the conversion factor is 1.852
-                            data_struct->speedkmh = atof(current_field) * 1.852;
-                            ESP_LOGI(TAG,"Speed km/h: %f",data_struct->speedkmh);
-                        }
-                        break;
-                    default:
-                        break;
-                }
-                // Reset the current field buffer and length
-                memset(current_field, 0, sizeof(current_field));
-                item_length = 0;
-                // Move to the next field index
-                item_idx++;
-            }
-            // Reset the empty field flag
-            empty_field = false;
-        } else {
-            // Append the character to the current field buffer
-            current_field[item_length++] = sentence[i];
+static const uint16_t vtg_interest[GPS_MAX_FIELDS] = {
+    [5] = GPS_FIELD_SPEED, [7] = GPS_FIELD_SPEED,
+};
+
+static void parse_vtg(const char *sentence, const gps_fields_t *fields, uint32_t interest, gps_t *data_struct) {
+    for (uint8_t item_idx = 1; item_idx < fields->count; item_idx++) {
+        if (!(vtg_interest[item_idx] & interest)) {
+            continue;
+        }
+        const char *field = sentence + fields->start[item_idx];
+        uint8_t item_length = field_len(fields, item_idx);
+        if (item_length == 0) {
+            continue;
+        }
+        // Store or process the current field based on its index
+        switch (item_idx) {
+            case 5: // Ground speed in knots
+                data_struct->speed = parse_float(field, item_length);
+                data_struct->fields |= GPS_FIELD_SPEED;
+                ESP_LOGI(TAG, "speed: %f", data_struct->speed);
+                break;
+            case 7: // Ground speed in kilometers per hour
+                // Assuming the conversion factor is 1.852
+                data_struct->speedkmh = parse_float(field, item_length) * 1.852;
+                data_struct->fields |= GPS_FIELD_SPEED;
+                ESP_LOGI(TAG,"Speed km/h: %f",data_struct->speedkmh);
+                break;
+            default:
+                break;
         }
-        i++;
     }
 }
 
+// Replaces the satellites of the staged group's talker in the table with the group
+static void commit_gsv(gps_gsv_stage_t *stage, gps_t *data_struct) {
+    uint8_t kept = 0;
 
-gps_t gps_parse(const char *sentence)
-{
-    uint8_t i = 1;
-    char type[7]; // size greater by 1 to accommodate null terminator
-    static gps_t gps_data;
-    static bool gps_struct_initialized = false;
+    for (uint8_t i = 0; i < data_struct->sats_in_view; i++) {
+        if (data_struct->sats_desc_in_view[i].talker != stage->talker) {
+            data_struct->sats_desc_in_view[kept++] = data_struct->sats_desc_in_view[i];
+        }
+    }
+    uint8_t room = GPS_MAX_SATELLITES_IN_VIEW - kept;
+    uint8_t count = stage->count < room ? stage->count : room;
+    memcpy(&data_struct->sats_desc_in_view[kept], stage->sats, count * sizeof(gps_satellite_t));
+    data_struct->sats_in_view = kept + count;
+    data_struct->fields |= GPS_FIELD_SATS_IN_VIEW;
+    ESP_LOGI(TAG, "satellites in view: %d", data_struct->sats_in_view);
+}
+
+/* GSV: total messages, message number, satellites in view, then up to four
+ * blocks of PRN, elevation, azimuth and SNR, and a signal id since NMEA 4.10.
+ * Each message is decoded straight into the stage, the table in gps_t changes
+ * only with the last message of a complete group. */
+static void parse_gsv(gps_parser_t *parser, const char *sentence, const gps_fields_t *fields) {
+    gps_gsv_stage_t *stage = &parser->gsv;
+    gps_talker_t talker = parser->data.talker;
 
-    if (gps_struct_initialized == false) {
-        memset(&gps_data, 0, sizeof(gps_t));
-        gps_struct_initialized = true;
+    if (!(parser->field_mask & GPS_FIELD_SATS_IN_VIEW) || fields->count < 4) {
+        return;
+    }
+    uint8_t total = parse_uint(sentence + fields->start[1], field_len(fields, 1));
+    uint8_t number = parse_uint(sentence + fields->start[2], field_len(fields, 2));
+    if (number == 1) {
+        stage->count = 0;
+        stage->next = 1;
+        stage->total = total;
+        stage->talker = talker;
+    }
+    if (number == 0 || number != stage->next || total != stage->total || talker != stage->talker) {
+        // A lost or reordered message spoils the group, wait for the next one to start
+        ESP_LOGE(TAG, "GSV message %d of %d out of sequence", number, total);
+        stage->next = 0;
+        return;
     }
 
-    //Checks to avoid segmentation fault 
-    if (sentence == NULL) { 
-        // ESP_LOGI(TAG, "Invalid GPS sentence.\r\n");
-        ESP_LOGE(TAG,"Pointer to NULL passed to function.\r\n");
-        gps_data.status = (gps_status_t)GPS_PTR_TO_NULL;
-        return gps_data;
+    for (uint8_t item_idx = 4; item_idx + 3 < fields->count; item_idx += 4) {
+        uint8_t prn_length = field_len(fields, item_idx);
+        if (prn_length == 0) {
+            continue;
+        }
+        if (stage->count >= GPS_MAX_SATELLITES_IN_VIEW) {
+            break;
+        }
+        gps_satellite_t *sat = &stage->sats[stage->count++];
+        sat->num = parse_uint(sentence + fields->start[item_idx], prn_length);
+        sat->elevation = parse_uint(sentence + fields->start[item_idx + 1], field_len(fields, item_idx + 1));
+        sat->azimuth = parse_uint(sentence + fields->start[item_idx + 2], field_len(fields, item_idx + 2));
+        sat->snr = parse_uint(sentence + fields->start[item_idx + 3], field_len(fields, item_idx + 3));
+        sat->talker = talker;
     }
 
-    // Calculate the length of the sentence and create a copy of the sentence which is null terminated
-    uint8_t len = 0;
-    while (sentence[len] != '\n' && len < MAX_SENTENCE_LENGTH) {
-        len++;
+    if (number == total) {
+        commit_gsv(stage, &parser->data);
+        stage->next = 0;
+    } else {
+        stage->next++;
     }
-    len++;
+}
 
-    char *sentence_copy = strndup(sentence, len);
-    if (sentence_copy == NULL) {
-        ESP_LOGE(TAG,"Sentence copy not created.\r\n");
-        gps_data.status = (gps_status_t)GPS_MEM_LOW;
-        return gps_data;
+gps_status_t gps_parser_finish(gps_parser_t *parser, gps_sentence_t type, gps_status_t status)
+{
+    parser->data.status = status;
+#if CONFIG_GPS_PARSER_TRACE
+    gps_trace_record(&parser->trace, type, status, &parser->data);
+#endif
+#if CONFIG_GPS_PARSER_STATS
+    parser->stats.status[status]++;
+    if (status == GPS_OKAY) {
+        parser->stats.sentences[type]++;
+        gps_histogram_add(&parser->stats.parse_cycles, gps_cycles() - parser->stats.start);
     }
+#endif
+    return status;
+}
 
-    //Checks to avoid using invalid sentence 
-    if (sentence[0] != '$' || len < 3 || len > 83) { 
-        ESP_LOGE(TAG, "Invalid GPS sentence.\r\n");
-        gps_data.status = (gps_status_t)GPS_INV_SENTENCE;
-        return gps_data;
+typedef void (*gps_decoder_t)(const char *sentence, const gps_fields_t *fields, uint32_t interest, gps_t *data_struct);
+
+/* Decoder of every sentence type, NULL for types that are recognised but not
+ * decoded yet (GLL). GSV keeps state in the parser and is decoded by
+ * parse_gsv(). */
+static const gps_decoder_t decoders[GPS_SENTENCE_MAX] = {
+    [GPS_SENTENCE_GGA] = parse_gga,
+    [GPS_SENTENCE_GSA] = parse_gsa,
+    [GPS_SENTENCE_RMC] = parse_rmc,
+    [GPS_SENTENCE_VTG] = parse_vtg,
+};
+
+gps_status_t gps_decode(gps_parser_t *parser, const char *sentence, const gps_fields_t *fields)
+{
+    gps_t *gps_data = &parser->data;
+
+    // The address is a 2 character talker followed by a 3 character formatter
+    gps_sentence_t type = GPS_SENTENCE_UNKNOWN;
+    if (field_len(fields, 0) == 5) {
+        type = gps_decode_formatter(sentence + 3);
+    }
+    if (type == GPS_SENTENCE_UNKNOWN) {
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_SENTENCE_MISMATCH);
+    }
+    if (!(parser->sentence_mask & GPS_SENTENCE_BIT(type))) {
+        return gps_parser_finish(parser, type, GPS_SENTENCE_IGNORED);
     }
 
-    uint8_t d=0;
-    //parse upto asterick
-    while(sentence_copy[d] != '*' && d < len-2){
-        d++;
+    gps_data->talker = gps_decode_talker(sentence + 1);
+    gps_data->sentence = type;
+    gps_data->fields = 0;
+    // Length of the sentence up to and including the checksum digits
+    ESP_LOGI(TAG, "%.*s", fields->start[fields->count] + 2, sentence);
+    if (type == GPS_SENTENCE_GSV) {
+        parse_gsv(parser, sentence, fields);
+    } else if (decoders[type] != NULL) {
+        decoders[type](sentence, fields, parser->field_mask, gps_data);
     }
-    char checksum_str[2] = {sentence_copy[d+1],sentence_copy[d+2]};
-    uint8_t provided_checksum = strtol(checksum_str, NULL, 16);
 
-    // Perform checksum calculation
-    uint8_t calculated_checksum = calculate_checksum(sentence);
-    if(provided_checksum != calculated_checksum){
-        ESP_LOGE(TAG,"CRC error");
-        gps_data.status = (gps_status_t)GPS_CRC_ERROR;
-        return gps_data;
+    return gps_parser_finish(parser, type, GPS_OKAY);
+}
+
+void gps_parser_init(gps_parser_t *parser)
+{
+    memset(parser, 0, sizeof(gps_parser_t));
+    gps_parser_set_interest(parser, GPS_SENTENCES_ALL, GPS_FIELDS_ALL);
+}
+
+void gps_parser_set_interest(gps_parser_t *parser, uint32_t sentences, uint32_t fields)
+{
+    parser->sentence_mask = sentences;
+    parser->field_mask = fields;
+}
+
+void gps_parser_reset(gps_parser_t *parser)
+{
+    memset(&parser->data, 0, sizeof(gps_t));
+    memset(&parser->gsv, 0, sizeof(gps_gsv_stage_t));
+}
+
+gps_status_t gps_parser_parse(gps_parser_t *parser, const char *sentence, uint16_t len)
+{
+    gps_fields_t fields;
+
+    gps_parser_begin(parser);
+    //Checks to avoid segmentation fault 
+    if (sentence == NULL) { 
+        ESP_LOGE(TAG,"Pointer to NULL passed to function.\r\n");
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_PTR_TO_NULL);
     }
 
-    while (sentence_copy[i] != ',') {
-        type[i - 1] = sentence_copy[i]; // Copy character from sentence to type
-        i++;
+    //Checks to avoid using invalid sentence 
+    if (len < 3 || len > MAX_SENTENCE_LENGTH + 1 || sentence[0] != '$') {
+        ESP_LOGE(TAG, "Invalid GPS sentence.\r\n");
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
     }
-    type[i - 1] = '\0'; // Null-terminate the string in type
-    
-    if (strcmp(type, "GPGGA") == 0) {
-        ESP_LOGI(TAG, "%s",sentence_copy);
-        parse_gga(sentence_copy, len, &gps_data);
-    } else if (strcmp(type, "GPGSA") == 0) {
-        ESP_LOGI(TAG, "%s",sentence_copy);
-        parse_gsa(sentence_copy, len, &gps_data);
-    } else if (strcmp(type, "GPGSV") == 0) {
-        // Not implemented yet
-        // parse_gsv();
-        // ESP_LOGI(TAG,"GSV");
-    } else if (strcmp(type, "GPRMC") == 0) {
-        ESP_LOGI(TAG, "%s",sentence_copy);
-        parse_rmc(sentence_copy, len, &gps_data);
-    } else if (strcmp(type, "GPGLL") == 0) {
-        // Not implemented yet 
-        // parse_gll();
-        // ESP_LOGI(TAG,"GLL");
-    } else if (strcmp(type, "GPVTG") == 0) {
-        ESP_LOGI(TAG, "%s",sentence_copy);
-        parse_vtg(sentence_copy, len, &gps_data);
-    } else {
-        gps_data.status = (gps_status_t)GPS_SENTENCE_MISMATCH;
-        return gps_data;
+
+    // Sentences nobody is interested in are dropped before they are even checksummed
+    if (!gps_parser_wants(parser, sentence, len)) {
+        return gps_parser_finish(parser, gps_decode_formatter(sentence + 3), GPS_SENTENCE_IGNORED);
+    }
+
+    // Split into fields and verify the checksum, the sentence is never copied
+    gps_status_t status = tokenize(sentence, len, &fields);
+    if (status != GPS_OKAY) {
+        if (status == GPS_CRC_ERROR) {
+            ESP_LOGE(TAG,"CRC error");
+        } else {
+            ESP_LOGE(TAG, "Invalid GPS sentence.\r\n");
+        }
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, status);
     }
 
-    free(sentence_copy);
-    gps_data.status = GPS_OKAY;
-    return gps_data;
+    return gps_decode(parser, sentence, &fields);
 }
 
+/* State of the legacy single instance API, decoding everything like gps_parser_init() */
+static gps_parser_t default_parser = {
+    .sentence_mask = GPS_SENTENCES_ALL,
+    .field_mask = GPS_FIELDS_ALL,
+};
+
+gps_t gps_parse_len(const char *sentence, uint16_t len)
+{
+    gps_parser_parse(&default_parser, sentence, len);
+    return default_parser.data;
+}
+
+gps_t gps_parse(const char *sentence)
+{
+    if (sentence == NULL) {
+        return gps_parse_len(NULL, 0);
+    }
+
+    // The line ends at '\n', a sentence is never longer than MAX_SENTENCE_LENGTH
+    uint16_t len = 0;
+    while (len <= MAX_SENTENCE_LENGTH && sentence[len] != '\n' && sentence[len] != '\0') {
+        len++;
+    }
+    return gps_parse_len(sentence, len);
+}
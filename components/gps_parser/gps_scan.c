@@ -0,0 +1,167 @@
+#include "gps_scan.h"
+
+// GPS_SCAN_SWAR selects the portable kernel on hosts with SIMD, for testing
+#if defined(__SSE2__) && !defined(GPS_SCAN_SWAR)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#define SCAN_KERNEL "sse2"
+#define SCAN_WIDTH  (16)
+#define SCAN_SHIFT  (0) /*!< Mask bits per byte are 1 << SCAN_SHIFT */
+#elif defined(__ARM_NEON) && !defined(GPS_SCAN_SWAR)
+#include <arm_neon.h>
+#define SCAN_NEON
+#define SCAN_KERNEL "neon"
+#define SCAN_WIDTH  (16)
+#define SCAN_SHIFT  (2)
+#else
+// Bytes are numbered from the least significant end of a word
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "SWAR scanning assumes a little endian target");
+#define SCAN_KERNEL (sizeof(size_t) == 8 ? "swar64" : "swar32")
+#define SCAN_WIDTH  (sizeof(size_t))
+#define SCAN_SHIFT  (3)
+#define SCAN_ONES   ((size_t)-1 / 0xFF)
+#define SCAN_HIGH   (SCAN_ONES * 0x80)
+#endif
+
+static inline bool is_field_byte(uint8_t c) {
+    return (uint8_t)(c - '-') < 0x80 - '-';
+}
+
+size_t gps_scan_fields_scalar(const uint8_t *p, size_t i, size_t end, gps_fields_t *fields, uint8_t *checksum)
+{
+    uint8_t x = *checksum;
+
+    for (; i < end; i++) {
+        uint8_t c = p[i];
+        if (!is_field_byte(c)) {
+            if (c != ',' || fields->count >= GPS_MAX_FIELDS - 1) {
+                break;
+            }
+            fields->start[++fields->count] = i + 1;
+        }
+        x ^= c;
+    }
+    *checksum = x;
+    return i;
+}
+
+/* Records the commas of the block at p[i] given a mask of its bytes outside
+ * the field alphabet and a mask of its commas, and returns how many bytes
+ * belong to the sentence before the scan has to stop. */
+static inline size_t take_block(uint64_t special, uint64_t comma, size_t i, gps_fields_t *fields)
+{
+    uint64_t stop = special & ~comma;
+    size_t n = stop ? (size_t)__builtin_ctzll(stop) >> SCAN_SHIFT : SCAN_WIDTH;
+    uint64_t m = n < SCAN_WIDTH ? comma & ((1ull << (n << SCAN_SHIFT)) - 1) : comma;
+
+    while (m) {
+        size_t k = (size_t)__builtin_ctzll(m) >> SCAN_SHIFT;
+        if (fields->count >= GPS_MAX_FIELDS - 1) {
+            return k;
+        }
+        fields->start[++fields->count] = i + k + 1;
+        m &= m - 1;
+    }
+    return n;
+}
+
+// XORs the n bytes of the block at p[i] that precede the stop, returns the stop
+static inline size_t stop_in_block(const uint8_t *p, size_t i, size_t n, uint8_t *checksum)
+{
+    for (size_t k = 0; k < n; k++) {
+        *checksum ^= p[i + k];
+    }
+    return i + n;
+}
+
+size_t gps_scan_fields(const uint8_t *p, size_t i, size_t end, gps_fields_t *fields, uint8_t *checksum)
+{
+    size_t stop = end;
+
+#if defined(SCAN_SSE2)
+    const __m128i below = _mm_set1_epi8('-');
+    const __m128i commas = _mm_set1_epi8(',');
+    __m128i acc = _mm_setzero_si128();
+
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        // Signed compare, bytes above 0x7F are negative and count as below '-'
+        uint64_t special = (uint32_t)_mm_movemask_epi8(_mm_cmplt_epi8(x, below));
+        if (special) {
+            uint64_t comma = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, commas));
+            size_t n = take_block(special, comma, i, fields);
+            if (n < SCAN_WIDTH) {
+                stop = i = stop_in_block(p, i, n, checksum);
+                break;
+            }
+        }
+        acc = _mm_xor_si128(acc, x);
+    }
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+    uint32_t folded = (uint32_t)_mm_cvtsi128_si32(acc);
+#elif defined(SCAN_NEON)
+    const uint8x16_t below = vdupq_n_u8('-');
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    const uint8x16_t commas = vdupq_n_u8(',');
+    uint8x16_t acc = vdupq_n_u8(0);
+
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        uint8x16_t x = vld1q_u8(p + i);
+        uint8x16_t outside = vorrq_u8(vcltq_u8(x, below), vcgeq_u8(x, high));
+        // Narrowing shift packs the 0x00/0xFF bytes into 4 bits each
+        uint64_t special = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(outside), 4)), 0);
+        if (special) {
+            uint8x16_t eq = vceqq_u8(x, commas);
+            uint64_t comma = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+            size_t n = take_block(special, comma, i, fields);
+            if (n < SCAN_WIDTH) {
+                stop = i = stop_in_block(p, i, n, checksum);
+                break;
+            }
+        }
+        acc = veorq_u8(acc, x);
+    }
+    uint64_t folded64 = vgetq_lane_u64(vreinterpretq_u64_u8(acc), 0) ^ vgetq_lane_u64(vreinterpretq_u64_u8(acc), 1);
+    uint32_t folded = (uint32_t)folded64 ^ (uint32_t)(folded64 >> 32);
+#else
+    size_t acc = 0;
+
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        size_t x;
+        memcpy(&x, p + i, sizeof(x));
+        // High bit of every byte below '-' or above 0x7F, adding 0x80 - '-' to
+        // the low 7 bits of a byte carries into its high bit from '-' on and
+        // never into the next byte
+        size_t special = (~((x & ~SCAN_HIGH) + SCAN_ONES * (0x80 - '-')) | x) & SCAN_HIGH;
+        if (special) {
+            // Exact zero byte test of x ^ ",,,,", no false positives from borrows
+            size_t y = x ^ (SCAN_ONES * ',');
+            size_t comma = ~(((y & ~SCAN_HIGH) + ~SCAN_HIGH) | y) & SCAN_HIGH;
+            size_t n = take_block(special, comma, i, fields);
+            if (n < SCAN_WIDTH) {
+                stop = i = stop_in_block(p, i, n, checksum);
+                break;
+            }
+        }
+        acc ^= x;
+    }
+    uint32_t folded = (uint32_t)acc;
+    if (sizeof(acc) == 8) {
+        folded ^= (uint32_t)((uint64_t)acc >> 32);
+    }
+#endif
+    folded ^= folded >> 16;
+    *checksum ^= (uint8_t)(folded ^ (folded >> 8));
+
+    // The tail that does not fill a block
+    if (stop == end) {
+        i = gps_scan_fields_scalar(p, i, end, fields, checksum);
+    }
+    return i;
+}
+
+const char *gps_scan_kernel(void)
+{
+    return SCAN_KERNEL;
+}
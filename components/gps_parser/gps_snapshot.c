@@ -0,0 +1,50 @@
+#include "gps_snapshot.h"
+
+void gps_snapshot_init(gps_snapshot_t *snapshot)
+{
+    memset(&snapshot->fix, 0, sizeof(gps_epoch_fix_t));
+    atomic_init(&snapshot->seq, 0);
+}
+
+void gps_snapshot_publish(gps_snapshot_t *snapshot, const gps_epoch_fix_t *fix)
+{
+    gps_seqlock_write(&snapshot->seq, &snapshot->fix, fix, sizeof(gps_epoch_fix_t));
+}
+
+uint32_t gps_snapshot_read(const gps_snapshot_t *snapshot, gps_epoch_fix_t *out)
+{
+    return gps_seqlock_read(&snapshot->seq, &snapshot->fix, out, sizeof(gps_epoch_fix_t));
+}
+
+void gps_seqlock_write(atomic_uint *seq, void *data, const void *src, size_t size)
+{
+    unsigned int current = atomic_load_explicit(seq, memory_order_relaxed);
+    // 0 means nothing published, skip it when the counter wraps
+    unsigned int next = current + 2 ? current + 2 : 2;
+
+    atomic_store_explicit(seq, current + 1, memory_order_relaxed);
+    // The odd sequence number must be visible before any byte of the data changes
+    atomic_thread_fence(memory_order_release);
+    memcpy(data, src, size);
+    atomic_store_explicit(seq, next, memory_order_release);
+}
+
+uint32_t gps_seqlock_read(const atomic_uint *seq, const void *data, void *out, size_t size)
+{
+    for (int i = 0; i < GPS_SNAPSHOT_READ_TRIES; i++) {
+        unsigned int before = atomic_load_explicit(seq, memory_order_acquire);
+        if (before == 0) {
+            return 0;
+        }
+        if (before & 1) {
+            continue;
+        }
+        memcpy(out, data, size);
+        // The copy must be complete before seq is read again
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(seq, memory_order_relaxed) == before) {
+            return (uint32_t)before;
+        }
+    }
+    return 0;
+}
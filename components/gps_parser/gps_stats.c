@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include "gps_parser.h"
+
+uint32_t gps_histogram_percentile(const gps_histogram_t *hist, uint32_t percent)
+{
+    // Rank of the value, rounded up so that the 100th percentile is the last one
+    uint64_t rank = ((uint64_t)hist->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < GPS_STATS_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint32_t bound = i ? (1u << i) - 1 : 0;
+            return bound < hist->max ? bound : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void gps_stats_dump(const gps_parser_stats_t *stats)
+{
+    static const char *const names[GPS_SENTENCE_MAX] = {"---", "GGA", "GSA", "GSV", "RMC", "GLL", "VTG", "PVT"};
+    static const char *const statuses[GPS_STATUS_MAX] = {
+        "okay", "null", "invalid", "mismatch", "crc", "mem_low", "ignored", "inv_arg", "timeout",
+    };
+    const gps_histogram_t *hist = &stats->parse_cycles;
+
+    printf("gps stats:");
+    for (int i = 1; i < GPS_SENTENCE_MAX; i++) {
+        printf(" %s %lu", names[i], (unsigned long)stats->sentences[i]);
+    }
+    printf("\n          ");
+    for (int i = 0; i < GPS_STATUS_MAX; i++) {
+        printf(" %s %lu", statuses[i], (unsigned long)stats->status[i]);
+    }
+    printf("\n           parse cycles: mean %lu p50 %lu p99 %lu max %lu\n",
+           (unsigned long)(hist->count ? hist->sum / hist->count : 0),
+           (unsigned long)gps_histogram_percentile(hist, 50), (unsigned long)gps_histogram_percentile(hist, 99),
+           (unsigned long)hist->max);
+}
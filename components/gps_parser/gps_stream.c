@@ -0,0 +1,338 @@
+#include "gps_stream.h"
+#include "gps_scan.h"
+#include "gps_parser_priv.h"
+
+static inline int8_t hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void gps_stream_init(gps_stream_t *stream, gps_parser_t *parser, gps_stream_cb_t on_sentence, void *arg)
+{
+    memset(stream, 0, sizeof(gps_stream_t));
+    stream->parser = parser;
+    stream->on_sentence = on_sentence;
+    stream->arg = arg;
+    gps_stream_reset(stream);
+}
+
+void gps_stream_reset(gps_stream_t *stream)
+{
+    stream->state = GPS_STREAM_WAIT_START;
+    stream->len = 0;
+}
+
+static inline void start_sentence(gps_stream_t *stream)
+{
+    gps_parser_begin(stream->parser);
+    stream->buf[0] = '$';
+    stream->len = 1;
+    stream->checksum = 0;
+    stream->fields.count = 0;
+    stream->fields.start[0] = 1;
+    stream->state = GPS_STREAM_BODY;
+}
+
+// Bytes of the sentence or UBX frame being collected
+static inline uint16_t pending_bytes(const gps_stream_t *stream)
+{
+    return stream->state >= GPS_STREAM_UBX_SYNC ? stream->ubx_pos + 2 : stream->len;
+}
+
+static inline void drop_sentence(gps_stream_t *stream)
+{
+    stream->framing_errors++;
+    stream->dropped_bytes += pending_bytes(stream);
+    gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
+    gps_stream_reset(stream);
+}
+
+void gps_stream_mark_gap(gps_stream_t *stream)
+{
+    stream->gaps++;
+    // A lone sync character is no frame yet
+    if (stream->state == GPS_STREAM_UBX_SYNC) {
+        gps_stream_reset(stream);
+    } else if (stream->state != GPS_STREAM_WAIT_START) {
+        drop_sentence(stream);
+    }
+}
+
+static inline void deliver(gps_stream_t *stream, const uint8_t *frame, uint16_t len)
+{
+    stream->frame = frame;
+    stream->frame_len = len;
+    stream->sentences++;
+    if (stream->on_sentence) {
+        stream->on_sentence(&stream->parser->data, stream->arg);
+    }
+}
+
+static inline void emit_sentence(gps_stream_t *stream, const char *sentence, const gps_fields_t *fields)
+{
+    gps_decode(stream->parser, sentence, fields);
+    // Up to and including the checksum digits
+    deliver(stream, (const uint8_t *)sentence, fields->start[fields->count] + 2);
+}
+
+/* Frames the sentence that starts with the '$' at p[0] straight from the
+ * received block, without copying it. Returns the number of bytes consumed, or
+ * 0 when the sentence continues past the end of the block and has to be
+ * collected in buf instead. */
+static size_t frame_in_place(gps_stream_t *stream, const uint8_t *p, size_t avail, size_t *emitted)
+{
+    gps_fields_t *fields = &stream->fields;
+    uint8_t checksum = 0;
+    size_t end = avail < sizeof(stream->buf) - 3 ? avail : sizeof(stream->buf) - 3;
+    size_t i = 1;
+
+    fields->count = 0;
+    fields->start[0] = 1;
+    // Other bytes below '-' are part of the sentence unless they end it
+    for (;;) {
+        i = gps_scan_fields(p, i, end, fields, &checksum);
+        if (i == end || p[i] == '*' || p[i] == '$' || p[i] == '\r' || p[i] == '\n' || p[i] == ',' || p[i] >= 0x80) {
+            break;
+        }
+        checksum ^= p[i++];
+    }
+    // The rest of a sentence the parser is not interested in is skipped, however it ends
+    if (fields->count >= 1 && !gps_parser_wants(stream->parser, (const char *)p, fields->start[1])) {
+        stream->ignored++;
+        return fields->start[1];
+    }
+    if (i + 2 >= avail) {
+        return 0;
+    }
+    if (p[i] != '*' || i >= sizeof(stream->buf) - 3) {
+        // Same outcome as byte by byte framing, a '$' or a UBX sync starts the next frame
+        stream->framing_errors++;
+        stream->dropped_bytes += i;
+        gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
+        return (p[i] == '$' || p[i] == GPS_UBX_SYNC1) ? i : i + 1;
+    }
+    fields->start[++fields->count] = i + 1;
+
+    int8_t hi = hex_value(p[i + 1]);
+    int8_t lo = hex_value(p[i + 2]);
+    if (hi < 0 || lo < 0) {
+        stream->framing_errors++;
+        stream->dropped_bytes += i + 1;
+        gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
+        return i + 1;
+    }
+    if (((hi << 4) | lo) != checksum) {
+        stream->crc_errors++;
+        stream->dropped_bytes += i + 3;
+        gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_CRC_ERROR);
+    } else {
+        emit_sentence(stream, (const char *)p, fields);
+        (*emitted)++;
+    }
+    return i + 3;
+}
+
+/* Frames the UBX frame that starts with the sync character at p[0] straight
+ * from the received block, like frame_in_place(). */
+static size_t frame_ubx_in_place(gps_stream_t *stream, const uint8_t *p, size_t avail, size_t *emitted)
+{
+    uint8_t ck_a, ck_b;
+
+    if (avail < 2) {
+        return 0;
+    }
+    if (p[1] != GPS_UBX_SYNC2) {
+        return 1;
+    }
+    if (avail < GPS_UBX_HEADER_LENGTH) {
+        return 0;
+    }
+    uint16_t len = p[4] | (p[5] << 8);
+    if (len > GPS_UBX_MAX_LENGTH) {
+        stream->framing_errors++;
+        stream->dropped_bytes += GPS_UBX_HEADER_LENGTH;
+        gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
+        return GPS_UBX_HEADER_LENGTH;
+    }
+    size_t frame_len = GPS_UBX_HEADER_LENGTH + len + 2;
+    if (avail < frame_len) {
+        return 0;
+    }
+    gps_ubx_checksum(p + 2, len + 4, &ck_a, &ck_b);
+    if (ck_a != p[frame_len - 2] || ck_b != p[frame_len - 1]) {
+        stream->crc_errors++;
+        stream->dropped_bytes += frame_len;
+        gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_CRC_ERROR);
+    } else {
+        gps_decode_ubx(stream->parser, p + 2, len);
+        deliver(stream, p + 2, len + 4);
+        (*emitted)++;
+    }
+    return frame_len;
+}
+
+size_t gps_stream_feed(gps_stream_t *stream, const uint8_t *bytes, size_t n)
+{
+    size_t emitted = 0;
+    size_t dollar = 0; // Next '$' at or after i, n when there is none
+    bool dollar_known = false;
+
+    // A frame continued from the previous block is timed from this block on
+    if (stream->state != GPS_STREAM_WAIT_START) {
+        gps_parser_begin(stream->parser);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = bytes[i];
+
+        // Between frames, frame whole sentences and UBX frames in place and
+        // only fall back to collecting bytes for the one that straddles the
+        // block end. UBX frames are looked for in the gap before the next '$'
+        // only, which between NMEA sentences is just the line end.
+        if (stream->state == GPS_STREAM_WAIT_START) {
+            if (!dollar_known || dollar < i) {
+                const uint8_t *found = memchr(bytes + i, '$', n - i);
+                dollar = found ? (size_t)(found - bytes) : n;
+                dollar_known = true;
+            }
+            const uint8_t *sync = memchr(bytes + i, GPS_UBX_SYNC1, dollar - i);
+            size_t used;
+            gps_parser_begin(stream->parser);
+            if (sync != NULL) {
+                i = sync - bytes;
+                used = frame_ubx_in_place(stream, sync, n - i, &emitted);
+                c = GPS_UBX_SYNC1;
+            } else if (dollar < n) {
+                i = dollar;
+                used = frame_in_place(stream, bytes + i, n - i, &emitted);
+                c = '$';
+            } else {
+                break;
+            }
+            if (used > 0) {
+                i += used - 1;
+                continue;
+            }
+        }
+
+        // A '$' or a UBX sync always starts a new frame, a pending sentence is lost
+        if (stream->state <= GPS_STREAM_UBX_SYNC && (c == '$' || c == GPS_UBX_SYNC1)) {
+            if (stream->state != GPS_STREAM_WAIT_START && stream->state != GPS_STREAM_UBX_SYNC) {
+                drop_sentence(stream);
+            }
+            if (c == '$') {
+                start_sentence(stream);
+            } else {
+                gps_parser_begin(stream->parser);
+                stream->state = GPS_STREAM_UBX_SYNC;
+            }
+            continue;
+        }
+
+        switch (stream->state) {
+            case GPS_STREAM_WAIT_START:
+                break;
+            case GPS_STREAM_BODY:
+                // Room is needed for the '*' and the two checksum digits
+                if (c == '\r' || c == '\n' || c >= 0x80 || stream->len >= sizeof(stream->buf) - 3) {
+                    drop_sentence(stream);
+                    break;
+                }
+                stream->buf[stream->len++] = c;
+                if (c == '*') {
+                    stream->fields.start[++stream->fields.count] = stream->len;
+                    stream->state = GPS_STREAM_CRC_HI;
+                    break;
+                }
+                if (c == ',') {
+                    if (stream->fields.count >= GPS_MAX_FIELDS - 1) {
+                        drop_sentence(stream);
+                        break;
+                    }
+                    stream->fields.start[++stream->fields.count] = stream->len;
+                    // Skip the rest of a sentence the parser is not interested in
+                    if (stream->fields.count == 1 && !gps_parser_wants(stream->parser, stream->buf, stream->len)) {
+                        stream->ignored++;
+                        gps_stream_reset(stream);
+                        break;
+                    }
+                }
+                stream->checksum ^= c;
+                break;
+            case GPS_STREAM_CRC_HI:
+            case GPS_STREAM_CRC_LO: {
+                int8_t digit = hex_value(c);
+                if (digit < 0) {
+                    drop_sentence(stream);
+                    break;
+                }
+                stream->buf[stream->len++] = c;
+                if (stream->state == GPS_STREAM_CRC_HI) {
+                    stream->provided_checksum = digit << 4;
+                    stream->state = GPS_STREAM_CRC_LO;
+                    break;
+                }
+                stream->provided_checksum |= digit;
+                if (stream->provided_checksum != stream->checksum) {
+                    stream->crc_errors++;
+                    stream->dropped_bytes += stream->len;
+                    gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_CRC_ERROR);
+                } else {
+                    emit_sentence(stream, stream->buf, &stream->fields);
+                    emitted++;
+                }
+                gps_stream_reset(stream);
+                break;
+            }
+            case GPS_STREAM_UBX_SYNC:
+                if (c != GPS_UBX_SYNC2) {
+                    gps_stream_reset(stream);
+                    break;
+                }
+                stream->ubx_pos = 0;
+                stream->ck_a = 0;
+                stream->ck_b = 0;
+                stream->state = GPS_STREAM_UBX_BODY;
+                break;
+            case GPS_STREAM_UBX_BODY:
+                // Class, id, length and payload, stored as far as they fit
+                stream->ck_a += c;
+                stream->ck_b += stream->ck_a;
+                if (stream->ubx_pos < sizeof(stream->ubx)) {
+                    stream->ubx[stream->ubx_pos] = c;
+                }
+                stream->ubx_pos++;
+                if (stream->ubx_pos == 4) {
+                    stream->ubx_len = stream->ubx[2] | (stream->ubx[3] << 8);
+                    if (stream->ubx_len > GPS_UBX_MAX_LENGTH) {
+                        drop_sentence(stream);
+                        break;
+                    }
+                }
+                if (stream->ubx_pos >= 4 && stream->ubx_pos == 4 + stream->ubx_len) {
+                    stream->state = GPS_STREAM_UBX_CK_A;
+                }
+                break;
+            case GPS_STREAM_UBX_CK_A:
+                stream->provided_checksum = c;
+                stream->state = GPS_STREAM_UBX_CK_B;
+                break;
+            case GPS_STREAM_UBX_CK_B:
+                if (stream->provided_checksum != stream->ck_a || c != stream->ck_b) {
+                    stream->crc_errors++;
+                    stream->dropped_bytes += stream->ubx_pos + 4;
+                    gps_parser_finish(stream->parser, GPS_SENTENCE_UNKNOWN, GPS_CRC_ERROR);
+                } else {
+                    // Only messages short enough to be decoded were stored completely
+                    gps_decode_ubx(stream->parser, stream->ubx, stream->ubx_len);
+                    uint16_t stored = stream->ubx_pos < sizeof(stream->ubx) ? stream->ubx_pos : sizeof(stream->ubx);
+                    deliver(stream, stream->ubx, stored);
+                    emitted++;
+                }
+                gps_stream_reset(stream);
+                break;
+        }
+    }
+    return emitted;
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include "gps_parser.h"
+
+#if CONFIG_GPS_PARSER_TRACE
+
+void gps_trace_record(gps_trace_t *trace, gps_sentence_t type, gps_status_t status, const gps_t *data)
+{
+    gps_trace_entry_t *entry = &trace->entries[trace->count % CONFIG_GPS_PARSER_TRACE_DEPTH];
+
+    entry->timestamp = esp_log_timestamp();
+    entry->latitude_e7 = data->latitude_e7;
+    entry->longitude_e7 = data->longitude_e7;
+    entry->centisecond = data->time_ms % 60000 / 10;
+    entry->hour = data->tim.hour;
+    entry->minute = data->tim.minute;
+    entry->sentence = type;
+    entry->talker = data->talker;
+    entry->status = status;
+    entry->fix = data->fix;
+    trace->count++;
+}
+
+size_t gps_trace_read(const gps_trace_t *trace, gps_trace_entry_t *out, size_t max)
+{
+    uint32_t available = trace->count < CONFIG_GPS_PARSER_TRACE_DEPTH ? trace->count : CONFIG_GPS_PARSER_TRACE_DEPTH;
+    uint32_t first = trace->count - available;
+    size_t n = available < max ? available : max;
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = trace->entries[(first + i) % CONFIG_GPS_PARSER_TRACE_DEPTH];
+    }
+    return n;
+}
+
+void gps_trace_dump(const gps_trace_t *trace)
+{
+    static const char *const names[GPS_SENTENCE_MAX] = {"---", "GGA", "GSA", "GSV", "RMC", "GLL", "VTG", "PVT"};
+    uint32_t available = trace->count < CONFIG_GPS_PARSER_TRACE_DEPTH ? trace->count : CONFIG_GPS_PARSER_TRACE_DEPTH;
+
+    printf("gps trace: %lu sentences, last %lu:\n", (unsigned long)trace->count, (unsigned long)available);
+    for (uint32_t i = trace->count - available; i < trace->count; i++) {
+        const gps_trace_entry_t *e = &trace->entries[i % CONFIG_GPS_PARSER_TRACE_DEPTH];
+        printf("%8lu %s talker %u status %u fix %u %02u:%02u:%02u.%02u %ld %ld\n",
+               (unsigned long)e->timestamp, e->sentence < GPS_SENTENCE_MAX ? names[e->sentence] : "???",
+               e->talker, e->status, e->fix, e->hour, e->minute, e->centisecond / 100, e->centisecond % 100,
+               (long)e->latitude_e7, (long)e->longitude_e7);
+    }
+}
+
+#endif
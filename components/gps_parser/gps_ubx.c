@@ -0,0 +1,120 @@
+#include "sdkconfig.h"
+#define LOG_LOCAL_LEVEL CONFIG_GPS_PARSER_LOG_LEVEL
+#include "gps_ubx.h"
+#include "gps_parser_priv.h"
+
+static const char *TAG = "Parser";
+
+static inline uint16_t u2(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t u4(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int32_t i4(const uint8_t *p) {
+    return (int32_t)u4(p);
+}
+
+// NAV-PVT payload, offsets from the u-blox protocol specification
+static void parse_nav_pvt(const uint8_t *pvt, uint32_t interest, gps_t *data_struct) {
+    uint8_t fix_type = pvt[20];
+    bool fix_ok = pvt[21] & 0x01;
+    uint8_t valid = pvt[11];
+
+    // Before the receiver resolved them the date and time are guesses, e.g. its firmware's build date
+    if ((interest & GPS_FIELD_TIME) && (valid & GPS_UBX_PVT_VALID_TIME) && pvt[8] <= 23 && pvt[9] <= 59 &&
+        pvt[10] <= 60) {
+        // nano is the signed fraction of the second, -1 s to 1 s, rounded to ms
+        int32_t nano = i4(pvt + 16);
+        int32_t ms = ((pvt[8] * 60 + pvt[9]) * 60 + pvt[10]) * 1000 + (nano + (nano < 0 ? -500000 : 500000)) / 1000000;
+        if (ms < 0) {
+            ms += 86400000;
+        }
+        gps_set_time(data_struct, (uint32_t)ms % 86400000u);
+        ESP_LOGI(TAG, "Time: %d:%d:%f", data_struct->tim.hour, data_struct->tim.minute, data_struct->tim.second);
+    } else if (interest & GPS_FIELD_TIME) {
+        ESP_LOGE(TAG, "NAV-PVT time invalid.");
+    }
+    // After the time, which moves the day on at midnight until the new date is set
+    if ((interest & GPS_FIELD_DATE) && (valid & GPS_UBX_PVT_VALID_DATE) && pvt[7] >= 1 && pvt[7] <= 31 &&
+        pvt[6] >= 1 && pvt[6] <= 12) {
+        gps_set_date(data_struct, pvt[7], pvt[6], u2(pvt + 4));
+    } else if (interest & GPS_FIELD_DATE) {
+        ESP_LOGE(TAG, "NAV-PVT date invalid.");
+    }
+    if (interest & GPS_FIELD_FIX) {
+        data_struct->valid = fix_ok;
+        data_struct->fix = !fix_ok ? GPS_FIX_INVALID : (pvt[21] & 0x02) ? GPS_FIX_DGPS : GPS_FIX_GPS;
+        data_struct->fix_mode = fix_type == 2 ? GPS_MODE_2D : (fix_type == 3 || fix_type == 4) ? GPS_MODE_3D
+                                                                                                : GPS_MODE_INVALID;
+    }
+    if (interest & GPS_FIELD_SATS) {
+        data_struct->sats_in_use = pvt[23];
+    }
+    if (interest & GPS_FIELD_POSITION) {
+        data_struct->longitude_e7 = i4(pvt + 24);
+        data_struct->latitude_e7 = i4(pvt + 28);
+        data_struct->longitude = data_struct->longitude_e7 / 1e7f;
+        data_struct->latitude = data_struct->latitude_e7 / 1e7f;
+        ESP_LOGI(TAG, "latitude: %f longitude: %f", data_struct->latitude, data_struct->longitude);
+    }
+    if (interest & GPS_FIELD_ALTITUDE) {
+        int32_t height = i4(pvt + 32); // Above the ellipsoid, mm
+        int32_t msl = i4(pvt + 36);    // Above mean sea level, mm
+        data_struct->altitude = msl / 1000.0f;
+        data_struct->geoid_height = (height - msl) / 1000.0f;
+    }
+    if (interest & GPS_FIELD_SPEED) {
+        int32_t speed = i4(pvt + 60); // Ground speed, mm/s
+        data_struct->speed = speed * (3.6f / 1852.0f);
+        data_struct->speedkmh = speed * 0.0036f;
+    }
+    if (interest & GPS_FIELD_COURSE) {
+        data_struct->cog = i4(pvt + 64) * 1e-5f;
+    }
+    if (interest & GPS_FIELD_DOP) {
+        data_struct->dop_p = u2(pvt + 76) * 0.01f;
+    }
+    // Time and date are flagged by gps_set_time() and gps_set_date()
+    data_struct->fields |= interest & (GPS_FIELD_FIX | GPS_FIELD_SATS | GPS_FIELD_POSITION | GPS_FIELD_ALTITUDE |
+                                       GPS_FIELD_SPEED | GPS_FIELD_COURSE | GPS_FIELD_DOP);
+}
+
+gps_status_t gps_decode_ubx(gps_parser_t *parser, const uint8_t *msg, uint16_t len)
+{
+    if (msg[0] != GPS_UBX_CLASS_NAV || msg[1] != GPS_UBX_ID_NAV_PVT || len != GPS_UBX_NAV_PVT_LENGTH) {
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_SENTENCE_MISMATCH);
+    }
+    if (!(parser->sentence_mask & GPS_SENTENCE_BIT(GPS_SENTENCE_UBX_PVT))) {
+        return gps_parser_finish(parser, GPS_SENTENCE_UBX_PVT, GPS_SENTENCE_IGNORED);
+    }
+    parser->data.talker = GPS_TALKER_UNKNOWN;
+    parser->data.sentence = GPS_SENTENCE_UBX_PVT;
+    parser->data.fields = 0;
+    parse_nav_pvt(msg + 4, parser->field_mask, &parser->data);
+    return gps_parser_finish(parser, GPS_SENTENCE_UBX_PVT, GPS_OKAY);
+}
+
+gps_status_t gps_parser_parse_ubx(gps_parser_t *parser, const uint8_t *frame, uint16_t len)
+{
+    uint8_t ck_a, ck_b;
+
+    if (parser == NULL || frame == NULL) {
+        ESP_LOGE(TAG, "Null pointer");
+        return GPS_PTR_TO_NULL;
+    }
+    gps_parser_begin(parser);
+    if (len < GPS_UBX_HEADER_LENGTH + 2 || frame[0] != GPS_UBX_SYNC1 || frame[1] != GPS_UBX_SYNC2 ||
+        u2(frame + 4) != len - GPS_UBX_HEADER_LENGTH - 2) {
+        ESP_LOGE(TAG, "Invalid UBX frame");
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_INV_SENTENCE);
+    }
+    gps_ubx_checksum(frame + 2, len - 4, &ck_a, &ck_b);
+    if (ck_a != frame[len - 2] || ck_b != frame[len - 1]) {
+        ESP_LOGE(TAG, "UBX checksum error");
+        return gps_parser_finish(parser, GPS_SENTENCE_UNKNOWN, GPS_CRC_ERROR);
+    }
+    return gps_decode_ubx(parser, frame + 2, len - GPS_UBX_HEADER_LENGTH - 2);
+}
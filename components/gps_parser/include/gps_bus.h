@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdatomic.h>
+#include "gps_stream.h"
+
+/* Hands every decoded sentence to the components that subscribed to its type,
+ * and derived events to the ones that subscribed to those. Subscribers get the
+ * parser's state and the raw sentence by pointer, nothing is copied. The
+ * registry has a fixed number of slots and keeps one list per topic, so a
+ * sentence costs only a call per subscriber of its own type, and nothing when
+ * there is none. */
+
+#define GPS_BUS_MAX_SUBSCRIBERS (CONFIG_GPS_PARSER_BUS_SUBSCRIBERS)
+#define GPS_BUS_NONE            (0xFF) /*!< End of a subscriber list */
+
+/* Events derived from the sentences, numbered after the sentence types so that
+ * both are topics. */
+typedef enum {
+    GPS_EVENT_POSITION = GPS_SENTENCE_MAX, /*!< GGA, RMC or NAV-PVT that sent a position and a valid fix */
+    GPS_EVENT_FIX_ACQUIRED,                /*!< First sentence that sent a valid fix after none or a lost one */
+    GPS_EVENT_FIX_LOST,                    /*!< First sentence that sent an invalid fix after a valid one */
+    GPS_EVENT_TIME_VALID,                  /*!< Date and time came with a valid fix, utc_ms can be trusted from now on */
+    GPS_TOPIC_MAX,
+} gps_event_t;
+
+/* What a subscriber is called with. Everything is borrowed from the parser and
+ * the stream and only valid during the call. */
+typedef struct {
+    uint8_t topic;              /*!< gps_sentence_t or gps_event_t subscribed to */
+    const gps_t *data;          /*!< Parser state with the sentence decoded */
+    const char *sentence;       /*!< The sentence from '$' to the checksum digits or the UBX frame from its class,
+                                     not null terminated */
+    uint16_t len;               /*!< Bytes at sentence */
+    const gps_fields_t *fields; /*!< Field offsets relative to sentence, NULL for UBX frames */
+} gps_bus_msg_t;
+
+typedef void (*gps_bus_cb_t)(const gps_bus_msg_t *msg, void *arg);
+
+typedef struct {
+    gps_bus_cb_t cb;      /*!< NULL while the slot is free */
+    void *arg;            /*!< User argument of cb */
+    uint8_t topic;        /*!< Topic whose list the slot is in */
+    _Atomic uint8_t next; /*!< Next slot of the same topic, GPS_BUS_NONE at the end */
+} gps_bus_slot_t;
+
+typedef struct {
+    gps_bus_slot_t slots[GPS_BUS_MAX_SUBSCRIBERS];
+    _Atomic uint8_t head[GPS_TOPIC_MAX]; /*!< First slot of every topic, GPS_BUS_NONE without subscribers */
+    bool fixed;                          /*!< The last sentence with a fix status had a valid fix */
+    bool time_valid;                     /*!< GPS_EVENT_TIME_VALID was sent */
+    uint32_t dispatched;                 /*!< Subscriber calls so far */
+} gps_bus_t;
+
+void gps_bus_init(gps_bus_t *bus);
+
+/* Calls cb for every sentence of the type or every event topic stands for,
+ * after the ones subscribed before. Writes the slot to *handle, which may be
+ * NULL. Returns GPS_MEM_LOW when all slots are taken and GPS_INV_ARG for an
+ * unknown topic. Subscribers are linked in atomically, so another task may
+ * subscribe while the bus dispatches, but two subscribe or unsubscribe calls
+ * must not run at the same time. */
+gps_status_t gps_bus_subscribe(gps_bus_t *bus, uint8_t topic, gps_bus_cb_t cb, void *arg, uint8_t *handle);
+
+/* Frees the slot handle. Must be called from the task that dispatches, e.g.
+ * from a callback, or while nothing is dispatched: a slot removed from another
+ * task could be reused while a dispatch still walks through it. */
+void gps_bus_unsubscribe(gps_bus_t *bus, uint8_t handle);
+
+/* Calls the subscribers of data->sentence and of the events it causes, when
+ * data->status is GPS_OKAY. Events only follow the member groups the sentence
+ * sent (data->fields), an empty fix field changes nothing, so the parser's
+ * field mask must keep GPS_FIELD_FIX for any event. sentence, len and fields
+ * are handed on as they are. */
+void gps_bus_dispatch(gps_bus_t *bus, const gps_t *data, const char *sentence, uint16_t len,
+                      const gps_fields_t *fields);
+
+/* gps_bus_dispatch() of the frame stream is delivering, from its on_sentence
+ * callback. */
+static inline void gps_bus_dispatch_stream(gps_bus_t *bus, const gps_stream_t *stream)
+{
+    bool nmea = stream->frame_len > 0 && stream->frame[0] == '$';
+    gps_bus_dispatch(bus, &stream->parser->data, (const char *)stream->frame, stream->frame_len,
+                     nmea ? &stream->fields : NULL);
+}
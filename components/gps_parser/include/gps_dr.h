@@ -0,0 +1,63 @@
+#pragma once
+
+#include "gps_epoch.h"
+
+/* Dead reckoning between fixes. A receiver publishes a fix once per second,
+ * a control loop that needs the position at 50 to 100 Hz extrapolates the
+ * last fix along its speed and course instead of reusing it. All trigonometry
+ * is done once per fix, a query is a few integer multiplications. When the
+ * next fix arrives the gap between the extrapolated and the new position is
+ * faded out over blend_ms instead of jumping. error_cm is an estimate, not a
+ * bound: it assumes the fix is off by no more than GPS_DR_UERE_CM per unit of
+ * DOP and accelerates by no more than GPS_DR_ACCEL_CM_S2, so an outlier fix or
+ * a harder manoeuvre lies outside it. Not thread safe, each task that
+ * extrapolates keeps its own gps_dr_t, e.g. fed from gps_uart_get_fix(). */
+
+#define GPS_DR_UERE_CM     (500) /*!< Horizontal error of a fix per unit of HDOP */
+#define GPS_DR_ACCEL_CM_S2 (500) /*!< Largest acceleration assumed between fixes */
+
+typedef struct {
+    int32_t lat_e7;   /*!< Latitude, 1e-7 degrees */
+    int32_t lon_e7;   /*!< Longitude, 1e-7 degrees */
+    int32_t age_ms;   /*!< Time since the fix, negative before it */
+    uint32_t error_cm; /*!< Estimated horizontal error, UINT32_MAX beyond max_age_ms */
+} gps_dr_position_t;
+
+typedef struct {
+    int64_t fix_ms;        /*!< utc_ms of the last fix, 0 before the first */
+    uint32_t fix_now_ms;   /*!< Local clock when the last fix was added */
+    int32_t lat_e7;        /*!< Position of the last fix */
+    int32_t lon_e7;
+    int32_t lat_rate;      /*!< Northward speed, 1e-7 degrees per ms in Q16 */
+    int32_t lon_rate;      /*!< Eastward speed, 1e-7 degrees per ms in Q16 */
+    int32_t lat_offset;    /*!< Extrapolated minus measured position at fix_ms, faded out over blend_ms */
+    int32_t lon_offset;
+    int32_t lat_fade;      /*!< lat_offset per ms in Q16 */
+    int32_t lon_fade;
+    uint32_t offset_cm;    /*!< Length of the offset, faded out with it */
+    uint32_t offset_fade;  /*!< offset_cm per ms in Q16 */
+    uint32_t fix_error_cm; /*!< Error of the fix itself from its DOP */
+    uint32_t max_age_ms;   /*!< Age beyond which no position is extrapolated */
+    uint32_t blend_ms;     /*!< Time over which a new fix is blended in */
+    bool valid;            /*!< A fix was added */
+} gps_dr_t;
+
+void gps_dr_init(gps_dr_t *dr, uint32_t max_age_ms, uint32_t blend_ms);
+
+/* Makes an assembled epoch the origin of the extrapolation, now_ms is the
+ * local clock when it was received. Speed and course come from RMC or NAV-PVT,
+ * an epoch without them moves on at the speed between the last two fixes.
+ * Returns false and keeps the state for an epoch without a valid position
+ * or one that is not newer than the last. */
+bool gps_dr_update(gps_dr_t *dr, const gps_epoch_fix_t *fix, uint32_t now_ms);
+
+/* Extrapolated position at utc_ms. Returns false when there is no fix yet
+ * or it is older than max_age_ms, out then holds the position at max_age_ms. */
+bool gps_dr_at(const gps_dr_t *dr, int64_t utc_ms, gps_dr_position_t *out);
+
+/* UTC of the local clock reading now_ms, taking the last fix as received at
+ * its own time. Positions therefore lag by the receiver's output latency,
+ * typically 50 to 200 ms after the epoch. */
+static inline int64_t gps_dr_utc(const gps_dr_t *dr, uint32_t now_ms) {
+    return dr->fix_ms + (int32_t)(now_ms - dr->fix_now_ms);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* Serializes a gps_t back into checksummed NMEA sentences, e.g. to forward a
+ * fix to another device or to generate test streams. Numbers are formatted
+ * with integer arithmetic only, without printf. Every function writes whole
+ * sentences including "\r\n" and returns their length, or 0 and nothing
+ * useful when size is too small. What the parser decodes from the output
+ * equals data up to the precision of the fields: 1e-5 minutes of latitude
+ * and longitude, 0.01 s, 0.1 m, 0.001 knots, 0.01 degrees and 0.01 DOP. */
+
+#define GPS_ENCODE_MAX_SENTENCE (MAX_SENTENCE_LENGTH + 2) /*!< Longest sentence, "\r\n" included */
+#define GPS_ENCODE_MAX_GSV      ((GPS_MAX_SATELLITES_IN_VIEW + 3) / 4 * GPS_ENCODE_MAX_SENTENCE)
+
+/* GGA: time, position, fix, satellites in use, HDOP, altitude and geoid height. */
+size_t gps_encode_gga(const gps_t *data, gps_talker_t talker, char *out, size_t size);
+
+/* GSA: mode, fix mode, satellites in use and DOPs. */
+size_t gps_encode_gsa(const gps_t *data, gps_talker_t talker, char *out, size_t size);
+
+/* RMC: time, validity, position, speed, course and date. */
+size_t gps_encode_rmc(const gps_t *data, gps_talker_t talker, char *out, size_t size);
+
+/* VTG: course, speed in knots and in km/h. */
+size_t gps_encode_vtg(const gps_t *data, gps_talker_t talker, char *out, size_t size);
+
+/* The complete GSV group of the satellites in view reported by talker, one
+ * message per four satellites, or one empty message when there are none. */
+size_t gps_encode_gsv(const gps_t *data, gps_talker_t talker, char *out, size_t size);
+
+/* One of the functions above by sentence type, 0 for the types there is no
+ * encoder for. */
+size_t gps_encode(const gps_t *data, gps_sentence_t type, gps_talker_t talker, char *out, size_t size);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* Groups the sentences a receiver sends for one fix (GGA, GSA, GSV, RMC, VTG or
+ * UBX NAV-PVT) by their UTC time and publishes one consistent record per epoch,
+ * instead of the running mix of old and new fields a parser holds between
+ * epochs. */
+
+/* data.fields tells which member groups (gps_field_flag_t) a sentence of the
+ * epoch sent. A sentence type in sentences does not mean its fields were all
+ * there: a GGA without a fix usually has empty position fields. */
+typedef struct {
+    gps_t data;         /*!< Only the members of groups in data.fields are set, the others are 0 */
+    uint32_t sentences; /*!< GPS_SENTENCE_BIT() of every sentence type that contributed */
+} gps_epoch_fix_t;
+
+/* Sentences that carry each group of gps_t members, to tell where a group in
+ * data.fields came from by testing gps_epoch_fix_t.sentences */
+#define GPS_EPOCH_HAS_DATE     (GPS_SENTENCE_BIT(GPS_SENTENCE_RMC) | GPS_SENTENCE_BIT(GPS_SENTENCE_UBX_PVT))
+#define GPS_EPOCH_HAS_POSITION (GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_EPOCH_HAS_DATE)
+#define GPS_EPOCH_HAS_ALTITUDE (GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_UBX_PVT))
+#define GPS_EPOCH_HAS_FIX      GPS_EPOCH_HAS_ALTITUDE /*!< fix and sats_in_use, RMC only has valid */
+#define GPS_EPOCH_HAS_SPEED    (GPS_SENTENCE_BIT(GPS_SENTENCE_VTG) | GPS_EPOCH_HAS_DATE)
+#define GPS_EPOCH_HAS_COURSE   GPS_EPOCH_HAS_DATE
+#define GPS_EPOCH_HAS_FIX_MODE (GPS_SENTENCE_BIT(GPS_SENTENCE_GSA) | GPS_SENTENCE_BIT(GPS_SENTENCE_UBX_PVT))
+#define GPS_EPOCH_HAS_HDOP     (GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_GSA))
+
+/* Called once per completed epoch. */
+typedef void (*gps_epoch_cb_t)(const gps_epoch_fix_t *fix, void *arg);
+
+typedef struct {
+    gps_epoch_fix_t fix;     /*!< Epoch being assembled */
+    uint32_t time_key;       /*!< UTC time of the epoch in ms of the day */
+    bool open;               /*!< fix holds at least one sentence */
+    uint32_t last_update_ms; /*!< now_ms of the last sentence added */
+    uint32_t timeout_ms;     /*!< Silence after which an open epoch is published */
+    gps_epoch_cb_t on_fix;   /*!< Consumer of completed epochs */
+    void *arg;               /*!< User argument of on_fix */
+    uint32_t published;      /*!< Epochs published so far */
+} gps_epoch_t;
+
+void gps_epoch_init(gps_epoch_t *epoch, uint32_t timeout_ms, gps_epoch_cb_t on_fix, void *arg);
+
+/* Adds the sentence just decoded into data (data->sentence, data->status ==
+ * GPS_OKAY) to the current epoch. A sentence with a different UTC time, or one
+ * arriving after timeout_ms of silence, publishes the current epoch first.
+ * Only sentences with GPS_FIELD_TIME in data->fields open an epoch, those
+ * without it, e.g. an RMC with an empty time field, join the open one or are
+ * dropped, so the field mask of the parser must keep GPS_FIELD_TIME. */
+void gps_epoch_add(gps_epoch_t *epoch, const gps_t *data, uint32_t now_ms);
+
+/* Publishes the current epoch if nothing was added for timeout_ms. */
+void gps_epoch_poll(gps_epoch_t *epoch, uint32_t now_ms);
+
+/* Publishes the current epoch now, if there is one. */
+void gps_epoch_flush(gps_epoch_t *epoch);
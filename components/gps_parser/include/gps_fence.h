@@ -0,0 +1,112 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* Polygon geofences checked against every fix. The fences are compiled once,
+ * on the host or at start-up, into an index that is used in place, e.g. from
+ * a flash partition or a const array: a uniform grid over all fences whose
+ * cells list the fences whose bounding box overlaps them. A fix only tests
+ * the fences of its own cell, with an integer point in polygon test, so the
+ * cost per fix depends on how many fences overlap there and not on how many
+ * there are. A tracker keeps which fences the receiver is in and reports only
+ * entering and leaving them, with a margin against jitter on the boundary.
+ * Fences must not cross the antimeridian. */
+
+#define GPS_FENCE_VERSION    (1)
+#define GPS_FENCE_MAX_INSIDE (32) /*!< Fences the tracker lists as entered, beyond it the bit set is scanned */
+
+/* Number of uint32_t of the bit set of a tracker for count fences. */
+#define GPS_FENCE_WORDS(count) (((count) + 31) / 32)
+
+/* One fence to compile, vertices holds count pairs of latitude and longitude
+ * in 1e-7 degrees. The polygon is closed implicitly and may be concave. */
+typedef struct {
+    uint32_t id;             /*!< Reported in events */
+    const int32_t *vertices; /*!< lat_e7, lon_e7, lat_e7, lon_e7, ... */
+    uint16_t count;          /*!< Vertices, at least 3 */
+} gps_fence_polygon_t;
+
+typedef struct {
+    int32_t lat_min; /*!< Bounding box, 1e-7 degrees */
+    int32_t lat_max;
+    int32_t lon_min;
+    int32_t lon_max;
+    uint32_t id;     /*!< gps_fence_polygon_t.id */
+    uint32_t first;  /*!< First vertex in the vertex table */
+    uint32_t count;  /*!< Vertices */
+} gps_fence_t;
+
+/* Header of a compiled index, followed by the cell table (cells + 1 offsets
+ * into the entry table), the entry table (fence numbers), the fence table and
+ * the vertex table, all 32 bit little endian. */
+typedef struct {
+    uint8_t magic[2];      /*!< 'G', 'F' */
+    uint8_t version;       /*!< GPS_FENCE_VERSION */
+    uint8_t reserved;
+    uint32_t size;         /*!< Bytes of the whole index */
+    uint32_t fence_count;
+    uint32_t vertex_count;
+    uint32_t entry_count;
+    uint16_t rows;         /*!< Grid cells north to south */
+    uint16_t cols;         /*!< Grid cells west to east */
+    int32_t lat_min;       /*!< South west corner of the grid */
+    int32_t lon_min;
+    int32_t cell_lat;      /*!< Cell size, 1e-7 degrees */
+    int32_t cell_lon;
+} gps_fence_index_t;
+
+static inline const uint32_t *gps_fence_cells(const gps_fence_index_t *index) {
+    return (const uint32_t *)(index + 1);
+}
+
+static inline const uint32_t *gps_fence_entries(const gps_fence_index_t *index) {
+    return gps_fence_cells(index) + (uint32_t)index->rows * index->cols + 1;
+}
+
+static inline const gps_fence_t *gps_fence_table(const gps_fence_index_t *index) {
+    return (const gps_fence_t *)(gps_fence_entries(index) + index->entry_count);
+}
+
+static inline const int32_t *gps_fence_vertices(const gps_fence_index_t *index) {
+    return (const int32_t *)(gps_fence_table(index) + index->fence_count);
+}
+
+/* Compiles count fences into out, which must be 4 byte aligned. Returns the
+ * size of the index, out is only written when size is at least that, so a
+ * first call with out NULL tells how much to allocate. Returns 0 for a fence
+ * with fewer than 3 vertices. */
+size_t gps_fence_build(const gps_fence_polygon_t *fences, size_t count, void *out, size_t size);
+
+/* Checks a compiled index of size bytes at data, e.g. a partition that may be
+ * erased or damaged: the header, the size and that every cell offset, entry
+ * and vertex range stays inside its table. Returns it as an index or NULL. */
+const gps_fence_index_t *gps_fence_load(const void *data, size_t size);
+
+/* True if the point is inside fence number fence of index. A point exactly
+ * on an edge may count as either. */
+bool gps_fence_contains(const gps_fence_index_t *index, uint32_t fence, int32_t lat_e7, int32_t lon_e7);
+
+/* Called when the receiver enters (inside true) or leaves a fence. */
+typedef void (*gps_fence_cb_t)(uint32_t id, bool inside, void *arg);
+
+typedef struct {
+    const gps_fence_index_t *index;
+    uint32_t *inside;                      /*!< One bit per fence, GPS_FENCE_WORDS(fence_count) words owned by the caller */
+    uint32_t active[GPS_FENCE_MAX_INSIDE]; /*!< Fence numbers whose bit is set */
+    uint8_t active_count;                  /*!< Entries in active */
+    bool overflow;                         /*!< More fences were entered than active holds */
+    float margin_m;                        /*!< Distance past the boundary before a change counts */
+    gps_fence_cb_t on_event;               /*!< Consumer of the events */
+    void *arg;                             /*!< User argument of on_event */
+    uint32_t events;                       /*!< Events reported so far */
+} gps_fence_tracker_t;
+
+/* Starts outside every fence. inside must hold GPS_FENCE_WORDS(fence_count)
+ * words. A fence is only entered once the position is margin_m inside its
+ * boundary and only left once it is margin_m outside. */
+void gps_fence_tracker_init(gps_fence_tracker_t *tracker, const gps_fence_index_t *index, uint32_t *inside,
+                            float margin_m, gps_fence_cb_t on_event, void *arg);
+
+/* Checks one position, e.g. the latitude_e7 and longitude_e7 of a fix, and
+ * reports the fences entered and left since the last one. */
+void gps_fence_check(gps_fence_tracker_t *tracker, int32_t lat_e7, int32_t lon_e7);
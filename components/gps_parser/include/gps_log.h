@@ -0,0 +1,97 @@
+#pragma once
+
+#include "gps_epoch.h"
+
+/* Compact binary log of assembled fixes, for logging to flash instead of raw
+ * NMEA. The log is a sequence of blocks, normally one flash sector each. A
+ * block starts with a 3 byte header and a keyframe that holds every value,
+ * followed by records that only hold what changed since the record before,
+ * as zigzag varint deltas of fixed-point values. A typical 1 Hz fix takes
+ * around 10 bytes instead of the 300 and more of its NMEA sentences.
+ *
+ * A record never crosses a block boundary, the rest of a block that cannot
+ * hold the next record is left 0xFF, like erased flash. Every block can be
+ * decoded on its own, which gives random access by time and limits the damage
+ * of a corrupted block to that block.
+ *
+ * Values are stored at these resolutions: time 1 ms, position 1e-7 degrees,
+ * altitude 0.1 m, speed 0.01 knots, course 0.01 degrees, HDOP 0.01. */
+
+#define GPS_LOG_BLOCK_SIZE  (4096) /*!< Default block size, one ESP32 flash sector */
+#define GPS_LOG_MAX_RECORD  (48)   /*!< Largest encoded record, block header included */
+#define GPS_LOG_MAGIC1      ('G')
+#define GPS_LOG_MAGIC2      ('L')
+#define GPS_LOG_VERSION     (1)
+
+typedef struct {
+    gps_date_t date;     /*!< Fix date */
+    uint32_t time_ms;    /*!< UTC time of the day, ms */
+    int32_t lat_e7;      /*!< Latitude, 1e-7 degrees */
+    int32_t lon_e7;      /*!< Longitude, 1e-7 degrees */
+    int32_t alt_dm;      /*!< Altitude above mean sea level, 0.1 m */
+    int32_t speed_ckn;   /*!< Ground speed, 0.01 knots */
+    int32_t course_cdeg; /*!< Course over ground, 0.01 degrees */
+    uint16_t hdop_c;     /*!< Horizontal dilution of precision, 0.01 */
+    uint8_t fix;         /*!< gps_fix_t */
+    uint8_t fix_mode;    /*!< gps_fix_mode_t */
+    bool valid;          /*!< RMC validity */
+    uint8_t sats;        /*!< Satellites in use */
+} gps_log_record_t;
+
+/* Stores len encoded bytes, e.g. into a flash page buffer or a file. Stores
+ * either all of them or, returning false, none: the reader finds blocks at
+ * multiples of the block size, so the writer must know exactly where the
+ * output stands. */
+typedef bool (*gps_log_write_t)(const uint8_t *data, size_t len, void *arg);
+
+typedef struct {
+    gps_log_write_t write;  /*!< Output of the encoded bytes */
+    void *arg;              /*!< User argument of write */
+    uint32_t block_size;    /*!< Bytes per block */
+    uint32_t offset;        /*!< Bytes written into the current block */
+    gps_log_record_t last;  /*!< Previous record, the base of the next delta */
+    uint32_t records;       /*!< Records written */
+    uint32_t bytes;         /*!< Bytes written, padding included */
+    bool padding;           /*!< The current block is being padded, it takes no more records */
+} gps_log_writer_t;
+
+typedef struct {
+    const uint8_t *data;    /*!< Log being read */
+    size_t size;            /*!< Bytes at data */
+    uint32_t block_size;    /*!< Bytes per block */
+    size_t pos;             /*!< Offset of the next record */
+    gps_log_record_t last;  /*!< Previous record, the base of the next delta */
+    uint32_t bad_blocks;    /*!< Blocks skipped because they were erased or corrupted */
+} gps_log_reader_t;
+
+/* Converts the members of an epoch to a record. Members the epoch did not
+ * carry, e.g. the speed of an epoch without RMC or VTG, keep the value of
+ * prev, which may be NULL. */
+void gps_log_record_from_fix(const gps_epoch_fix_t *fix, const gps_log_record_t *prev, gps_log_record_t *rec);
+
+/* Writes the encoded records through write. The writer itself holds no
+ * buffer beyond one record on the stack, so it can run in the parser task. */
+void gps_log_writer_init(gps_log_writer_t *writer, uint32_t block_size, gps_log_write_t write, void *arg);
+
+/* Appends one record. Returns false when write failed, the record is then
+ * dropped and the next one continues the block where it would have gone, or
+ * finishes padding it. */
+bool gps_log_write(gps_log_writer_t *writer, const gps_log_record_t *rec);
+
+/* Appends the record of an assembled epoch, for use from a gps_epoch_cb_t. */
+bool gps_log_write_fix(gps_log_writer_t *writer, const gps_epoch_fix_t *fix);
+
+void gps_log_reader_init(gps_log_reader_t *reader, const uint8_t *data, size_t size, uint32_t block_size);
+
+/* Decodes the next record into rec. Returns false at the end of the log. */
+bool gps_log_read(gps_log_reader_t *reader, gps_log_record_t *rec);
+
+/* UTC milliseconds since 1970-01-01 of the date and time of rec, like
+ * gps_t.utc_ms, for ordering. Records before the first date count from 0. */
+uint64_t gps_log_record_key(const gps_log_record_t *rec);
+
+/* Positions the reader at the start of the last block whose keyframe is not
+ * later than key, so that the next reads reach the record of key after at
+ * most one block. Blocks must be in time order. Returns false when the log
+ * starts after key, the reader is then at the first block. */
+bool gps_log_seek(gps_log_reader_t *reader, uint64_t key);
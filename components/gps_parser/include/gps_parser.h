@@ -5,18 +5,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "sdkconfig.h"
 #include "esp_log.h"
 
 
-#define GMT 5
 #define GPS_MAX_SATELLITES_IN_USE (12)
-#define GPS_MAX_SATELLITES_IN_VIEW (16)
+#define GPS_MAX_SATELLITES_IN_VIEW (CONFIG_GPS_PARSER_MAX_SATELLITES_IN_VIEW) /*!< All constellations together */
 #define MAX_SENTENCE_LENGTH 82
-
-#define DEBUG_GGA 1
-#define DEBUG_GSA 1
-#define DEBUG_RMC 1
-#define DEBUG_VTG 1
+#define GPS_MAX_FIELDS (24)         /*!< Most fields in any supported sentence, address included */
 
 typedef enum {
     GPS_MODE_INVALID = 1, /*!< Not fixed */
@@ -31,10 +27,10 @@ typedef enum {
 } gps_fix_t;
 
 typedef struct {
+    float second;      /*!< Second */
+    uint16_t thousand; /*!< Millisecond of the second */
     uint8_t hour;      /*!< Hour */
     uint8_t minute;    /*!< Minute */
-    float second;    /*!< Second */
-    uint16_t thousand; /*!< Thousand */
 } gps_time_t;
 
 typedef struct {
@@ -42,14 +38,58 @@ typedef struct {
     uint8_t elevation; /*!< Satellite elevation */
     uint16_t azimuth;  /*!< Satellite azimuth */
     uint8_t snr;       /*!< Satellite signal noise ratio */
+    uint8_t talker;    /*!< gps_talker_t of the GSV group that reported it, i.e. the constellation */
 } gps_satellite_t;
 
 typedef struct {
     uint8_t day;   /*!< Day (start from 1) */
     uint8_t month; /*!< Month (start from 1) */
-    uint16_t year; /*!< Year (start from 2000) */
+    uint16_t year; /*!< Year, e.g. 2024, 0 before a date was received */
 } gps_date_t;
 
+typedef enum {
+    GPS_TALKER_UNKNOWN, /*!< Talker not listed below */
+    GPS_TALKER_GP,      /*!< GPS */
+    GPS_TALKER_GL,      /*!< GLONASS */
+    GPS_TALKER_GA,      /*!< Galileo */
+    GPS_TALKER_GB,      /*!< BeiDou */
+    GPS_TALKER_BD,      /*!< BeiDou, older receivers */
+    GPS_TALKER_GQ,      /*!< QZSS */
+    GPS_TALKER_GI,      /*!< NavIC */
+    GPS_TALKER_GN,      /*!< Combined multi-constellation solution */
+} gps_talker_t;
+
+typedef enum {
+    GPS_SENTENCE_UNKNOWN,
+    GPS_SENTENCE_GGA,     /*!< Fix data */
+    GPS_SENTENCE_GSA,     /*!< DOP and active satellites */
+    GPS_SENTENCE_GSV,     /*!< Satellites in view */
+    GPS_SENTENCE_RMC,     /*!< Recommended minimum data */
+    GPS_SENTENCE_GLL,     /*!< Geographic position */
+    GPS_SENTENCE_VTG,     /*!< Course and speed over ground */
+    GPS_SENTENCE_UBX_PVT, /*!< u-blox UBX-NAV-PVT binary navigation solution */
+    GPS_SENTENCE_MAX,
+} gps_sentence_t;
+
+#define GPS_SENTENCE_BIT(type) (1u << (type))
+#define GPS_SENTENCES_ALL      (((1u << GPS_SENTENCE_MAX) - 1) & ~GPS_SENTENCE_BIT(GPS_SENTENCE_UNKNOWN))
+
+/* Groups of gps_t members, used to select what the decoders fill in */
+typedef enum {
+    GPS_FIELD_TIME         = 1 << 0, /*!< tim */
+    GPS_FIELD_DATE         = 1 << 1, /*!< date */
+    GPS_FIELD_POSITION     = 1 << 2, /*!< latitude, longitude */
+    GPS_FIELD_ALTITUDE     = 1 << 3, /*!< altitude, geoid_height */
+    GPS_FIELD_FIX          = 1 << 4, /*!< fix, valid, fix_mode, mode */
+    GPS_FIELD_SATS         = 1 << 5, /*!< sats_in_use */
+    GPS_FIELD_DOP          = 1 << 6, /*!< dop_h, dop_p, dop_v */
+    GPS_FIELD_SPEED        = 1 << 7, /*!< speed, speedkmh */
+    GPS_FIELD_COURSE       = 1 << 8, /*!< cog */
+    GPS_FIELD_SATS_IN_VIEW = 1 << 9, /*!< sats_in_view, sats_desc_in_view */
+} gps_field_flag_t;
+
+#define GPS_FIELDS_ALL (0x3FF)
+
 typedef enum {
     GPS_OKAY,
     GPS_PTR_TO_NULL,
@@ -57,32 +97,127 @@ typedef enum {
     GPS_SENTENCE_MISMATCH,
     GPS_CRC_ERROR,
     GPS_MEM_LOW,
+    GPS_SENTENCE_IGNORED, /*!< Valid sentence type excluded by gps_parser_set_interest() */
+    GPS_INV_ARG,          /*!< Value the receiver command cannot express */
+    GPS_TIMEOUT,          /*!< Receiver did not answer in time */
+    GPS_STATUS_MAX,
 } gps_status_t;
 
+/* Decoded state. The members every fix consumer reads come first and fit one
+ * 64 byte cache line, the satellites, DOPs and float copies follow. Enums are
+ * stored in a byte each. */
 typedef struct {
-    char current_sentence_type[6];
-    float latitude;                                                /*!< Latitude (degrees) */
-    float longitude;                                               /*!< Longitude (degrees) */
+    int64_t utc_ms;                                                /*!< UTC ms since 1970-01-01 of date and time_ms, sortable */
+    int32_t latitude_e7;                                           /*!< Latitude (1e-7 degrees), exact, north positive */
+    int32_t longitude_e7;                                          /*!< Longitude (1e-7 degrees), exact, east positive */
+    uint32_t time_ms;                                              /*!< UTC time of the day (ms), tim as one integer */
+    int32_t utc_day;                                               /*!< Day of utc_ms, days since 1970-01-01, moves on at midnight before the date */
     float altitude;                                                /*!< Altitude (meters) */
-    float geoid_height;                                            /*!< Height above or below the WGS84 ellipsoid (meters) */
-    gps_fix_t fix;                                                 /*!< Fix status */
-    uint8_t sats_in_use;                                           /*!< Number of satellites in use */
+    float speed;                                                   /*!< Ground speed, unit: knots */
+    float speedkmh;                                                /*!< Ground speed, unit: km/h */
+    float cog;                                                     /*!< Course over ground */
     gps_time_t tim;                                                /*!< time in UTC */
-    gps_fix_mode_t fix_mode;                                       /*!< Fix mode */
-    char mode;
-    uint8_t sats_id_in_use[GPS_MAX_SATELLITES_IN_USE];             /*!< ID list of satellite in use */
+    gps_date_t date;                                               /*!< Fix date */
+    uint8_t fix;                                                   /*!< gps_fix_t */
+    uint8_t fix_mode;                                              /*!< gps_fix_mode_t */
+    bool valid;                                                    /*!< GPS validity */
+    uint8_t sats_in_use;                                           /*!< Number of satellites in use */
+    uint8_t sentence;                                              /*!< gps_sentence_t of the last decoded sentence */
+    uint8_t talker;                                                /*!< gps_talker_t of the last decoded sentence */
+    uint8_t status;                                                /*!< gps_status_t of the last sentence */
+    char mode;                                                     /*!< GSA selection mode, 'A' automatic or 'M' manual */
+
+    float latitude;                                                /*!< Latitude (degrees), float copy of latitude_e7 */
+    float longitude;                                               /*!< Longitude (degrees), float copy of longitude_e7 */
+    float geoid_height;                                            /*!< Height above or below the WGS84 ellipsoid (meters) */
     float dop_h;                                                   /*!< Horizontal dilution of precision */
     float dop_p;                                                   /*!< Position dilution of precision  */
     float dop_v;                                                   /*!< Vertical dilution of precision  */
-    uint8_t sats_in_view;                                          /*!< Number of satellites in view */
-    gps_satellite_t sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW]; /*!< Information of satellites in view */
-    gps_date_t date;                                               /*!< Fix date */
-    bool valid;                                                    /*!< GPS validity */
-    float speed;                                                   /*!< Ground speed, unit: knots */
-    float speedkmh;                                                /*!< Ground speed, unit: km/h */
-    float cog;                                                     /*!< Course over ground */
     float variation;                                               /*!< Magnetic variation */
-    gps_status_t status;                                           /*!< gps status */
+    int32_t date_day;                                              /*!< date in days since 1970-01-01, utc_day is set from it */
+    uint16_t fields;                                               /*!< gps_field_flag_t of the members the last sentence set */
+    uint8_t sats_id_in_use[GPS_MAX_SATELLITES_IN_USE];             /*!< ID list of satellite in use */
+    uint8_t sats_in_view;                                          /*!< Entries in sats_desc_in_view, all constellations */
+    gps_satellite_t sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW]; /*!< Satellites of the last complete GSV group of each talker */
 } gps_t;
 
+/* Bytes of the members every fix consumer reads, up to latitude */
+#define GPS_T_HOT_SIZE (offsetof(gps_t, latitude))
+_Static_assert(GPS_T_HOT_SIZE <= 64, "the fix members of gps_t must fit one cache line");
+// 47 bytes of floats, the date's day, field flags and satellite ids follow the hot members, the rest is padding
+_Static_assert(sizeof(gps_t) <= 64 + 48 + GPS_MAX_SATELLITES_IN_VIEW * sizeof(gps_satellite_t),
+               "gps_t grew, it is copied into every epoch and snapshot");
+
+/* Offsets of the fields of one sentence, relative to the '$'. Field i starts at
+ * start[i] and ends one character before start[i + 1], which is its ',' or '*'
+ * delimiter. start[count] is the sentinel just past the '*'. */
+typedef struct {
+    uint8_t count;
+    uint8_t start[GPS_MAX_FIELDS + 1];
+} gps_fields_t;
+
+#include "gps_trace.h"
+#include "gps_stats.h"
+
+/* GSV group being received. A talker reports its satellites in up to 9
+ * messages, they are staged here and replace that talker's satellites in
+ * gps_t only once the last message arrived, so gps_t never holds half a
+ * group. */
+typedef struct {
+    gps_satellite_t sats[GPS_MAX_SATELLITES_IN_VIEW]; /*!< Satellites of the group so far */
+    uint8_t count;                                    /*!< Entries in sats */
+    uint8_t next;                                     /*!< Message number expected next, 0 when no group is open */
+    uint8_t total;                                    /*!< Messages in the group */
+    uint8_t talker;                                   /*!< gps_talker_t of the group */
+} gps_gsv_stage_t;
+
+/* Parser instance. Every instance is independent, so any number of receivers
+ * or replays can be parsed concurrently as long as each one is only used by a
+ * single task at a time. */
+typedef struct {
+    gps_t data;             /*!< Accumulated state, updated by every decoded sentence */
+    uint32_t sentence_mask; /*!< GPS_SENTENCE_BIT() of the sentence types decoded */
+    uint32_t field_mask;    /*!< gps_field_flag_t of the gps_t members decoded */
+    gps_gsv_stage_t gsv;    /*!< Satellites of an incomplete GSV group */
+#if CONFIG_GPS_PARSER_TRACE
+    gps_trace_t trace;      /*!< Outcome of the most recent sentences */
+#endif
+#if CONFIG_GPS_PARSER_STATS
+    gps_parser_stats_t stats; /*!< Outcomes and parse cost since init */
+#endif
+} gps_parser_t;
+
+/* Initialises the parser to decode every sentence type and field. */
+void gps_parser_init(gps_parser_t *parser);
+
+/* Restricts decoding to the sentence types in sentences (GPS_SENTENCE_BIT()
+ * masks) and to the gps_t members in fields (gps_field_flag_t masks). Other
+ * sentence types are dropped right after their address is read with status
+ * GPS_SENTENCE_IGNORED, other fields are skipped without being converted. */
+void gps_parser_set_interest(gps_parser_t *parser, uint32_t sentences, uint32_t fields);
+
+/* Clears the decoded state, e.g. after switching to another receiver. */
+void gps_parser_reset(gps_parser_t *parser);
+
+/* Parses the sentence held in sentence[0..len) in place into parser->data, the
+ * buffer does not have to be null terminated. No heap memory is used. The
+ * result is also stored in parser->data.status. */
+gps_status_t gps_parser_parse(gps_parser_t *parser, const char *sentence, uint16_t len);
+
+/* Days since 1970-01-01 of a Gregorian date, negative before, and back. */
+int32_t gps_days_from_civil(const gps_date_t *date);
+void gps_civil_from_days(int32_t days, gps_date_t *date);
+
+/* Offset of the local time from UTC in minutes east, for presentation only.
+ * Decoded data is always UTC, the offset is applied by gps_local_time() and
+ * the log output. Defaults to CONFIG_GPS_PARSER_UTC_OFFSET. */
+void gps_set_utc_offset(int16_t minutes);
+int16_t gps_get_utc_offset(void);
+
+/* Local date and time of utc_ms, e.g. gps_t.utc_ms, with the offset above. */
+void gps_local_time(int64_t utc_ms, gps_date_t *date, gps_time_t *tim);
+
+/* Single instance wrappers kept for existing callers. They share one hidden
+ * parser and are therefore not reentrant. */
 gps_t gps_parse(const char *sentence);
+gps_t gps_parse_len(const char *sentence, uint16_t len);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* Field scanning kernel shared by gps_parser_parse() and the streaming framer.
+ * Almost every byte of a sentence is a letter, a digit, '.' or '-', so the
+ * kernel tests a whole word or vector of bytes at once for anything else and
+ * only looks at single bytes where a delimiter was found. It uses SSE2 or NEON
+ * where the compiler targets them and portable word at a time (SWAR) code
+ * everywhere else, including the ESP32. */
+
+/* Scans p[i..end), XORs every byte into *checksum and records every ',' in
+ * fields as the start of the next field. Stops at the first byte below '-' or
+ * above 0x7F that is not a ',', or at a ',' when fields already holds
+ * GPS_MAX_FIELDS - 1 fields. Returns the index of that byte, which is neither
+ * XORed nor recorded, or end. */
+size_t gps_scan_fields(const uint8_t *p, size_t i, size_t end, gps_fields_t *fields, uint8_t *checksum);
+
+/* Byte at a time reference of gps_scan_fields(), same results. */
+size_t gps_scan_fields_scalar(const uint8_t *p, size_t i, size_t end, gps_fields_t *fields, uint8_t *checksum);
+
+/* Name of the kernel gps_scan_fields() was built with: "sse2", "neon",
+ * "swar64" or "swar32". */
+const char *gps_scan_kernel(void);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdatomic.h>
+#include "gps_epoch.h"
+
+/* Publishes the latest fix from the task that parses the receiver to any
+ * number of readers, on either core, without locks. This is a seqlock: the
+ * writer makes seq odd, copies the fix and makes seq even again, a reader
+ * copies the fix and keeps the copy only if seq was even and unchanged.
+ * There must be a single writer. */
+
+#define GPS_SNAPSHOT_READ_TRIES (4)
+
+typedef struct {
+    atomic_uint seq;      /*!< Odd while the writer is copying, +2 per publish, 0 before the first */
+    gps_epoch_fix_t fix;  /*!< Last published fix */
+} gps_snapshot_t;
+
+void gps_snapshot_init(gps_snapshot_t *snapshot);
+
+/* Makes fix the current snapshot. Never blocks. */
+void gps_snapshot_publish(gps_snapshot_t *snapshot, const gps_epoch_fix_t *fix);
+
+/* Copies the current snapshot into out and returns its sequence number, which
+ * is even and grows with every publish. Returns 0 when nothing was published
+ * yet or when the writer was busy during GPS_SNAPSHOT_READ_TRIES attempts,
+ * out is undefined then. The reader never waits for the writer, a reader that
+ * preempted the writer on the same core would otherwise spin forever. */
+uint32_t gps_snapshot_read(const gps_snapshot_t *snapshot, gps_epoch_fix_t *out);
+
+/* The same seqlock for any plain struct of size bytes at data, guarded by seq,
+ * e.g. counters that one task updates and others read. */
+void gps_seqlock_write(atomic_uint *seq, void *data, const void *src, size_t size);
+uint32_t gps_seqlock_read(const atomic_uint *seq, const void *data, void *out, size_t size);
@@ -0,0 +1,47 @@
+#pragma once
+
+/* Counters and latency histograms of a parser. Counting a sentence is a few
+ * increments and two reads of the CPU cycle counter, nothing is formatted or
+ * locked. Enabled with CONFIG_GPS_PARSER_STATS. Included by gps_parser.h. */
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+
+#define GPS_STATS_BUCKETS (24)
+
+/* Histogram with power of two buckets: buckets[0] counts the value 0,
+ * buckets[i] the values in [2^(i-1), 2^i), the last bucket everything above. */
+typedef struct {
+    uint32_t buckets[GPS_STATS_BUCKETS];
+    uint32_t count; /*!< Values added */
+    uint32_t max;   /*!< Largest value added */
+    uint64_t sum;   /*!< Sum of the values added */
+} gps_histogram_t;
+
+typedef struct {
+    uint32_t sentences[GPS_SENTENCE_MAX]; /*!< Sentences decoded with GPS_OKAY, per gps_sentence_t */
+    uint32_t status[GPS_STATUS_MAX];      /*!< Outcomes, per gps_status_t */
+    gps_histogram_t parse_cycles;         /*!< CPU cycles from the first byte to the decoded sentence */
+    uint32_t start;                       /*!< Cycle count when the current sentence was started */
+} gps_parser_stats_t;
+
+static inline uint32_t gps_cycles(void) {
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+static inline void gps_histogram_add(gps_histogram_t *hist, uint32_t value) {
+    uint32_t bucket = value ? 32 - __builtin_clz(value) : 0;
+    hist->buckets[bucket < GPS_STATS_BUCKETS ? bucket : GPS_STATS_BUCKETS - 1]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+/* Upper bound of the bucket that holds the given percentile, 0 when empty. */
+uint32_t gps_histogram_percentile(const gps_histogram_t *hist, uint32_t percent);
+
+/* Prints the counters and the parse cost of stats. */
+void gps_stats_dump(const gps_parser_stats_t *stats);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "gps_parser.h"
+#include "gps_ubx.h"
+
+/* Called for every framed sentence or UBX frame whose checksum matched with the
+ * state of the stream's parser. data->status tells whether the decoder
+ * recognised it. The frame itself is in the stream's frame and frame_len
+ * during the call. */
+typedef void (*gps_stream_cb_t)(const gps_t *data, void *arg);
+
+typedef enum {
+    GPS_STREAM_WAIT_START, /*!< Skipping bytes until the next '$' or UBX sync */
+    GPS_STREAM_BODY,       /*!< Between '$' and '*' */
+    GPS_STREAM_CRC_HI,     /*!< Expecting the first checksum digit */
+    GPS_STREAM_CRC_LO,     /*!< Expecting the second checksum digit */
+    GPS_STREAM_UBX_SYNC,   /*!< Expecting the second UBX sync character */
+    GPS_STREAM_UBX_BODY,   /*!< Between the sync characters and the UBX checksum */
+    GPS_STREAM_UBX_CK_A,   /*!< Expecting the first UBX checksum byte */
+    GPS_STREAM_UBX_CK_B,   /*!< Expecting the second UBX checksum byte */
+} gps_stream_state_t;
+
+typedef struct {
+    union {
+        char buf[MAX_SENTENCE_LENGTH + 1];       /*!< Sentence split across two feeds, '$' up to the checksum */
+        uint8_t ubx[4 + GPS_UBX_NAV_PVT_LENGTH]; /*!< UBX frame split across two feeds, class up to the payload */
+    };
+    uint8_t len;                        /*!< Bytes in buf */
+    uint16_t ubx_len;                   /*!< Payload length of the UBX frame */
+    uint16_t ubx_pos;                   /*!< UBX bytes received after the sync, stored as far as ubx holds them */
+    uint8_t ck_a;                       /*!< Running UBX checksum */
+    uint8_t ck_b;                       /*!< Running UBX checksum */
+    gps_stream_state_t state;           /*!< Framer state */
+    uint8_t checksum;                   /*!< Running XOR of the sentence body */
+    uint8_t provided_checksum;          /*!< Checksum digits received so far */
+    gps_fields_t fields;                /*!< Field offsets found so far, of frame during on_sentence */
+    const uint8_t *frame;               /*!< Frame being delivered, '$' up to the checksum digits or UBX class up to
+                                             the payload as far as ubx holds it, in the fed bytes or in buf or ubx.
+                                             Only valid during on_sentence */
+    uint16_t frame_len;                 /*!< Bytes at frame */
+    gps_parser_t *parser;               /*!< Decoder the sentences are handed to */
+    gps_stream_cb_t on_sentence;        /*!< Sentence consumer */
+    void *arg;                          /*!< User argument of on_sentence */
+    uint32_t sentences;                 /*!< Sentences handed to the decoder */
+    uint32_t crc_errors;                /*!< Sentences dropped on checksum mismatch */
+    uint32_t framing_errors;            /*!< Sentences dropped as truncated, too long or malformed */
+    uint32_t ignored;                   /*!< Sentences skipped by the parser's interest mask */
+    uint32_t dropped_bytes;             /*!< Bytes of sentences dropped by framing and checksum errors */
+    uint32_t gaps;                      /*!< Gaps reported with gps_stream_mark_gap() */
+} gps_stream_t;
+
+void gps_stream_init(gps_stream_t *stream, gps_parser_t *parser, gps_stream_cb_t on_sentence, void *arg);
+
+/* Discards any partial sentence, the next byte is expected to be a '$' or a
+ * UBX sync. */
+void gps_stream_reset(gps_stream_t *stream);
+
+/* Tells the framer that received bytes were lost before the next feed, e.g.
+ * on a UART overflow. Only the sentence cut by the gap is dropped, sentences
+ * already fed have been decoded and framing resumes at the next '$' or UBX
+ * sync. */
+void gps_stream_mark_gap(gps_stream_t *stream);
+
+/* Feeds n received bytes of any chunking into the framer. NMEA sentences and
+ * UBX frames may be interleaved. Frames that lie completely inside bytes are
+ * scanned once, validated and decoded in place. A frame cut by the end of
+ * bytes is scanned in place up to the end first, then scanned again byte by
+ * byte from its start while it is copied into buf or ubx, so its bytes in
+ * this block are read twice; its bytes in the next block are read once. UBX
+ * frames with payloads longer than NAV-PVT are checked and skipped without
+ * being stored. Returns the number of frames handed to the decoder. */
+size_t gps_stream_feed(gps_stream_t *stream, const uint8_t *bytes, size_t n);
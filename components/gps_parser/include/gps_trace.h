@@ -0,0 +1,40 @@
+#pragma once
+
+/* Binary trace of the sentences a parser handled. Recording an entry is a
+ * handful of stores into a fixed ring, nothing is formatted until the ring is
+ * dumped. Enabled with CONFIG_GPS_PARSER_TRACE. Included by gps_parser.h. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+#if CONFIG_GPS_PARSER_TRACE
+
+typedef struct {
+    uint32_t timestamp;   /*!< esp_log_timestamp() when the sentence was handled (ms) */
+    int32_t latitude_e7;  /*!< Latitude after the sentence (1e-7 degrees) */
+    int32_t longitude_e7; /*!< Longitude after the sentence (1e-7 degrees) */
+    uint16_t centisecond; /*!< UTC second after the sentence (1/100 s) */
+    uint8_t hour;         /*!< UTC hour after the sentence */
+    uint8_t minute;       /*!< UTC minute after the sentence */
+    uint8_t sentence;     /*!< gps_sentence_t, GPS_SENTENCE_UNKNOWN if it was not identified */
+    uint8_t talker;       /*!< gps_talker_t */
+    uint8_t status;       /*!< gps_status_t */
+    uint8_t fix;          /*!< gps_fix_t after the sentence */
+} gps_trace_entry_t;
+
+typedef struct {
+    gps_trace_entry_t entries[CONFIG_GPS_PARSER_TRACE_DEPTH];
+    uint32_t count; /*!< Entries recorded since init, the ring holds the last ones */
+} gps_trace_t;
+
+/* Appends one entry built from data, overwriting the oldest one. */
+void gps_trace_record(gps_trace_t *trace, gps_sentence_t type, gps_status_t status, const gps_t *data);
+
+/* Copies up to max entries, oldest first, and returns how many were copied. */
+size_t gps_trace_read(const gps_trace_t *trace, gps_trace_entry_t *out, size_t max);
+
+/* Prints the ring, oldest entry first. */
+void gps_trace_dump(const gps_trace_t *trace);
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "gps_parser.h"
+
+/* u-blox binary protocol. A frame is 0xB5 0x62, class, id, a little endian
+ * payload length, the payload and two Fletcher checksum bytes over class to
+ * payload. NAV-PVT carries the whole navigation solution of an epoch in 92
+ * bytes at fixed offsets, so it is decoded into the same gps_t as the NMEA
+ * sentences without converting any text. */
+
+#define GPS_UBX_SYNC1           (0xB5)
+#define GPS_UBX_SYNC2           (0x62)
+#define GPS_UBX_HEADER_LENGTH   (6)  /*!< Sync characters, class, id and length */
+#define GPS_UBX_CLASS_NAV       (0x01)
+#define GPS_UBX_ID_NAV_PVT      (0x07)
+#define GPS_UBX_NAV_PVT_LENGTH  (92) /*!< Payload of NAV-PVT, the largest message decoded */
+#define GPS_UBX_MAX_LENGTH      (1024) /*!< Longer payloads are taken as a false sync */
+#define GPS_UBX_PVT_VALID_DATE  (0x01) /*!< NAV-PVT valid flags: the date is resolved */
+#define GPS_UBX_PVT_VALID_TIME  (0x02) /*!< NAV-PVT valid flags: the time of day is resolved */
+
+/* Parses the UBX frame in frame[0..len), sync characters up to the checksum,
+ * into parser->data. NAV-PVT is decoded as GPS_SENTENCE_UBX_PVT, other valid
+ * messages return GPS_SENTENCE_MISMATCH. The date and the time of a NAV-PVT
+ * are only taken when its valid flags say they are resolved and they are in
+ * range, like the NMEA ones. */
+gps_status_t gps_parser_parse_ubx(gps_parser_t *parser, const uint8_t *frame, uint16_t len);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "gps_parser.h"
+
+static inline uint8_t field_len(const gps_fields_t *fields, uint8_t idx) {
+    return fields->start[idx + 1] - fields->start[idx] - 1;
+}
+
+#define GPS_PACK2(a, b)    (((uint32_t)(uint8_t)(a) << 8) | (uint8_t)(b))
+#define GPS_PACK3(a, b, c) (((uint32_t)(uint8_t)(a) << 16) | GPS_PACK2(b, c))
+
+/* Maps the two talker characters of an address to a gps_talker_t. */
+static inline gps_talker_t gps_decode_talker(const char *talker) {
+    switch (GPS_PACK2(talker[0], talker[1])) {
+        case GPS_PACK2('G', 'P'): return GPS_TALKER_GP;
+        case GPS_PACK2('G', 'L'): return GPS_TALKER_GL;
+        case GPS_PACK2('G', 'A'): return GPS_TALKER_GA;
+        case GPS_PACK2('G', 'B'): return GPS_TALKER_GB;
+        case GPS_PACK2('B', 'D'): return GPS_TALKER_BD;
+        case GPS_PACK2('G', 'Q'): return GPS_TALKER_GQ;
+        case GPS_PACK2('G', 'I'): return GPS_TALKER_GI;
+        case GPS_PACK2('G', 'N'): return GPS_TALKER_GN;
+        default: return GPS_TALKER_UNKNOWN;
+    }
+}
+
+/* Maps the three formatter characters of an address to a gps_sentence_t. */
+static inline gps_sentence_t gps_decode_formatter(const char *formatter) {
+    switch (GPS_PACK3(formatter[0], formatter[1], formatter[2])) {
+        case GPS_PACK3('G', 'G', 'A'): return GPS_SENTENCE_GGA;
+        case GPS_PACK3('G', 'S', 'A'): return GPS_SENTENCE_GSA;
+        case GPS_PACK3('G', 'S', 'V'): return GPS_SENTENCE_GSV;
+        case GPS_PACK3('R', 'M', 'C'): return GPS_SENTENCE_RMC;
+        case GPS_PACK3('G', 'L', 'L'): return GPS_SENTENCE_GLL;
+        case GPS_PACK3('V', 'T', 'G'): return GPS_SENTENCE_VTG;
+        default: return GPS_SENTENCE_UNKNOWN;
+    }
+}
+
+/* False if the address at the start of a sentence names a known sentence type
+ * the parser is not interested in. Unknown types are left to the decoder. */
+static inline bool gps_parser_wants(const gps_parser_t *parser, const char *sentence, uint16_t len) {
+    if (len < 7 || sentence[6] != ',') {
+        return true;
+    }
+    gps_sentence_t type = gps_decode_formatter(sentence + 3);
+    return type == GPS_SENTENCE_UNKNOWN || (parser->sentence_mask & GPS_SENTENCE_BIT(type));
+}
+
+/* Decodes a "ddmm.mmmmm" or "dddmm.mmmmm" field into unsigned 1e-7 degrees. */
+bool gps_decode_coordinate(const char *coord, uint8_t item_length, int32_t *value);
+
+/* Stores the UTC time of the day in ms into tim, time_ms and utc_ms. A time
+ * earlier than the one before by more than 12 h passed midnight, the day of
+ * utc_ms moves on before the next date arrives. */
+void gps_set_time(gps_t *data, uint32_t time_ms);
+
+/* Stores date, sets utc_day to its day number, which is only recomputed when
+ * the date changed, and updates utc_ms. */
+void gps_set_date(gps_t *data, uint8_t day, uint8_t month, uint16_t year);
+
+/* Starts timing the sentence whose first byte is about to be looked at. */
+static inline void gps_parser_begin(gps_parser_t *parser) {
+#if CONFIG_GPS_PARSER_STATS
+    parser->stats.start = gps_cycles();
+#endif
+}
+
+/* Stores the outcome of one sentence in parser->data.status, the trace ring
+ * and the counters, and returns status. */
+gps_status_t gps_parser_finish(gps_parser_t *parser, gps_sentence_t type, gps_status_t status);
+
+/* Decodes a sentence whose framing and checksum have already been verified and
+ * whose field offsets are in fields into parser. */
+gps_status_t gps_decode(gps_parser_t *parser, const char *sentence, const gps_fields_t *fields);
+
+/* Fletcher checksum of UBX over class, id, length and payload. */
+static inline void gps_ubx_checksum(const uint8_t *data, uint16_t len, uint8_t *ck_a, uint8_t *ck_b) {
+    uint8_t a = 0, b = 0;
+    for (uint16_t i = 0; i < len; i++) {
+        a += data[i];
+        b += a;
+    }
+    *ck_a = a;
+    *ck_b = b;
+}
+
+/* Decodes a UBX message whose checksum has already been verified, msg points
+ * to its class byte and holds len bytes of payload after the 4 header bytes. */
+gps_status_t gps_decode_ubx(gps_parser_t *parser, const uint8_t *msg, uint16_t len);
@@ -1,12 +1,16 @@
 #include "gps_uart.h"
 #include "gps_parser.h"
+#include "gps_stream.h"
+#include "gps_epoch.h"
+#include "gps_snapshot.h"
+#include "gps_bus.h"
 
 static const char *TAG = "uart_events";
 
 /**
  * - Port: UART2
  * - Receive (Rx) buffer: on
- * - Transmit (Tx) buffer: off
+ * - Transmit (Tx) buffer: on, for receiver commands
  * - Flow control: off
  * - Event queue: on
  * - Pin assignment: TxD 17, RxD 16
@@ -15,45 +19,163 @@ static const char *TAG = "uart_events";
 #define EX_UART_NUM UART_NUM_2
 #define UART_TX_PIN 17
 #define UART_RX_PIN 16
-#define PATTERN_CHR_NUM    (1)         /*!< Set the number of consecutive and identical characters received by receiver which defines a UART pattern*/
 #define BUF_SIZE (1024)
 #define RD_BUF_SIZE (BUF_SIZE)
+// Sentence types the parser decodes, the receiver is told to send only these
+#define GPS_UART_SENTENCES                                                                                             \
+    (GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_GSA) | GPS_SENTENCE_BIT(GPS_SENTENCE_GSV) |   \
+     GPS_SENTENCE_BIT(GPS_SENTENCE_RMC) | GPS_SENTENCE_BIT(GPS_SENTENCE_VTG))
+// A 1 Hz receiver sends all sentences of an epoch within a few hundred ms
+#define EPOCH_TIMEOUT_MS (500)
 
 static QueueHandle_t uart0_queue;
+// The task and its buffer are static, their RAM shows up in the link map instead of the heap
+static StaticTask_t gps_task;
+static StackType_t gps_task_stack[CONFIG_GPS_UART_TASK_STACK_SIZE];
+static uint8_t gps_rx_buf[RD_BUF_SIZE];
+static gps_parser_t gps_parser;
+static gps_stream_t gps_stream;
+static gps_epoch_t gps_epoch;
+static gps_snapshot_t gps_snapshot;
+static gps_bus_t gps_bus;
+// Serializes subscribing, dispatching in the UART task needs no lock
+static portMUX_TYPE gps_bus_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t gps_uart_baud = CONFIG_GPS_UART_BAUD_RATE;
+// Updated by the UART task only, copied out for other tasks after every wakeup
+static gps_uart_stats_t gps_stats;
+static uint32_t gps_wakeup_cycles;
+static atomic_uint gps_stats_seq;
+static gps_uart_stats_t gps_stats_shared;
+
+static inline uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void on_fix(const gps_epoch_fix_t *fix, void *arg)
+{
+    gps_date_t date;
+    gps_time_t tim;
+    gps_snapshot_publish(&gps_snapshot, fix);
+    gps_stats.fixes++;
+    // The mark only ever goes down, scanning the stack once per fix is enough
+    gps_stats.stack_free_min = uxTaskGetStackHighWaterMark(NULL);
+    gps_histogram_add(&gps_stats.publish_cycles, gps_cycles() - gps_wakeup_cycles);
+    ESP_LOGI(TAG, "Sentences: 0x%02lx", (unsigned long)fix->sentences);
+    // Stored as UTC, shown in local time
+    gps_local_time(fix->data.utc_ms, &date, &tim);
+    ESP_LOGI(TAG, "Time: %d:%d:%f", tim.hour, tim.minute, tim.second);
+}
+
+static void on_sentence(const gps_t *myGPSData, void *arg)
+{
+    gps_bus_dispatch_stream(&gps_bus, &gps_stream);
+    gps_epoch_add(&gps_epoch, myGPSData, now_ms());
+}
+
+esp_err_t gps_uart_subscribe(uint8_t topic, gps_bus_cb_t cb, void *arg)
+{
+    taskENTER_CRITICAL(&gps_bus_lock);
+    gps_status_t status = gps_bus_subscribe(&gps_bus, topic, cb, arg, NULL);
+    taskEXIT_CRITICAL(&gps_bus_lock);
+    return status == GPS_OKAY ? ESP_OK : status == GPS_MEM_LOW ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_ARG;
+}
+
+uint32_t gps_uart_get_fix(gps_epoch_fix_t *fix)
+{
+    return gps_snapshot_read(&gps_snapshot, fix);
+}
+
+uint32_t gps_uart_get_stats(gps_uart_stats_t *stats)
+{
+    return gps_seqlock_read(&gps_stats_seq, &gps_stats_shared, stats, sizeof(gps_uart_stats_t));
+}
+
+// Once per wakeup, a burst of sentences costs one copy
+static void publish_stats(void)
+{
+#if CONFIG_GPS_PARSER_STATS
+    gps_stats.parser = gps_parser.stats;
+#endif
+    gps_stats.sentences = gps_stream.sentences;
+    gps_stats.crc_errors = gps_stream.crc_errors;
+    gps_stats.framing_errors = gps_stream.framing_errors;
+    gps_stats.ignored = gps_stream.ignored;
+    gps_stats.dropped_bytes = gps_stream.dropped_bytes;
+    gps_stats.gaps = gps_stream.gaps;
+    gps_seqlock_write(&gps_stats_seq, &gps_stats_shared, &gps_stats, sizeof(gps_uart_stats_t));
+}
+
+/* Feeds everything buffered to the framer, the UART_DATA events queued
+ * meanwhile find nothing left to read. Whole sentences are parsed in place
+ * from dtmp, only one split by a block end is copied. */
+static void drain_rx(uint8_t *dtmp)
+{
+    int len;
+    while ((len = uart_read_bytes(EX_UART_NUM, dtmp, RD_BUF_SIZE, 0)) > 0) {
+        gps_stream_feed(&gps_stream, dtmp, len);
+    }
+}
+
+/* Bytes were lost after what the ring buffer holds now. Feeds exactly those,
+ * marks the gap and only then reads what the driver received meanwhile, which
+ * comes after the gap. */
+static void drain_rx_gap(uint8_t *dtmp)
+{
+    size_t buffered = 0;
+    int len;
+    uart_get_buffered_data_len(EX_UART_NUM, &buffered);
+    while (buffered > 0 &&
+           (len = uart_read_bytes(EX_UART_NUM, dtmp, buffered < RD_BUF_SIZE ? buffered : RD_BUF_SIZE, 0)) > 0) {
+        gps_stream_feed(&gps_stream, dtmp, len);
+        buffered -= len;
+    }
+    gps_stream_mark_gap(&gps_stream);
+    drain_rx(dtmp);
+}
 
 static void uart_event_task(void *pvParameters)
 {
     uart_event_t event;
-    size_t buffered_size;
-    char* dtmp = (char*) pvPortMalloc(RD_BUF_SIZE);
+    uint8_t *dtmp = gps_rx_buf;
+
+    gps_parser_init(&gps_parser);
+    gps_stream_init(&gps_stream, &gps_parser, on_sentence, NULL);
+    gps_epoch_init(&gps_epoch, EPOCH_TIMEOUT_MS, on_fix, NULL);
 
     for (;;) {
-        //Waiting for UART event.
-        if (xQueueReceive(uart0_queue, (void *)&event, (TickType_t)portMAX_DELAY)) {
-            bzero(dtmp, RD_BUF_SIZE);
+        //Waiting for UART event, wakes up anyway to publish the last epoch once the receiver goes quiet.
+        BaseType_t received = xQueueReceive(uart0_queue, (void *)&event, pdMS_TO_TICKS(EPOCH_TIMEOUT_MS));
+        gps_wakeup_cycles = gps_cycles();
+        gps_epoch_poll(&gps_epoch, now_ms());
+        if (received) {
+            if (event.type < UART_EVENT_MAX) {
+                gps_stats.uart_events[event.type]++;
+            }
             switch (event.type) {
             //Event of UART receving data
             /*We'd better handler data event fast, there would be much more data events than
             other types of events. If we take too much time on data event, the queue might
             be full.*/
             case UART_DATA:
+                drain_rx(dtmp);
                 break;
             //Event of HW FIFO overflow detected
             case UART_FIFO_OVF:
-                ESP_LOGI(TAG, "hw fifo overflow");
                 // If fifo overflow happened, you should consider adding flow control for your application.
-                // The ISR has already reset the rx FIFO,
-                // As an example, we directly flush the rx buffer here in order to read more data.
-                uart_flush_input(EX_UART_NUM);
-                xQueueReset(uart0_queue);
+                // The ISR has already reset the rx FIFO, the bytes lost are the ones after what the
+                // ring buffer holds. Decode everything buffered and drop only the sentence cut by the gap.
+                drain_rx_gap(dtmp);
+                ESP_LOGI(TAG, "hw fifo overflow, %lu gaps, %lu bytes dropped", (unsigned long)gps_stream.gaps,
+                         (unsigned long)gps_stream.dropped_bytes);
                 break;
             //Event of UART ring buffer full
             case UART_BUFFER_FULL:
+                // If buffer full happened, you should consider increasing your buffer size.
+                // The driver keeps the FIFO bytes that did not fit and pushes them in on the next
+                // read, nothing is lost, so there is no gap to mark.
+                drain_rx(dtmp);
                 ESP_LOGI(TAG, "ring buffer full");
-                // If buffer full happened, you should consider increasing your buffer size
-                // As an example, we directly flush the rx buffer here in order to read more data.
-                uart_flush_input(EX_UART_NUM);
-                xQueueReset(uart0_queue);
                 break;
             //Event of UART RX break detected
             case UART_BREAK:
@@ -67,43 +189,101 @@ static void uart_event_task(void *pvParameters)
             case UART_FRAME_ERR:
                 ESP_LOGI(TAG, "uart frame error");
                 break;
-            //UART_PATTERN_DET
-            case UART_PATTERN_DET:
-                uart_get_buffered_data_len(EX_UART_NUM, &buffered_size);
-                int pos = uart_pattern_pop_pos(EX_UART_NUM);
-                // ESP_LOGI(TAG, "[UART PATTERN DETECTED] pos: %d, buffered size: %d", pos, buffered_size);
-                if (pos == -1) {
-                    // There used to be a UART_PATTERN_DET event, but the pattern position queue is full so that it can not
-                    // record the position. We should set a larger queue size.
-                    // As an example, we directly flush the rx buffer here.
-                    uart_flush_input(EX_UART_NUM);
-                } else {
-                    uart_read_bytes(EX_UART_NUM, dtmp, pos + 1, 100 / portTICK_PERIOD_MS);
-                    gps_t myGPSData = gps_parse(dtmp);//returns GPS_OKAY to status member if all goes well.
-                    ESP_LOGI(TAG, "Status: %d",myGPSData.status);
-                    ESP_LOGI(TAG, "Time: %d:%d:%f", myGPSData.tim.hour, myGPSData.tim.minute, myGPSData.tim.second);
-                }
-                break;
             //Others
             default:
                 ESP_LOGI(TAG, "uart event type: %d", event.type);
                 break;
             }
         }
+        publish_stats();
+    }
+}
+
+static gps_status_t port_write(void *ctx, const uint8_t *data, size_t len)
+{
+    if (uart_write_bytes(EX_UART_NUM, data, len) != (int)len) {
+        return GPS_MEM_LOW;
     }
-    vPortFree(dtmp);
-    dtmp = NULL;
-    vTaskDelete(NULL);
+    // The receiver must have the whole command before the UART changes speed
+    uart_wait_tx_done(EX_UART_NUM, pdMS_TO_TICKS(1000));
+    return GPS_OKAY;
 }
 
+static void port_set_baud(void *ctx, uint32_t baud)
+{
+    uart_set_baudrate(EX_UART_NUM, baud);
+}
+
+static bool port_wait_sentence(void *ctx, uint32_t timeout_ms)
+{
+    // Let the UART task parse what was received before, at the previous rate
+    vTaskDelay(pdMS_TO_TICKS(50));
+    uint32_t start = gps_stream.sentences;
+    for (uint32_t waited = 0; waited < timeout_ms; waited += 50) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        if (gps_stream.sentences != start) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t gps_uart_send(const gps_cmd_t *cmd)
+{
+    return port_write(NULL, cmd->data, cmd->len) == GPS_OKAY ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t gps_uart_set_baud(gps_cmd_protocol_t protocol, uint32_t baud)
+{
+    // A 1 Hz receiver is heard within a second, with margin for the switch itself
+    gps_cmd_port_t port = {
+        .write = port_write,
+        .set_baud = port_set_baud,
+        .wait_sentence = port_wait_sentence,
+        .timeout_ms = 2000,
+    };
+    gps_status_t status = gps_cmd_switch_baud(&port, protocol, gps_uart_baud, baud);
+    if (status == GPS_OKAY) {
+        ESP_LOGI(TAG, "baud rate %lu", (unsigned long)baud);
+        gps_uart_baud = baud;
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "receiver not heard at %lu baud, staying at %lu", (unsigned long)baud, (unsigned long)gps_uart_baud);
+    return status == GPS_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_ERR_INVALID_ARG;
+}
+
+#if !CONFIG_GPS_UART_RECEIVER_NONE
+static void configure_receiver(void)
+{
+#if CONFIG_GPS_UART_RECEIVER_UBX
+    gps_cmd_protocol_t protocol = GPS_CMD_PROTOCOL_UBX;
+#else
+    gps_cmd_protocol_t protocol = GPS_CMD_PROTOCOL_MTK;
+#endif
+    gps_cmd_t cmd;
+
+    // The baud rate first, a higher fix rate may not fit into the old one
+    gps_uart_set_baud(protocol, CONFIG_GPS_UART_TARGET_BAUD);
+    if (gps_cmd_rate(protocol, CONFIG_GPS_UART_FIX_PERIOD_MS, &cmd) == GPS_OKAY) {
+        gps_uart_send(&cmd);
+    }
+    if (gps_cmd_sentences(protocol, GPS_UART_SENTENCES, &cmd) == GPS_OKAY) {
+        gps_uart_send(&cmd);
+    }
+}
+#endif
+
 esp_err_t uart_init()
 {
+    gps_snapshot_init(&gps_snapshot);
+    gps_bus_init(&gps_bus);
+    atomic_init(&gps_stats_seq, 0);
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
     /* Configure parameters of an UART driver,
      * communication pins and install the driver */
     uart_config_t uart_config = {
-        .baud_rate = 9600,
+        .baud_rate = CONFIG_GPS_UART_BAUD_RATE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -111,20 +291,22 @@ esp_err_t uart_init()
         .source_clk = UART_SCLK_DEFAULT,
     };
     //Install UART driver, and get the queue.
-    uart_driver_install(EX_UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 20, &uart0_queue, 0);
+    uart_driver_install(EX_UART_NUM, CONFIG_GPS_UART_RX_BUFFER_SIZE, BUF_SIZE * 2, 20, &uart0_queue, 0);
     uart_param_config(EX_UART_NUM, &uart_config);
+    //Wake the task on a nearly full FIFO or once the line goes idle after a burst
+    uart_set_rx_full_threshold(EX_UART_NUM, 120);
+    uart_set_rx_timeout(EX_UART_NUM, CONFIG_GPS_UART_RX_TIMEOUT);
 
     //Set UART log level
     esp_log_level_set(TAG, ESP_LOG_INFO);
     //Set UART pins (using UART2 default pins ie no changes.)
     uart_set_pin(EX_UART_NUM, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 
-    //Set uart pattern detect function.
-    uart_enable_pattern_det_baud_intr(EX_UART_NUM, '\n', PATTERN_CHR_NUM, 9, 0, 0);
-    //Reset the pattern queue length to record at most 20 pattern positions.
-    uart_pattern_queue_reset(EX_UART_NUM, 20);
-
     //Create a task to handler UART event from ISR
-    xTaskCreate(uart_event_task, "uart_event_task", 3072, NULL, 12, NULL);
+    xTaskCreateStatic(uart_event_task, "uart_event_task", CONFIG_GPS_UART_TASK_STACK_SIZE, NULL, 12, gps_task_stack,
+                      &gps_task);
+#if !CONFIG_GPS_UART_RECEIVER_NONE
+    configure_receiver();
+#endif
     return ESP_OK;
 }
\ No newline at end of file
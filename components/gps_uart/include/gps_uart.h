@@ -7,5 +7,54 @@
 #include "freertos/queue.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "gps_epoch.h"
+#include "gps_snapshot.h"
+#include "gps_bus.h"
+#include "gps_cmd.h"
 
 esp_err_t uart_init();
+
+/* Counters of the UART task since uart_init(). */
+typedef struct {
+    gps_parser_stats_t parser;              /*!< Sentences and outcomes, zero without CONFIG_GPS_PARSER_STATS */
+    uint32_t sentences;                     /*!< Frames handed to the decoder */
+    uint32_t crc_errors;                    /*!< Frames dropped on checksum mismatch */
+    uint32_t framing_errors;                /*!< Frames dropped as truncated, too long or malformed */
+    uint32_t ignored;                       /*!< Sentences skipped by the interest mask while framing */
+    uint32_t dropped_bytes;                 /*!< Bytes of dropped frames */
+    uint32_t gaps;                          /*!< FIFO overflows, each one a gap in the received bytes */
+    uint32_t fixes;                         /*!< Fixes published */
+    uint32_t stack_free_min;                /*!< Bytes of the UART task's stack never used so far, as of the last
+                                                 fix. What stays free on the deepest path can be taken off
+                                                 CONFIG_GPS_UART_TASK_STACK_SIZE, keeping some margin */
+    uint32_t uart_events[UART_EVENT_MAX];   /*!< UART driver events, per uart_event_type_t */
+    gps_histogram_t publish_cycles;         /*!< CPU cycles from the UART task waking up for the bytes that
+                                                 completed an epoch to the fix being published */
+} gps_uart_stats_t;
+
+/* Copies the counters as of the UART task's last wakeup into stats without
+ * blocking, from any task. Returns 0 when the UART task was just updating
+ * them, the caller keeps its previous copy then, like gps_uart_get_fix(). */
+uint32_t gps_uart_get_stats(gps_uart_stats_t *stats);
+
+/* Copies the latest fix into fix without blocking, from any task on either
+ * core. Returns its sequence number, which changes with every new fix, or 0
+ * when there is no fix yet or the UART task was just publishing one; the
+ * caller keeps its previous copy then. */
+uint32_t gps_uart_get_fix(gps_epoch_fix_t *fix);
+
+/* Calls cb in the UART task for every sentence of a type or for every event,
+ * topic is a gps_sentence_t or gps_event_t, see gps_bus.h. May be called
+ * from any task after uart_init(). cb runs while the UART task parses and
+ * should only look at the sentence or hand it on, e.g. to a queue.
+ * ESP_ERR_NO_MEM when CONFIG_GPS_PARSER_BUS_SUBSCRIBERS are taken. */
+esp_err_t gps_uart_subscribe(uint8_t topic, gps_bus_cb_t cb, void *arg);
+
+/* Writes a command built with gps_cmd.h to the receiver. */
+esp_err_t gps_uart_send(const gps_cmd_t *cmd);
+
+/* Switches the receiver and the UART to baud with gps_cmd_switch_baud(),
+ * ESP_ERR_TIMEOUT when the receiver was not heard at the new rate and the
+ * UART stayed at the old one. Must not be called from the UART task, which
+ * has to keep parsing to notice the receiver at the new rate. */
+esp_err_t gps_uart_set_baud(gps_cmd_protocol_t protocol, uint32_t baud);
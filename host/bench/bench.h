@@ -0,0 +1,104 @@
+#pragma once
+
+/* Shared helpers of the host benchmark sections. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gps_parser.h"
+#include "gps_stream.h"
+#include "gps_epoch.h"
+
+typedef struct {
+    const char *ptr;
+    uint16_t len;
+} line_t;
+
+typedef struct {
+    const char *name;
+    char *data;
+    size_t size;
+    line_t *lines;
+    size_t count;
+} corpus_t;
+
+/* Epochs in the order they were published. */
+typedef struct {
+    gps_epoch_fix_t *fixes;
+    size_t count;
+    size_t capacity;
+    uint32_t fields; /*!< gps_field_flag_t of which an epoch needs one to be kept, 0 keeps every epoch */
+} fix_list_t;
+
+typedef struct {
+    int repeats;
+    size_t min_items;
+    bool csv;
+    const char *baseline;
+    double tolerance;
+} bench_opts_t;
+
+extern bench_opts_t opts;
+
+/* Heap allocations made by the process so far. */
+extern size_t alloc_count;
+
+double now_ns(void);
+
+/* Runs fn, which processes items items per call, often enough to cover
+ * opts.min_items and returns the lowest cost per item of opts.repeats runs. */
+double measure(void (*fn)(void *ctx), void *ctx, size_t items);
+
+/* Heap allocations per item of one untimed call of fn. */
+double count_allocs(void (*fn)(void *ctx), void *ctx, size_t items);
+
+/* Prints one result row and remembers it for --check. */
+void report(const char *corpus, const char *row, size_t items, double ns, double allocs);
+
+/* Like report, for rows whose code must not allocate: fails when allocs is above 0. */
+void report_no_alloc(const char *corpus, const char *row, size_t items, double ns, double allocs);
+
+/* Prints a free form remark, as a comment line in --csv mode. */
+void note(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/* Reports a failed correctness check, gps_bench then exits with status 1. */
+void fail(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/* Parses the sentence whose text between '$' and '*' is body, with its
+ * checksum. */
+gps_status_t parse_body(gps_parser_t *parser, const char *body);
+
+/* Feeds size bytes of data to stream in blocks of block bytes, the last one
+ * shorter. */
+void feed_blocks(gps_stream_t *stream, const void *data, size_t size, size_t block);
+
+/* gps_stream_cb_t that adds every sentence to the gps_epoch_t arg. */
+void add_to_epoch(const gps_t *data, void *arg);
+
+/* gps_epoch_cb_t that appends the epoch to the fix_list_t arg. */
+void keep_fix(const gps_epoch_fix_t *fix, void *arg);
+
+/* Frames corpus in one block, assembles its epochs and appends them to list,
+ * whose fixes the caller frees. Returns the stream, its counters are valid
+ * until the next call. */
+const gps_stream_t *collect_fixes(const corpus_t *corpus, fix_list_t *list);
+
+/* Next 24 bit pseudo-random number of the sequence state is at, the same
+ * sequence for the same initial state on every host. */
+uint32_t bench_rng(uint32_t *state);
+
+void bench_parse(const corpus_t *corpora, size_t count);
+void bench_coord(const corpus_t *corpora, size_t count);
+void bench_cmd(const corpus_t *corpora, size_t count);
+void bench_chunked(const corpus_t *corpora, size_t count);
+void bench_overflow(const corpus_t *corpora, size_t count);
+void bench_snapshot(const corpus_t *corpora, size_t count);
+void bench_ubx(const corpus_t *corpora, size_t count);
+void bench_scan(const corpus_t *corpora, size_t count);
+void bench_fixlog(const corpus_t *corpora, size_t count);
+void bench_stats(const corpus_t *corpora, size_t count);
+void bench_time(const corpus_t *corpora, size_t count);
+void bench_dr(const corpus_t *corpora, size_t count);
+void bench_fence(const corpus_t *corpora, size_t count);
+void bench_gen(const corpus_t *corpora, size_t count);
+void bench_bus(const corpus_t *corpora, size_t count);
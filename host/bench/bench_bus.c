@@ -0,0 +1,302 @@
+/* Sentence and event subscribers. Every corpus is fed through the framer in
+ * blocks of 7 bytes with a subscriber on every sentence type and event, each
+ * sentence must reach the subscribers of its type once with its own checksummed
+ * text, and the events must match a line by line reference. A full registry,
+ * an unknown topic, subscribers removing themselves and events from sentences
+ * that left their fix or position empty are checked. The cost
+ * of dispatching a sentence is reported without subscribers, with one, with
+ * 15 more on topics that never occur and with 16 on the same type. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_bus.h"
+#include "gps_parser_priv.h"
+
+#define BLOCK (7)
+
+typedef struct {
+    uint32_t calls[GPS_TOPIC_MAX];
+    uint32_t bad_views;
+} count_ctx_t;
+
+typedef struct {
+    gps_t data;
+    char sentence[MAX_SENTENCE_LENGTH + 1];
+    uint16_t len;
+} dispatch_item_t;
+
+typedef struct {
+    gps_bus_t bus;
+    dispatch_item_t *items;
+    size_t count;
+    uint32_t calls;
+} dispatch_ctx_t;
+
+// The view must be one whole sentence of the decoded type with a matching checksum
+static bool check_view(const gps_bus_msg_t *msg)
+{
+    if (msg->fields == NULL) {
+        return msg->data->sentence == GPS_SENTENCE_UBX_PVT && msg->len == 4 + GPS_UBX_NAV_PVT_LENGTH;
+    }
+    const char *s = msg->sentence;
+    if (msg->len < 9 || s[0] != '$' || s[msg->len - 3] != '*' ||
+        msg->fields->start[msg->fields->count] != msg->len - 2) {
+        return false;
+    }
+    uint8_t checksum = 0;
+    for (uint16_t i = 1; i < msg->len - 3; i++) {
+        checksum ^= (uint8_t)s[i];
+    }
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02X", checksum);
+    return memcmp(hex, s + msg->len - 2, 2) == 0 && gps_decode_formatter(s + 3) == msg->data->sentence;
+}
+
+static void count_call(const gps_bus_msg_t *msg, void *arg)
+{
+    count_ctx_t *ctx = arg;
+    ctx->calls[msg->topic]++;
+    if (msg->topic < GPS_SENTENCE_MAX && !check_view(msg)) {
+        ctx->bad_views++;
+    }
+}
+
+typedef struct {
+    gps_stream_t stream;
+    gps_bus_t bus;
+} feed_ctx_t;
+
+static void on_frame(const gps_t *data, void *arg)
+{
+    feed_ctx_t *ctx = arg;
+    gps_bus_dispatch_stream(&ctx->bus, &ctx->stream);
+}
+
+// Events of one sentence as gps_bus.h defines them, line by line
+static void reference_events(const gps_t *data, bool *fixed, bool *time_valid, uint32_t *calls)
+{
+    int status = !(data->fields & GPS_FIELD_FIX)          ? -1
+                 : data->sentence == GPS_SENTENCE_GGA ? data->fix != GPS_FIX_INVALID
+                 : data->sentence == GPS_SENTENCE_RMC ? data->valid
+                                                      : -1;
+    calls[data->sentence]++;
+    if (status < 0) {
+        return;
+    }
+    if (status != *fixed) {
+        *fixed = status;
+        calls[status ? GPS_EVENT_FIX_ACQUIRED : GPS_EVENT_FIX_LOST]++;
+    }
+    if (status) {
+        if (data->fields & GPS_FIELD_POSITION) {
+            calls[GPS_EVENT_POSITION]++;
+        }
+        if (!*time_valid && data->sentence == GPS_SENTENCE_RMC && (data->fields & GPS_FIELD_TIME) &&
+            (data->fields & GPS_FIELD_DATE)) {
+            *time_valid = true;
+            calls[GPS_EVENT_TIME_VALID]++;
+        }
+    }
+}
+
+static void check_corpus(const corpus_t *corpus)
+{
+    static feed_ctx_t feed;
+    static gps_parser_t parser, reference;
+    static count_ctx_t counts;
+    uint32_t expected[GPS_TOPIC_MAX] = {0};
+    bool fixed = false, time_valid = false;
+
+    gps_parser_init(&reference);
+    for (size_t i = 0; i < corpus->count; i++) {
+        if (gps_parser_parse(&reference, corpus->lines[i].ptr, corpus->lines[i].len) == GPS_OKAY) {
+            reference_events(&reference.data, &fixed, &time_valid, expected);
+        }
+    }
+    memset(&counts, 0, sizeof(counts));
+    gps_parser_init(&parser);
+    gps_stream_init(&feed.stream, &parser, on_frame, &feed);
+    gps_bus_init(&feed.bus);
+    for (uint8_t topic = GPS_SENTENCE_GGA; topic < GPS_TOPIC_MAX; topic++) {
+        if (gps_bus_subscribe(&feed.bus, topic, count_call, &counts, NULL) != GPS_OKAY) {
+            fail("bus: topic %u not accepted", topic);
+            return;
+        }
+    }
+    feed_blocks(&feed.stream, corpus->data, corpus->size, BLOCK);
+    if (counts.bad_views) {
+        fail("%s: %u sentences handed on with a view that is not their text", corpus->name, counts.bad_views);
+    }
+    for (uint8_t topic = GPS_SENTENCE_GGA; topic < GPS_TOPIC_MAX; topic++) {
+        if (counts.calls[topic] != expected[topic]) {
+            fail("%s: topic %u called %u times, expected %u", corpus->name, topic, counts.calls[topic],
+                 expected[topic]);
+        }
+    }
+    note("%s: %u positions, %u fixes acquired, %u lost, time valid %u, %u subscriber calls", corpus->name,
+         counts.calls[GPS_EVENT_POSITION], counts.calls[GPS_EVENT_FIX_ACQUIRED], counts.calls[GPS_EVENT_FIX_LOST],
+         counts.calls[GPS_EVENT_TIME_VALID], feed.bus.dispatched);
+}
+
+/* Events follow only what a sentence sent. After a fix, sentences without a
+ * fix status (GSV) or with empty fix fields send no event, and a valid fix
+ * without a position sends no position, though the parser still holds the
+ * older ones. */
+static void check_fields(void)
+{
+    static const char *const sentences[] = {
+        "GPGGA,120000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPGSV,1,1,02,04,45,090,40,05,12,270,35",
+        "GPGSV,1,1,02,04,45,090,41,05,12,270,36",
+        "GPGGA,120001.00,,,,,,,,,,,,,",
+        "GPRMC,120001.00,A,,,,,,,170424,,,A",
+        "GPGSV,1,1,02,04,45,090,42,05,12,270,37",
+    };
+    static gps_bus_t bus;
+    static gps_parser_t parser;
+    static count_ctx_t counts;
+
+    memset(&counts, 0, sizeof(counts));
+    gps_bus_init(&bus);
+    for (uint8_t topic = GPS_SENTENCE_MAX; topic < GPS_TOPIC_MAX; topic++) {
+        gps_bus_subscribe(&bus, topic, count_call, &counts, NULL);
+    }
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+        gps_bus_dispatch(&bus, &parser.data, NULL, 0, NULL);
+    }
+    const uint32_t *calls = counts.calls;
+    if (calls[GPS_EVENT_POSITION] != 1 || calls[GPS_EVENT_FIX_ACQUIRED] != 1 || calls[GPS_EVENT_FIX_LOST] ||
+        calls[GPS_EVENT_TIME_VALID] != 1) {
+        fail("bus: %u positions, %u fixes acquired, %u lost, time valid %u from sentences that did not send them",
+             calls[GPS_EVENT_POSITION], calls[GPS_EVENT_FIX_ACQUIRED], calls[GPS_EVENT_FIX_LOST],
+             calls[GPS_EVENT_TIME_VALID]);
+    }
+
+    // A GSV only stream, e.g. before the first fix, sends nothing at all
+    memset(&counts, 0, sizeof(counts));
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < 20; i++) {
+        parse_body(&parser, sentences[1 + i % 2]);
+        gps_bus_dispatch(&bus, &parser.data, NULL, 0, NULL);
+    }
+    for (uint8_t topic = GPS_SENTENCE_MAX; topic < GPS_TOPIC_MAX; topic++) {
+        if (calls[topic]) {
+            fail("bus: event %u sent %u times by GSV sentences", topic, calls[topic]);
+        }
+    }
+}
+
+typedef struct {
+    gps_bus_t *bus;
+    uint8_t handle;
+    uint32_t calls;
+} leave_ctx_t;
+
+static void leave_after_call(const gps_bus_msg_t *msg, void *arg)
+{
+    leave_ctx_t *ctx = arg;
+    ctx->calls++;
+    gps_bus_unsubscribe(ctx->bus, ctx->handle);
+}
+
+static void check_registry(const corpus_t *corpus)
+{
+    static gps_bus_t bus;
+    static gps_parser_t parser;
+    static count_ctx_t counts;
+    leave_ctx_t first = {.bus = &bus}, second = {.bus = &bus};
+    uint8_t handle;
+
+    gps_bus_init(&bus);
+    if (gps_bus_subscribe(&bus, GPS_SENTENCE_UNKNOWN, count_call, &counts, NULL) != GPS_INV_ARG ||
+        gps_bus_subscribe(&bus, GPS_TOPIC_MAX, count_call, &counts, NULL) != GPS_INV_ARG) {
+        fail("bus: unknown topic accepted");
+    }
+    for (int i = 0; i < GPS_BUS_MAX_SUBSCRIBERS; i++) {
+        if (gps_bus_subscribe(&bus, GPS_SENTENCE_GSV, count_call, &counts, &handle) != GPS_OKAY) {
+            fail("bus: subscriber %d of %d not accepted", i + 1, GPS_BUS_MAX_SUBSCRIBERS);
+            return;
+        }
+    }
+    if (gps_bus_subscribe(&bus, GPS_SENTENCE_GGA, count_call, &counts, NULL) != GPS_MEM_LOW) {
+        fail("bus: subscriber accepted beyond %d slots", GPS_BUS_MAX_SUBSCRIBERS);
+    }
+
+    // Two subscribers that leave after their first sentence, between others
+    gps_bus_init(&bus);
+    gps_bus_subscribe(&bus, GPS_SENTENCE_GGA, count_call, &counts, NULL);
+    gps_bus_subscribe(&bus, GPS_SENTENCE_GGA, leave_after_call, &first, &first.handle);
+    gps_bus_subscribe(&bus, GPS_SENTENCE_GGA, leave_after_call, &second, &second.handle);
+    gps_bus_subscribe(&bus, GPS_SENTENCE_GGA, count_call, &counts, NULL);
+    memset(&counts, 0, sizeof(counts));
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < corpus->count; i++) {
+        gps_parser_parse(&parser, corpus->lines[i].ptr, corpus->lines[i].len);
+        gps_bus_dispatch(&bus, &parser.data, corpus->lines[i].ptr, corpus->lines[i].len, NULL);
+    }
+    if (first.calls != 1 || second.calls != 1 || counts.calls[GPS_SENTENCE_GGA] < 4 ||
+        counts.calls[GPS_SENTENCE_GGA] % 2) {
+        fail("bus: subscribers leaving in their callback called %u and %u times, the others %u times", first.calls,
+             second.calls, counts.calls[GPS_SENTENCE_GGA]);
+    }
+    // Their slots are free again
+    if (gps_bus_subscribe(&bus, GPS_EVENT_POSITION, count_call, &counts, &handle) != GPS_OKAY || handle != 1) {
+        fail("bus: slot of a subscriber that left not reused");
+    }
+}
+
+static void count_only(const gps_bus_msg_t *msg, void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+static void run_dispatch(void *arg)
+{
+    dispatch_ctx_t *ctx = arg;
+    for (size_t i = 0; i < ctx->count; i++) {
+        const dispatch_item_t *item = &ctx->items[i];
+        gps_bus_dispatch(&ctx->bus, &item->data, item->sentence, item->len, NULL);
+    }
+}
+
+void bench_bus(const corpus_t *corpora, size_t count)
+{
+    static dispatch_ctx_t ctx;
+    static gps_parser_t parser;
+
+    for (size_t c = 0; c < count; c++) {
+        check_corpus(&corpora[c]);
+    }
+    check_registry(&corpora[0]);
+    check_fields();
+
+    gps_parser_init(&parser);
+    ctx.items = malloc(corpora[0].count * sizeof(dispatch_item_t));
+    for (size_t i = 0; i < corpora[0].count; i++) {
+        const line_t *line = &corpora[0].lines[i];
+        if (line->len <= MAX_SENTENCE_LENGTH && gps_parser_parse(&parser, line->ptr, line->len) == GPS_OKAY) {
+            dispatch_item_t *item = &ctx.items[ctx.count++];
+            item->data = parser.data;
+            memcpy(item->sentence, line->ptr, line->len);
+            item->len = line->len;
+        }
+    }
+
+    static const char *const rows[] = {"none", "one GGA", "15 idle+1", "16 on GGA"};
+    for (int r = 0; r < 4; r++) {
+        gps_bus_init(&ctx.bus);
+        if (r == 1 || r == 2) {
+            gps_bus_subscribe(&ctx.bus, GPS_SENTENCE_GGA, count_only, &ctx.calls, NULL);
+        }
+        for (int i = 0; r >= 2 && i < GPS_BUS_MAX_SUBSCRIBERS - (r == 2); i++) {
+            // Idle ones wait for GLL, which the corpora do not have
+            gps_bus_subscribe(&ctx.bus, r == 2 ? GPS_SENTENCE_GLL : GPS_SENTENCE_GGA, count_only, &ctx.calls, NULL);
+        }
+        report("bus", rows[r], ctx.count, measure(run_dispatch, &ctx, ctx.count),
+               count_allocs(run_dispatch, &ctx, ctx.count));
+    }
+    free(ctx.items);
+}
@@ -0,0 +1,78 @@
+/* The streaming framer fed the way the UART task feeds it, in blocks of the
+ * size one wakeup reads. Blocks of 1 byte take the byte by byte path only,
+ * larger blocks frame most sentences in place. Every block size must produce
+ * the same sentences and counters as 1 byte blocks. */
+#include "bench.h"
+#include "gps_stream.h"
+
+typedef struct {
+    gps_parser_t parser;
+    gps_stream_t stream;
+    const corpus_t *corpus;
+    size_t chunk;
+    uint32_t digest;
+} chunk_ctx_t;
+
+// FNV-1a over what a consumer sees of every sentence
+static void on_sentence(const gps_t *data, void *arg)
+{
+    uint32_t *digest = arg;
+    int32_t values[] = {data->latitude_e7, data->longitude_e7, data->tim.hour, data->tim.minute,
+                        (int32_t)(data->tim.second * 1000), data->sentence, data->talker, data->status,
+                        data->sats_in_use, data->sats_in_view, (int32_t)(data->speed * 1000)};
+    const uint8_t *bytes = (const uint8_t *)values;
+    for (size_t i = 0; i < sizeof(values); i++) {
+        *digest = (*digest ^ bytes[i]) * 16777619u;
+    }
+}
+
+static void run_chunked(void *arg)
+{
+    chunk_ctx_t *ctx = arg;
+    feed_blocks(&ctx->stream, ctx->corpus->data, ctx->corpus->size, ctx->chunk);
+}
+
+// Digest and counters of one pass over the corpus from a fresh stream
+static void one_pass(chunk_ctx_t *ctx, const corpus_t *corpus, size_t chunk)
+{
+    gps_parser_init(&ctx->parser);
+    ctx->digest = 2166136261u;
+    gps_stream_init(&ctx->stream, &ctx->parser, on_sentence, &ctx->digest);
+    ctx->corpus = corpus;
+    ctx->chunk = chunk;
+    run_chunked(ctx);
+}
+
+void bench_chunked(const corpus_t *corpora, size_t count)
+{
+    static const struct {
+        size_t size;
+        const char *row;
+    } chunks[] = {
+        {1, "chunk1"}, {16, "chunk16"}, {120, "chunk120"}, {1024, "chunk1k"}, {4096, "chunk4k"},
+    };
+    static chunk_ctx_t ref, ctx;
+
+    for (size_t c = 0; c < count; c++) {
+        const corpus_t *corpus = &corpora[c];
+        one_pass(&ref, corpus, chunks[0].size);
+
+        for (size_t k = 0; k < sizeof(chunks) / sizeof(chunks[0]); k++) {
+            const char *row = chunks[k].row;
+
+            one_pass(&ctx, corpus, chunks[k].size);
+            if (ctx.digest != ref.digest || ctx.stream.sentences != ref.stream.sentences ||
+                ctx.stream.crc_errors != ref.stream.crc_errors ||
+                ctx.stream.framing_errors != ref.stream.framing_errors ||
+                ctx.stream.ignored != ref.stream.ignored) {
+                fail("%s %s: %u sentences, %u crc, %u framing, differs from byte by byte framing", corpus->name,
+                     row, (unsigned)ctx.stream.sentences, (unsigned)ctx.stream.crc_errors,
+                     (unsigned)ctx.stream.framing_errors);
+            }
+            // Time the framer and decoder only
+            ctx.stream.on_sentence = NULL;
+            double allocs = count_allocs(run_chunked, &ctx, corpus->count);
+            report_no_alloc(corpus->name, row, corpus->count, measure(run_chunked, &ctx, corpus->count), allocs);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/* Receiver command encoders against byte sequences published for MediaTek and
+ * u-blox receivers, and the baud rate switch-over against a simulated receiver
+ * in place of the UART. */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "gps_cmd.h"
+
+#define ALL_BUT_GLL_GSV                                                                                              \
+    (GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_GSA) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC) |  \
+     GPS_SENTENCE_BIT(GPS_SENTENCE_VTG))
+
+static void expect_text(const char *name, gps_status_t status, const gps_cmd_t *cmd, const char *expected)
+{
+    size_t len = strlen(expected);
+    if (status != GPS_OKAY || cmd->len != len || memcmp(cmd->data, expected, len) != 0) {
+        fail("cmd %s: got \"%.*s\" status %d, expected \"%s\"", name, cmd->len, (const char *)cmd->data, status,
+             expected);
+    }
+}
+
+static void expect_bytes(const char *name, gps_status_t status, const gps_cmd_t *cmd, const uint8_t *expected,
+                         size_t len)
+{
+    if (status != GPS_OKAY || cmd->len != len || memcmp(cmd->data, expected, len) != 0) {
+        fail("cmd %s: %u bytes status %d, expected %zu bytes", name, cmd->len, status, len);
+    }
+}
+
+static void check_encoders(void)
+{
+    static const uint8_t ubx_rate_5hz[] = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xC8, 0x00,
+                                           0x01, 0x00, 0x01, 0x00, 0xDE, 0x6A};
+    static const uint8_t ubx_rate_1hz[] = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xE8, 0x03,
+                                           0x01, 0x00, 0x01, 0x00, 0x01, 0x39};
+    static const uint8_t ubx_baud_115200[] = {0xB5, 0x62, 0x06, 0x00, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00,
+                                              0xD0, 0x08, 0x00, 0x00, 0x00, 0xC2, 0x01, 0x00, 0x07, 0x00,
+                                              0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x7E};
+    // GGA, GSA, RMC and VTG on, GLL and GSV off
+    static const uint8_t ubx_msgs[] = {
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x00, 0x01, 0xFB, 0x10,
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x01, 0x00, 0xFB, 0x11,
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x02, 0x01, 0xFD, 0x14,
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x03, 0x00, 0xFD, 0x15,
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x04, 0x01, 0xFF, 0x18,
+        0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x05, 0x01, 0x00, 0x1A,
+    };
+    gps_cmd_t cmd;
+
+    expect_text("pmtk baud", gps_cmd_pmtk_baud(115200, &cmd), &cmd, "$PMTK251,115200*1F\r\n");
+    expect_text("pmtk baud", gps_cmd_pmtk_baud(9600, &cmd), &cmd, "$PMTK251,9600*17\r\n");
+    expect_text("pmtk rate", gps_cmd_pmtk_rate(100, &cmd), &cmd, "$PMTK220,100*2F\r\n");
+    expect_text("pmtk rate", gps_cmd_pmtk_rate(1000, &cmd), &cmd, "$PMTK220,1000*1F\r\n");
+    expect_text("pmtk sentences",
+                gps_cmd_pmtk_sentences(GPS_SENTENCE_BIT(GPS_SENTENCE_RMC) | GPS_SENTENCE_BIT(GPS_SENTENCE_GGA), &cmd),
+                &cmd, "$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n");
+    expect_text("pmtk sentences", gps_cmd_pmtk_sentences(GPS_SENTENCE_BIT(GPS_SENTENCE_RMC), &cmd), &cmd,
+                "$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29\r\n");
+    expect_bytes("ubx rate", gps_cmd_ubx_rate(200, &cmd), &cmd, ubx_rate_5hz, sizeof(ubx_rate_5hz));
+    expect_bytes("ubx rate", gps_cmd_ubx_rate(1000, &cmd), &cmd, ubx_rate_1hz, sizeof(ubx_rate_1hz));
+    expect_bytes("ubx baud", gps_cmd_ubx_baud(115200, &cmd), &cmd, ubx_baud_115200, sizeof(ubx_baud_115200));
+    expect_bytes("ubx sentences", gps_cmd_ubx_sentences(ALL_BUT_GLL_GSV, &cmd), &cmd, ubx_msgs, sizeof(ubx_msgs));
+
+    if (gps_cmd_pmtk_baud(12345, &cmd) != GPS_INV_ARG || gps_cmd_pmtk_rate(50, &cmd) != GPS_INV_ARG ||
+        gps_cmd_ubx_rate(10, &cmd) != GPS_INV_ARG || gps_cmd_ubx_baud(0, &cmd) != GPS_INV_ARG) {
+        fail("cmd: out of range values accepted");
+    }
+}
+
+/* Stand-in for the receiver on the other end of the UART. It talks at its own
+ * baud rate, is heard only when the local port matches it and follows the
+ * baud rate commands it understands. */
+typedef struct {
+    uint32_t receiver_baud;
+    uint32_t port_baud;
+    bool deaf; /*!< Ignores every command */
+    int writes;
+} loopback_t;
+
+static gps_status_t loopback_write(void *ctx, const uint8_t *data, size_t len)
+{
+    loopback_t *lb = ctx;
+    lb->writes++;
+    if (lb->deaf || lb->port_baud != lb->receiver_baud) {
+        return GPS_OKAY;
+    }
+    if (len > 9 && memcmp(data, "$PMTK251,", 9) == 0) {
+        lb->receiver_baud = strtoul((const char *)data + 9, NULL, 10);
+    } else if (len == 28 && data[0] == 0xB5 && data[2] == 0x06 && data[3] == 0x00) {
+        lb->receiver_baud = data[14] | data[15] << 8 | data[16] << 16 | (uint32_t)data[17] << 24;
+    }
+    return GPS_OKAY;
+}
+
+static void loopback_set_baud(void *ctx, uint32_t baud)
+{
+    ((loopback_t *)ctx)->port_baud = baud;
+}
+
+static bool loopback_wait_sentence(void *ctx, uint32_t timeout_ms)
+{
+    loopback_t *lb = ctx;
+    return lb->port_baud == lb->receiver_baud;
+}
+
+static void check_switch(const char *name, gps_cmd_protocol_t protocol, uint32_t receiver_baud, bool deaf,
+                         gps_status_t expected, uint32_t expected_baud)
+{
+    loopback_t lb = {.receiver_baud = receiver_baud, .deaf = deaf};
+    gps_cmd_port_t port = {
+        .write = loopback_write,
+        .set_baud = loopback_set_baud,
+        .wait_sentence = loopback_wait_sentence,
+        .ctx = &lb,
+        .timeout_ms = 1000,
+    };
+    gps_status_t status = gps_cmd_switch_baud(&port, protocol, 9600, 115200);
+    if (status != expected || lb.port_baud != expected_baud || (status == GPS_OKAY && lb.receiver_baud != 115200)) {
+        fail("cmd switch %s: status %d, port at %lu, receiver at %lu", name, status, (unsigned long)lb.port_baud,
+             (unsigned long)lb.receiver_baud);
+    }
+}
+
+static void run_encode(void *arg)
+{
+    gps_cmd_t *cmd = arg;
+    gps_cmd_ubx_sentences(ALL_BUT_GLL_GSV, cmd);
+    gps_cmd_pmtk_sentences(ALL_BUT_GLL_GSV, cmd);
+}
+
+void bench_cmd(const corpus_t *corpora, size_t count)
+{
+    static gps_cmd_t cmd;
+
+    check_encoders();
+    check_switch("mtk", GPS_CMD_PROTOCOL_MTK, 9600, false, GPS_OKAY, 115200);
+    check_switch("ubx", GPS_CMD_PROTOCOL_UBX, 9600, false, GPS_OKAY, 115200);
+    check_switch("already switched", GPS_CMD_PROTOCOL_MTK, 115200, false, GPS_OKAY, 115200);
+    check_switch("no answer", GPS_CMD_PROTOCOL_UBX, 9600, true, GPS_TIMEOUT, 9600);
+    report("cmd", "encode", 2, measure(run_encode, &cmd, 2), count_allocs(run_encode, &cmd, 2));
+}
@@ -0,0 +1,145 @@
+/* Coordinate decoding: the fixed-point decoder against the strtof() based one
+ * it replaced, for speed and for precision against a double reference. The
+ * fixed-point result must be within one unit of latitude_e7, 1e-7 degrees, of
+ * the reference for every corpus coordinate and README sample. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_parser_priv.h"
+
+#define MAX_COORDS (8192)
+#define METERS_PER_DEGREE (111320.0)
+#define FIXED_BOUND (1e-7 * METERS_PER_DEGREE) /*!< 1e-7 degrees in meters */
+
+typedef struct {
+    const char *ptr;
+    uint8_t len;
+} coord_t;
+
+typedef struct {
+    coord_t coords[MAX_COORDS];
+    size_t count;
+    volatile int32_t sink;
+} coord_ctx_t;
+
+/* The coordinate samples quoted in the README */
+static const char *readme_samples[] = {"4014.86746", "06955.59231", "3414.86611", "07155.58886"};
+
+/* Previous decoder, kept as the baseline */
+static float coordinate_strtof(const char *coord)
+{
+    float tmp_value = strtof(coord, NULL);
+    int degrees = ((int)tmp_value) / 100;
+    float minutes = tmp_value - (degrees * 100);
+    return degrees + minutes / 60.0;
+}
+
+static double coordinate_reference(const char *coord)
+{
+    double value = strtod(coord, NULL);
+    double degrees = floor(value / 100.0);
+    return degrees + (value - degrees * 100.0) / 60.0;
+}
+
+static void run_strtof(void *arg)
+{
+    coord_ctx_t *ctx = arg;
+    for (size_t i = 0; i < ctx->count; i++) {
+        ctx->sink = (int32_t)coordinate_strtof(ctx->coords[i].ptr);
+    }
+}
+
+static void run_fixed(void *arg)
+{
+    coord_ctx_t *ctx = arg;
+    int32_t value = 0;
+    for (size_t i = 0; i < ctx->count; i++) {
+        gps_decode_coordinate(ctx->coords[i].ptr, ctx->coords[i].len, &value);
+        ctx->sink = value;
+    }
+}
+
+static void add_field(coord_ctx_t *ctx, const line_t *line, int wanted)
+{
+    int idx = 0;
+    const char *start = line->ptr;
+    for (const char *p = line->ptr, *end = line->ptr + line->len; p < end && ctx->count < MAX_COORDS; p++) {
+        if (*p != ',' && *p != '*') {
+            continue;
+        }
+        if (idx == wanted && p - start >= 9) {
+            ctx->coords[ctx->count].ptr = start;
+            ctx->coords[ctx->count].len = p - start;
+            ctx->count++;
+            return;
+        }
+        idx++;
+        start = p + 1;
+    }
+}
+
+/* Largest error in meters of both decoders over ctx */
+static void precision(const coord_ctx_t *ctx, double *strtof_error, double *fixed_error)
+{
+    *strtof_error = 0.0;
+    *fixed_error = 0.0;
+    for (size_t i = 0; i < ctx->count; i++) {
+        int32_t fixed = 0;
+        double reference = coordinate_reference(ctx->coords[i].ptr);
+        gps_decode_coordinate(ctx->coords[i].ptr, ctx->coords[i].len, &fixed);
+        *strtof_error = fmax(*strtof_error, fabs(coordinate_strtof(ctx->coords[i].ptr) - reference) * METERS_PER_DEGREE);
+        *fixed_error = fmax(*fixed_error, fabs(fixed / 1e7 - reference) * METERS_PER_DEGREE);
+    }
+}
+
+void bench_coord(const corpus_t *corpora, size_t count)
+{
+    static coord_ctx_t ctx;
+    static gps_parser_t parser;
+    double strtof_error, fixed_error;
+
+    gps_parser_init(&parser);
+    ctx.count = 0;
+    for (size_t c = 0; c < count; c++) {
+        for (size_t i = 0; i < corpora[c].count; i++) {
+            const line_t *line = &corpora[c].lines[i];
+            // Fields of damaged sentences never reach the decoder
+            if (gps_parser_parse(&parser, line->ptr, line->len) != GPS_OKAY) {
+                continue;
+            }
+            if (memcmp(line->ptr + 3, "GGA,", 4) == 0) {
+                add_field(&ctx, line, 2);
+                add_field(&ctx, line, 4);
+            } else if (memcmp(line->ptr + 3, "RMC,", 4) == 0) {
+                add_field(&ctx, line, 3);
+                add_field(&ctx, line, 5);
+            }
+        }
+    }
+    if (ctx.count == 0) {
+        return;
+    }
+
+    report("coordinates", "strtof", ctx.count, measure(run_strtof, &ctx, ctx.count), count_allocs(run_strtof, &ctx, ctx.count));
+    report("coordinates", "fixed", ctx.count, measure(run_fixed, &ctx, ctx.count), count_allocs(run_fixed, &ctx, ctx.count));
+    precision(&ctx, &strtof_error, &fixed_error);
+    note("max error over %zu corpus coordinates: strtof %.3f m, fixed %.4f m", ctx.count, strtof_error, fixed_error);
+    if (fixed_error > FIXED_BOUND) {
+        fail("coord: fixed-point error %.4f m over %zu corpus coordinates, more than 1e-7 degrees", fixed_error,
+             ctx.count);
+    }
+
+    ctx.count = 0;
+    for (size_t i = 0; i < sizeof(readme_samples) / sizeof(readme_samples[0]); i++) {
+        ctx.coords[0].ptr = readme_samples[i];
+        ctx.coords[0].len = strlen(readme_samples[i]);
+        ctx.count = 1;
+        precision(&ctx, &strtof_error, &fixed_error);
+        note("README %-12s reference %.9f: strtof error %.3f m, fixed error %.4f m",
+             readme_samples[i], coordinate_reference(readme_samples[i]), strtof_error, fixed_error);
+        if (fixed_error > FIXED_BOUND) {
+            fail("coord: README sample %s decoded %.4f m off, more than 1e-7 degrees", readme_samples[i], fixed_error);
+        }
+    }
+}
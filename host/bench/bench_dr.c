@@ -0,0 +1,179 @@
+/* Dead reckoning. The fixes of every corpus are fed to gps_dr_t one by one or
+ * every second one, and each following fix is predicted from the ones before
+ * it. The prediction must be closer than reusing the last fix and the true
+ * position must mostly, 90% or more, lie within the error estimate. Synthetic tracks check
+ * that a new fix is blended in without a jump, the antimeridian and the age
+ * limit. The cost of one query is reported. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_dr.h"
+
+#define MAX_AGE_MS  (5000)
+#define BLEND_MS    (250)
+#define QUERIES     (1000)
+
+typedef struct {
+    gps_dr_t dr;
+    gps_dr_position_t out;
+} query_ctx_t;
+
+// Distance in meters on a sphere, within 0.5% of the ellipsoid and flat over a few seconds of travel
+static double distance_m(int32_t lat_a, int32_t lon_a, int32_t lat_b, int32_t lon_b)
+{
+    double dlon = (double)lon_a - lon_b;
+    if (dlon > 1.8e9) {
+        dlon -= 3.6e9;
+    } else if (dlon < -1.8e9) {
+        dlon += 3.6e9;
+    }
+    double north = (lat_a - lat_b) * 1e-7 * 111195.0;
+    double east = dlon * 1e-7 * 111195.0 * cos(lat_b * 1e-7 * M_PI / 180.0);
+    return sqrt(north * north + east * east);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Feeds every step-th fix and predicts the fixes in between and the next fed
+ * one, at the UTC time of each. */
+static void check_track(const char *name, const fix_list_t *list, size_t step)
+{
+    gps_dr_t dr;
+    double *dr_err = malloc(list->count * sizeof(double));
+    double dr_sum = 0, hold_sum = 0;
+    size_t n = 0, within = 0;
+
+    gps_dr_init(&dr, MAX_AGE_MS, BLEND_MS);
+    for (size_t i = 0; i < list->count; i++) {
+        const gps_epoch_fix_t *fix = &list->fixes[i];
+        gps_dr_position_t out;
+        if (dr.valid && gps_dr_at(&dr, fix->data.utc_ms, &out) && fix->data.fix != GPS_FIX_INVALID) {
+            double err = distance_m(out.lat_e7, out.lon_e7, fix->data.latitude_e7, fix->data.longitude_e7);
+            dr_err[n++] = err;
+            dr_sum += err;
+            hold_sum += distance_m(dr.lat_e7, dr.lon_e7, fix->data.latitude_e7, fix->data.longitude_e7);
+            within += err * 100.0 <= out.error_cm;
+        }
+        if (i % step == 0) {
+            gps_dr_update(&dr, fix, 0);
+        }
+    }
+    if (n == 0) {
+        free(dr_err);
+        return;
+    }
+    qsort(dr_err, n, sizeof(double), compare_double);
+    note("%s: fixes %zu s apart, %zu predictions, error mean %.2f m p95 %.2f m max %.2f m, last fix %.2f m, "
+         "%.1f%% within the estimate",
+         name, step, n, dr_sum / n, dr_err[n * 95 / 100], dr_err[n - 1], hold_sum / n, 100.0 * within / n);
+    // A parked receiver only has noise to extrapolate
+    if (hold_sum / n > 1.0 && dr_sum >= hold_sum) {
+        fail("%s: dead reckoning %.2f m is not better than the last fix %.2f m", name, dr_sum / n, hold_sum / n);
+    }
+    if (within < n * 9 / 10) {
+        fail("%s: only %zu of %zu positions within the error estimate", name, within, n);
+    }
+    free(dr_err);
+}
+
+static gps_epoch_fix_t synthetic_fix(int64_t utc_ms, int32_t lat_e7, int32_t lon_e7, float speed_kn, float cog)
+{
+    gps_epoch_fix_t fix;
+    memset(&fix, 0, sizeof(fix));
+    fix.sentences = GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC);
+    fix.data.utc_ms = utc_ms;
+    fix.data.latitude_e7 = lat_e7;
+    fix.data.longitude_e7 = lon_e7;
+    fix.data.speed = speed_kn;
+    fix.data.cog = cog;
+    fix.data.fix = GPS_FIX_GPS;
+    fix.data.valid = true;
+    fix.data.dop_h = 1.0f;
+    fix.data.fields = GPS_FIELDS_ALL;
+    return fix;
+}
+
+static void check_synthetic(void)
+{
+    static const int64_t t0 = (int64_t)1713312000 * 1000;
+    gps_dr_t dr;
+    gps_dr_position_t before, after, out;
+
+    // 20 kn north, the second fix is 3 m short of the extrapolation
+    gps_dr_init(&dr, MAX_AGE_MS, BLEND_MS);
+    gps_epoch_fix_t fix = synthetic_fix(t0, 340000000, 710000000, 20.0f, 0.0f);
+    gps_dr_update(&dr, &fix, 0);
+    gps_dr_at(&dr, t0 + 1000, &before);
+    double travelled = distance_m(before.lat_e7, before.lon_e7, fix.data.latitude_e7, fix.data.longitude_e7);
+    if (fabs(travelled / (20 * 0.514444) - 1) > 0.005 || before.lon_e7 != fix.data.longitude_e7) {
+        fail("dr: 20 kn north travelled %.3f m in 1 s", travelled);
+    }
+    fix = synthetic_fix(t0 + 1000, before.lat_e7 - 270, 710000000, 20.0f, 0.0f);
+    gps_dr_update(&dr, &fix, 1000);
+    gps_dr_at(&dr, t0 + 1000, &after);
+    if (abs(after.lat_e7 - before.lat_e7) > 1 || after.lon_e7 != before.lon_e7) {
+        fail("dr: position jumped by %d when the next fix arrived", after.lat_e7 - before.lat_e7);
+    }
+    // Past the blend the new fix alone counts
+    gps_dr_at(&dr, t0 + 1000 + BLEND_MS, &out);
+    int32_t expected = fix.data.latitude_e7 + (int32_t)(((int64_t)dr.lat_rate * BLEND_MS) >> 16);
+    if (out.lat_e7 != expected) {
+        fail("dr: offset of %d left after the blend", out.lat_e7 - expected);
+    }
+
+    // 100 kn east across the antimeridian
+    gps_dr_init(&dr, MAX_AGE_MS, BLEND_MS);
+    fix = synthetic_fix(t0, 0, 1799999800, 100.0f, 90.0f);
+    gps_dr_update(&dr, &fix, 0);
+    gps_dr_at(&dr, t0 + 1000, &out);
+    travelled = distance_m(out.lat_e7, out.lon_e7, fix.data.latitude_e7, fix.data.longitude_e7);
+    if (out.lon_e7 > -1799000000 || fabs(travelled / (100 * 0.514444) - 1) > 0.005) {
+        fail("dr: crossing the antimeridian ended at %d after %.3f m", out.lon_e7, travelled);
+    }
+
+    // Too old to extrapolate
+    if (gps_dr_at(&dr, t0 + MAX_AGE_MS + 1, &out) || out.error_cm != UINT32_MAX ||
+        !gps_dr_at(&dr, t0 + MAX_AGE_MS, &out) || out.error_cm == UINT32_MAX) {
+        fail("dr: age limit of %d ms not applied", MAX_AGE_MS);
+    }
+    // Neither an invalid nor an older fix moves the origin
+    fix = synthetic_fix(t0 - 1000, 0, 0, 0.0f, 0.0f);
+    gps_epoch_fix_t invalid = synthetic_fix(t0 + 1000, 0, 0, 0.0f, 0.0f);
+    invalid.data.fix = GPS_FIX_INVALID;
+    if (gps_dr_update(&dr, &fix, 0) || gps_dr_update(&dr, &invalid, 0) || dr.lon_e7 != 1799999800) {
+        fail("dr: an old or invalid fix replaced the origin");
+    }
+}
+
+static void run_query(void *arg)
+{
+    query_ctx_t *ctx = arg;
+    for (int i = 0; i < QUERIES; i++) {
+        gps_dr_at(&ctx->dr, ctx->dr.fix_ms + i * 4, &ctx->out);
+    }
+}
+
+void bench_dr(const corpus_t *corpora, size_t count)
+{
+    static query_ctx_t ctx;
+
+    check_synthetic();
+    for (size_t c = 0; c < count; c++) {
+        fix_list_t list = {.fields = GPS_FIELD_POSITION};
+        collect_fixes(&corpora[c], &list);
+        check_track(corpora[c].name, &list, 1);
+        check_track(corpora[c].name, &list, 2);
+        if (c == 0 && list.count) {
+            gps_dr_init(&ctx.dr, MAX_AGE_MS, BLEND_MS);
+            gps_dr_update(&ctx.dr, &list.fixes[list.count - 1], 0);
+        }
+        free(list.fixes);
+    }
+    // 1000 queries over 4 s after a fix, blend included
+    report("dr", "at", QUERIES, measure(run_query, &ctx, QUERIES), count_allocs(run_query, &ctx, QUERIES));
+}
@@ -0,0 +1,278 @@
+/* Geofences. 10000 random star shaped fences around the drive corpus are
+ * compiled into a grid index, and the fences a tracker is in after every
+ * position must be exactly the ones a linear test of all fences finds, for
+ * random positions and the fixes of every corpus. A position jittering across
+ * an edge must only enter and leave once with a margin, more fences than the
+ * tracker lists must all be left, and a damaged index must not load. The cost
+ * per fence of the linear test and per fix of the index at 100 to 10000
+ * fences is reported. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_fence.h"
+
+#define FENCES        (10000)
+#define MAX_VERTICES  (12)
+#define CENTER_LAT    (342478000) /*!< Start of drive.nmea */
+#define CENTER_LON    (719264000)
+#define SPREAD        (1000000)   /*!< Fences within 0.1 degrees of the center */
+#define RANDOM_POINTS (2000)
+#define MARGIN_M      (5.0f)
+
+typedef struct {
+    gps_fence_polygon_t polygons[FENCES];
+    int32_t vertices[FENCES][2 * MAX_VERTICES];
+} fence_set_t;
+
+typedef struct {
+    int32_t *points; /*!< lat_e7, lon_e7 pairs */
+    size_t count;
+    size_t capacity;
+} point_list_t;
+
+typedef struct {
+    const gps_fence_index_t *index;
+    gps_fence_tracker_t tracker;
+    uint32_t inside[GPS_FENCE_WORDS(FENCES)];
+    const point_list_t *path;
+    uint32_t found;
+} fence_ctx_t;
+
+static uint32_t rng_state = 7;
+
+static void add_point(point_list_t *list, int32_t lat_e7, int32_t lon_e7)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->points = realloc(list->points, list->capacity * 2 * sizeof(int32_t));
+    }
+    list->points[2 * list->count] = lat_e7;
+    list->points[2 * list->count + 1] = lon_e7;
+    list->count++;
+}
+
+// Star shaped and mostly concave, 30 to 400 m across
+static void make_fences(fence_set_t *set)
+{
+    for (int i = 0; i < FENCES; i++) {
+        int32_t lat = CENTER_LAT + (int32_t)(bench_rng(&rng_state) % (2 * SPREAD)) - SPREAD;
+        int32_t lon = CENTER_LON + (int32_t)(bench_rng(&rng_state) % (2 * SPREAD)) - SPREAD;
+        double radius_e7 = 1350 + bench_rng(&rng_state) % 16650;
+        int count = 3 + bench_rng(&rng_state) % (MAX_VERTICES - 2);
+        for (int v = 0; v < count; v++) {
+            double angle = 2 * M_PI * v / count;
+            double r = radius_e7 * (0.4 + (bench_rng(&rng_state) % 600) / 1000.0);
+            set->vertices[i][2 * v] = lat + (int32_t)(r * sin(angle));
+            set->vertices[i][2 * v + 1] = lon + (int32_t)(r * cos(angle) / cos(34.25 * M_PI / 180));
+        }
+        set->polygons[i].id = 1000 + i;
+        set->polygons[i].vertices = set->vertices[i];
+        set->polygons[i].count = count;
+    }
+}
+
+static gps_fence_index_t *build(const gps_fence_polygon_t *polygons, size_t count)
+{
+    size_t size = gps_fence_build(polygons, count, NULL, 0);
+    gps_fence_index_t *index = malloc(size);
+    if (index == NULL || gps_fence_build(polygons, count, index, size) != size ||
+        gps_fence_load(index, size) != index) {
+        fail("fence: %zu fences did not compile into %zu bytes", count, size);
+    }
+    return index;
+}
+
+// With no margin the tracker must be in exactly the fences that contain the point
+static void check_points(const gps_fence_index_t *index, const point_list_t *points, const char *name)
+{
+    static fence_ctx_t ctx;
+    size_t inside = 0;
+
+    gps_fence_tracker_init(&ctx.tracker, index, ctx.inside, 0.0f, NULL, NULL);
+    for (size_t p = 0; p < points->count; p++) {
+        int32_t lat = points->points[2 * p], lon = points->points[2 * p + 1];
+        gps_fence_check(&ctx.tracker, lat, lon);
+        for (uint32_t f = 0; f < index->fence_count; f++) {
+            bool expected = gps_fence_contains(index, f, lat, lon);
+            if (expected != !!(ctx.inside[f / 32] & (1u << (f % 32)))) {
+                fail("fence: %s point %zu is %s fence %u but the tracker says otherwise", name, p,
+                     expected ? "inside" : "outside", f);
+                return;
+            }
+            inside += expected;
+        }
+    }
+    note("fence: %s, %zu positions, %zu times inside a fence, %u events", name, points->count, inside,
+         ctx.tracker.events);
+}
+
+static void count_event(uint32_t id, bool inside, void *arg)
+{
+    (*(int *)arg)++;
+}
+
+static void check_hysteresis(void)
+{
+    // 100 m square around the center
+    static const int32_t square[] = {
+        CENTER_LAT - 4500, CENTER_LON - 5440, CENTER_LAT + 4500, CENTER_LON - 5440,
+        CENTER_LAT + 4500, CENTER_LON + 5440, CENTER_LAT - 4500, CENTER_LON + 5440,
+    };
+    static const gps_fence_polygon_t polygon = {.id = 1, .vertices = square, .count = 4};
+    static uint32_t inside[1];
+    gps_fence_tracker_t tracker;
+
+    gps_fence_index_t *index = build(&polygon, 1);
+    for (int pass = 0; pass < 2; pass++) {
+        int events = 0;
+        gps_fence_tracker_init(&tracker, index, inside, pass ? MARGIN_M : 0.0f, count_event, &events);
+        // West to east along the middle in 1 m steps, 3 m of noise
+        for (int x = -80; x <= 80; x++) {
+            int32_t noise = (int32_t)(bench_rng(&rng_state) % 600) - 300;
+            gps_fence_check(&tracker, CENTER_LAT, CENTER_LON + (x * 100 + noise) * 109 / 100);
+        }
+        if (pass && events != 2) {
+            fail("fence: %d events crossing a fence with a %.0f m margin, expected 2", events, MARGIN_M);
+        }
+        note("fence: crossing a fence with 3 m of noise, %d events with %.0f m margin", events,
+             pass ? MARGIN_M : 0.0f);
+    }
+
+    // 40 nested squares, more than the tracker lists, are all left
+    static gps_fence_polygon_t nested[40];
+    static int32_t nested_vertices[40][8];
+    static uint32_t nested_inside[2];
+    for (int i = 0; i < 40; i++) {
+        int32_t r = 1000 + i * 100;
+        int32_t v[8] = {CENTER_LAT - r, CENTER_LON - r, CENTER_LAT + r, CENTER_LON - r,
+                        CENTER_LAT + r, CENTER_LON + r, CENTER_LAT - r, CENTER_LON + r};
+        memcpy(nested_vertices[i], v, sizeof(v));
+        nested[i] = (gps_fence_polygon_t){.id = i, .vertices = nested_vertices[i], .count = 4};
+    }
+    free(index);
+    index = build(nested, 40);
+    int events = 0;
+    gps_fence_tracker_init(&tracker, index, nested_inside, MARGIN_M, count_event, &events);
+    gps_fence_check(&tracker, CENTER_LAT, CENTER_LON);
+    gps_fence_check(&tracker, CENTER_LAT + SPREAD, CENTER_LON);
+    if (events != 80 || nested_inside[0] || nested_inside[1] || tracker.overflow || tracker.active_count) {
+        fail("fence: %d events entering and leaving 40 nested fences, expected 80", events);
+    }
+    free(index);
+}
+
+static void check_damaged(gps_fence_index_t *index)
+{
+    size_t size = index->size;
+    if (gps_fence_load(index, size - 4) != NULL) {
+        fail("fence: truncated index loaded");
+    }
+    index->magic[0] ^= 0xFF;
+    if (gps_fence_load(index, size) != NULL) {
+        fail("fence: index with a damaged header loaded");
+    }
+    index->magic[0] ^= 0xFF;
+    // Tables that point past their targets, with the header and the size intact
+    uint32_t *start = (uint32_t *)gps_fence_cells(index) + index->rows * index->cols / 2;
+    uint32_t saved = *start;
+    *start = index->entry_count + 1;
+    if (gps_fence_load(index, size) != NULL) {
+        fail("fence: index with a cell offset out of range loaded");
+    }
+    *start = saved;
+    uint32_t *entry = (uint32_t *)gps_fence_entries(index) + index->entry_count / 2;
+    saved = *entry;
+    *entry = index->fence_count;
+    if (gps_fence_load(index, size) != NULL) {
+        fail("fence: index with an entry past the fences loaded");
+    }
+    *entry = saved;
+    gps_fence_t *fence = (gps_fence_t *)gps_fence_table(index) + index->fence_count - 1;
+    saved = fence->first;
+    fence->first = index->vertex_count - 2;
+    if (gps_fence_load(index, size) != NULL) {
+        fail("fence: index with a fence past the vertices loaded");
+    }
+    fence->first = saved;
+    if (gps_fence_load(index, size) != index) {
+        fail("fence: restored index not loaded");
+    }
+    uint32_t erased[sizeof(gps_fence_index_t) / sizeof(uint32_t)];
+    memset(erased, 0xFF, sizeof(erased));
+    if (gps_fence_load(erased, sizeof(erased)) != NULL) {
+        fail("fence: erased flash loaded as an index");
+    }
+}
+
+static void run_linear(void *arg)
+{
+    fence_ctx_t *ctx = arg;
+    for (size_t p = 0; p < ctx->path->count; p++) {
+        for (uint32_t f = 0; f < ctx->index->fence_count; f++) {
+            ctx->found += gps_fence_contains(ctx->index, f, ctx->path->points[2 * p], ctx->path->points[2 * p + 1]);
+        }
+    }
+}
+
+static void run_grid(void *arg)
+{
+    fence_ctx_t *ctx = arg;
+    for (size_t p = 0; p < ctx->path->count; p++) {
+        gps_fence_check(&ctx->tracker, ctx->path->points[2 * p], ctx->path->points[2 * p + 1]);
+    }
+}
+
+void bench_fence(const corpus_t *corpora, size_t count)
+{
+    static fence_set_t set;
+    static fence_ctx_t ctx;
+    point_list_t random = {0}, path = {0};
+
+    make_fences(&set);
+    gps_fence_index_t *index = build(set.polygons, FENCES);
+    note("fence: %u fences in %ux%u cells, %.1f fences per cell, %.1f bytes per fence", index->fence_count,
+         index->rows, index->cols, (double)index->entry_count / (index->rows * index->cols),
+         (double)index->size / index->fence_count);
+
+    for (int i = 0; i < RANDOM_POINTS; i++) {
+        int32_t lat = CENTER_LAT + (int32_t)(bench_rng(&rng_state) % (3 * SPREAD)) - 3 * SPREAD / 2;
+        int32_t lon = CENTER_LON + (int32_t)(bench_rng(&rng_state) % (3 * SPREAD)) - 3 * SPREAD / 2;
+        add_point(&random, lat, lon);
+    }
+    check_points(index, &random, "random");
+    for (size_t c = 0; c < count; c++) {
+        fix_list_t fixes = {.fields = GPS_FIELD_POSITION};
+        collect_fixes(&corpora[c], &fixes);
+        for (size_t i = 0; i < fixes.count; i++) {
+            if (fixes.fixes[i].data.latitude_e7) {
+                add_point(&path, fixes.fixes[i].data.latitude_e7, fixes.fixes[i].data.longitude_e7);
+            }
+        }
+        free(fixes.fixes);
+    }
+    check_points(index, &path, "corpus fixes");
+    check_hysteresis();
+    check_damaged(index);
+
+    ctx.path = &path;
+    ctx.index = index;
+    // Per fence tested, every fix tests all of them
+    size_t tests = path.count * FENCES;
+    double linear = measure(run_linear, &ctx, tests);
+    report("fence", "linear", tests, linear, count_allocs(run_linear, &ctx, tests));
+    note("fence: the linear test of %d fences takes %.1f us per fix", FENCES, linear * FENCES / 1000.0);
+    free(index);
+    static const size_t sizes[] = {100, 1000, FENCES};
+    static const char *const rows[] = {"grid100", "grid1k", "grid10k"};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        index = build(set.polygons, sizes[s]);
+        ctx.index = index;
+        gps_fence_tracker_init(&ctx.tracker, index, ctx.inside, MARGIN_M, NULL, NULL);
+        report("fence", rows[s], path.count, measure(run_grid, &ctx, path.count),
+               count_allocs(run_grid, &ctx, path.count));
+        free(index);
+    }
+    free(random.points);
+    free(path.points);
+}
@@ -0,0 +1,342 @@
+/* NMEA encoder and stream generator. Every GGA, GSA, RMC and VTG of a corpus
+ * is encoded again from what the parser decoded and must decode to the same
+ * values, most of them to the receiver's own text. Generated streams of four
+ * constellations that cross the antimeridian must decode to the generator's
+ * true state epoch by epoch, and with damaged sentences the stream must count
+ * exactly the checksum and framing errors the generator made. The cost of
+ * encoding a sentence is reported next to snprintf, and of generating one. */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_encode.h"
+#include "gps_gen.h"
+#include "gps_stream.h"
+
+#define GEN_EPOCHS  (3000)
+#define RUN_EPOCHS  (100)
+
+typedef struct {
+    gps_t data;
+    gps_sentence_t type;
+} encode_item_t;
+
+typedef struct {
+    encode_item_t *items;
+    size_t count;
+    size_t bytes;
+    char out[GPS_ENCODE_MAX_GSV];
+} encode_ctx_t;
+
+typedef struct {
+    gps_gen_t gen;
+    char out[GPS_GEN_MAX_EPOCH];
+    size_t bytes;
+} gen_ctx_t;
+
+typedef struct {
+    gps_parser_t parser;
+    gps_stream_t stream;
+    uint32_t decoded;
+} decode_ctx_t;
+
+static bool near(float a, float b, float tolerance)
+{
+    return fabsf(a - b) <= tolerance;
+}
+
+static bool near_e7(int32_t a, int32_t b)
+{
+    return a - b >= -1 && a - b <= 1;
+}
+
+// The values type carries, precision of the encoder and a float parse apart
+static const char *compare(const gps_t *a, const gps_t *b, gps_sentence_t type)
+{
+    bool time = b->time_ms - a->time_ms + 10 < 20;
+    bool position = near_e7(a->latitude_e7, b->latitude_e7) && near_e7(a->longitude_e7, b->longitude_e7);
+    switch (type) {
+        case GPS_SENTENCE_GGA:
+            if (!time || !position) {
+                return "time or position";
+            }
+            if (a->fix != b->fix || a->sats_in_use != b->sats_in_use || !near(a->dop_h, b->dop_h, 0.0051f) ||
+                !near(a->altitude, b->altitude, 0.051f) || !near(a->geoid_height, b->geoid_height, 0.051f)) {
+                return "fix, satellites, HDOP or altitude";
+            }
+            return NULL;
+        case GPS_SENTENCE_GSA:
+            if (a->mode != b->mode || a->fix_mode != b->fix_mode || !near(a->dop_p, b->dop_p, 0.0051f) ||
+                !near(a->dop_h, b->dop_h, 0.0051f) || !near(a->dop_v, b->dop_v, 0.0051f)) {
+                return "mode or DOP";
+            }
+            return NULL;
+        case GPS_SENTENCE_RMC:
+            if (!time || !position || a->valid != b->valid || memcmp(&a->date, &b->date, sizeof(a->date)) != 0) {
+                return "time, position, validity or date";
+            }
+            // fall through
+        case GPS_SENTENCE_VTG:
+            if (!near(a->speed, b->speed, 0.00051f * (1 + a->speed)) || !near(a->cog, b->cog, 0.0051f)) {
+                return "speed or course";
+            }
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+static void check_corpus(const corpus_t *corpus, encode_ctx_t *items)
+{
+    static gps_parser_t parser, reparser;
+    char out[GPS_ENCODE_MAX_SENTENCE];
+    size_t encoded = 0, identical = 0;
+
+    gps_parser_init(&parser);
+    gps_parser_init(&reparser);
+    for (size_t i = 0; i < corpus->count; i++) {
+        const line_t *line = &corpus->lines[i];
+        if (gps_parser_parse(&parser, line->ptr, line->len) != GPS_OKAY) {
+            continue;
+        }
+        gps_sentence_t type = parser.data.sentence;
+        if (type != GPS_SENTENCE_GGA && type != GPS_SENTENCE_GSA && type != GPS_SENTENCE_RMC &&
+            type != GPS_SENTENCE_VTG) {
+            continue;
+        }
+        size_t n = gps_encode(&parser.data, type, parser.data.talker, out, sizeof(out));
+        if (n == 0 || n > GPS_ENCODE_MAX_SENTENCE || out[n - 2] != '\r' || out[n - 1] != '\n') {
+            fail("%s: line %zu did not encode into %zu bytes", corpus->name, i + 1, sizeof(out));
+            return;
+        }
+        if (gps_parser_parse(&reparser, out, n - 2) != GPS_OKAY || reparser.data.sentence != type) {
+            fail("%s: line %zu encoded as %.*s, which does not parse", corpus->name, i + 1, (int)n - 2, out);
+            return;
+        }
+        const char *differs = compare(&parser.data, &reparser.data, type);
+        if (differs) {
+            fail("%s: line %zu: %s of %.*s differ from %.*s", corpus->name, i + 1, differs, (int)n - 2, out,
+                 (int)line->len, line->ptr);
+            return;
+        }
+        if (gps_encode(&parser.data, type, parser.data.talker, out, n - 1) != 0) {
+            fail("%s: line %zu encoded into a buffer one byte short", corpus->name, i + 1);
+        }
+        encoded++;
+        identical += n - 2 == line->len && memcmp(out, line->ptr, line->len) == 0;
+        if (items) {
+            items->items = realloc(items->items, (items->count + 1) * sizeof(encode_item_t));
+            items->items[items->count++] = (encode_item_t){.data = parser.data, .type = type};
+        }
+    }
+    note("%s: %zu sentences encoded back to the same values, %zu of them to the same text", corpus->name, encoded,
+         identical);
+}
+
+static void on_sentence(const gps_t *data, void *arg)
+{
+    ((decode_ctx_t *)arg)->decoded++;
+}
+
+// The satellites parsed for a talker must be the ones the generator put in view
+static bool same_sky(const gps_t *parsed, const gps_t *truth)
+{
+    if (parsed->sats_in_view != truth->sats_in_view) {
+        return false;
+    }
+    for (uint8_t i = 0; i < truth->sats_in_view; i++) {
+        const gps_satellite_t *want = &truth->sats_desc_in_view[i];
+        bool found = false;
+        for (uint8_t j = 0; j < parsed->sats_in_view && !found; j++) {
+            found = memcmp(&parsed->sats_desc_in_view[j], want, sizeof(*want)) == 0;
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void check_stream(const char *name, const gps_gen_config_t *config)
+{
+    static gen_ctx_t gen;
+    static decode_ctx_t dec;
+    size_t checked = 0;
+    int32_t min_lon = INT32_MAX, max_lon = INT32_MIN;
+
+    gps_gen_init(&gen.gen, config);
+    gps_parser_init(&dec.parser);
+    gps_stream_init(&dec.stream, &dec.parser, on_sentence, &dec);
+    dec.decoded = 0;
+    bool damaged = config->corrupt_permille || config->truncate_permille;
+    for (int e = 0; e < GEN_EPOCHS; e++) {
+        size_t n = gps_gen_epoch(&gen.gen, gen.out, sizeof(gen.out));
+        gps_stream_feed(&dec.stream, (const uint8_t *)gen.out, n);
+        if (damaged) {
+            continue;
+        }
+        const gps_t *truth = &gen.gen.truth, *parsed = &dec.parser.data;
+        const char *differs = NULL;
+        for (gps_sentence_t type = GPS_SENTENCE_GGA; type <= GPS_SENTENCE_VTG && !differs; type++) {
+            if (config->sentences & GPS_SENTENCE_BIT(type)) {
+                differs = compare(truth, parsed, type);
+            }
+        }
+        if (!differs && (parsed->time_ms != truth->time_ms || parsed->utc_ms != truth->utc_ms)) {
+            differs = "time";
+        }
+        if (!differs && !same_sky(parsed, truth)) {
+            differs = "satellites in view";
+        }
+        if (differs) {
+            fail("gen: %s epoch %d: %s decoded from %.*s differ from the generated state", name, e, differs, (int)n,
+                 gen.out);
+            return;
+        }
+        min_lon = parsed->longitude_e7 < min_lon ? parsed->longitude_e7 : min_lon;
+        max_lon = parsed->longitude_e7 > max_lon ? parsed->longitude_e7 : max_lon;
+        checked++;
+    }
+    const gps_gen_stats_t *sent = &gen.gen.stats;
+    if (dec.stream.crc_errors != sent->corrupted || dec.stream.framing_errors != sent->truncated ||
+        dec.decoded != sent->sentences - sent->corrupted - sent->truncated) {
+        fail("gen: %s: %u checksum and %u framing errors, %u decoded, generated %u and %u of %u sentences", name,
+             dec.stream.crc_errors, dec.stream.framing_errors, dec.decoded, sent->corrupted, sent->truncated,
+             sent->sentences);
+    }
+    if (!damaged && (min_lon > -1799000000 || max_lon < 1799000000)) {
+        fail("gen: %s never crossed the antimeridian", name);
+    }
+    note("gen: %s, %u epochs, %u sentences, %u bytes, %zu epochs match, %u checksum and %u framing errors", name,
+         sent->epochs, sent->sentences, (unsigned)sent->bytes, checked, dec.stream.crc_errors,
+         dec.stream.framing_errors);
+}
+
+static void run_encode(void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    for (size_t i = 0; i < ctx->count; i++) {
+        const encode_item_t *item = &ctx->items[i];
+        ctx->bytes += gps_encode(&item->data, item->type, item->data.talker, ctx->out, sizeof(ctx->out));
+    }
+}
+
+static int finish_ref(char *out, int len, size_t size)
+{
+    uint8_t checksum = 0;
+    for (int i = 1; i < len; i++) {
+        checksum ^= (uint8_t)out[i];
+    }
+    return len + snprintf(out + len, size - len, "*%02X\r\n", checksum);
+}
+
+static int coordinate_ref(char *out, size_t size, int32_t e7, int degree_digits)
+{
+    uint32_t value = e7 < 0 ? -(uint32_t)e7 : (uint32_t)e7;
+    double minutes = (value % 10000000u) * 60 / 1e7;
+    return snprintf(out, size, "%0*u%08.5f", degree_digits, value / 10000000u, minutes);
+}
+
+// The same sentences with snprintf, as an application would write them
+static void run_snprintf(void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    const size_t size = sizeof(ctx->out);
+    char lat[16], lon[16];
+    for (size_t i = 0; i < ctx->count; i++) {
+        const gps_t *d = &ctx->items[i].data;
+        char *out = ctx->out;
+        int len = 0;
+        unsigned t = d->time_ms;
+        switch (ctx->items[i].type) {
+            case GPS_SENTENCE_GGA:
+                coordinate_ref(lat, sizeof(lat), d->latitude_e7, 2);
+                coordinate_ref(lon, sizeof(lon), d->longitude_e7, 3);
+                len = snprintf(out, size, "$GPGGA,%02u%02u%02u.%02u,%s,%c,%s,%c,%d,%02u,%.2f,%.1f,M,%.1f,M,,",
+                               t / 3600000, t / 60000 % 60, t / 1000 % 60, t % 1000 / 10, lat,
+                               d->latitude_e7 < 0 ? 'S' : 'N', lon, d->longitude_e7 < 0 ? 'W' : 'E', d->fix,
+                               d->sats_in_use, d->dop_h, d->altitude, d->geoid_height);
+                break;
+            case GPS_SENTENCE_GSA:
+                len = snprintf(out, size, "$GPGSA,%c,%d,,,,,,,,,,,,,%.2f,%.2f,%.2f", d->mode ? d->mode : 'A',
+                               d->fix_mode, d->dop_p, d->dop_h, d->dop_v);
+                break;
+            case GPS_SENTENCE_RMC:
+                coordinate_ref(lat, sizeof(lat), d->latitude_e7, 2);
+                coordinate_ref(lon, sizeof(lon), d->longitude_e7, 3);
+                len = snprintf(out, size, "$GPRMC,%02u%02u%02u.%02u,%c,%s,%c,%s,%c,%.3f,%.2f,%02u%02u%02u,,,%c",
+                               t / 3600000, t / 60000 % 60, t / 1000 % 60, t % 1000 / 10, d->valid ? 'A' : 'V', lat,
+                               d->latitude_e7 < 0 ? 'S' : 'N', lon, d->longitude_e7 < 0 ? 'W' : 'E', d->speed, d->cog,
+                               d->date.day, d->date.month, d->date.year % 100, d->valid ? 'A' : 'N');
+                break;
+            case GPS_SENTENCE_VTG:
+                len = snprintf(out, size, "$GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,%c", d->cog, d->speed, d->speed * 1.852f,
+                               d->valid ? 'A' : 'N');
+                break;
+            default:
+                break;
+        }
+        ctx->bytes += finish_ref(out, len, size);
+    }
+}
+
+static void run_gen(void *arg)
+{
+    gen_ctx_t *ctx = arg;
+    for (int e = 0; e < RUN_EPOCHS; e++) {
+        ctx->bytes += gps_gen_epoch(&ctx->gen, ctx->out, sizeof(ctx->out));
+    }
+}
+
+void bench_gen(const corpus_t *corpora, size_t count)
+{
+    static encode_ctx_t encode;
+    static gen_ctx_t gen;
+    gps_gen_config_t config;
+
+    for (size_t c = 0; c < count; c++) {
+        check_corpus(&corpora[c], strcmp(corpora[c].name, "drive.nmea") == 0 ? &encode : NULL);
+    }
+
+    // Weaving eastwards across the antimeridian south of the equator, 10 Hz with 4 constellations
+    gps_gen_default_config(&config);
+    config.rate_hz = 10;
+    config.talker = GPS_TALKER_GN;
+    config.constellations = 4;
+    config.sats = 4;
+    config.lat_e7 = -339000000;
+    config.lon_e7 = 1799800000;
+    config.course = 90.0f;
+    config.speed_mps = 30.0f;
+    config.turn_dps = 3.0f;
+    config.weave_s = 20.0f;
+    config.seed = 7;
+    check_stream("10 Hz GN", &config);
+    config.gsv_every = 10;
+    config.corrupt_permille = 20;
+    config.truncate_permille = 10;
+    check_stream("10 Hz GN damaged", &config);
+
+    if (encode.count) {
+        double ns = measure(run_encode, &encode, encode.count);
+        report("gen", "encode", encode.count, ns, count_allocs(run_encode, &encode, encode.count));
+        double ref = measure(run_snprintf, &encode, encode.count);
+        report("gen", "snprintf", encode.count, ref, count_allocs(run_snprintf, &encode, encode.count));
+        note("gen: encoding is %.1fx faster than snprintf", ref / ns);
+    }
+
+    gps_gen_default_config(&config);
+    config.rate_hz = 10;
+    config.talker = GPS_TALKER_GN;
+    config.constellations = 4;
+    config.sats = 4;
+    gps_gen_init(&gen.gen, &config);
+    run_gen(&gen);
+    size_t sentences = gen.gen.stats.sentences;
+    double ns = measure(run_gen, &gen, sentences);
+    report("gen", "generate", sentences, ns, count_allocs(run_gen, &gen, sentences));
+    note("gen: %.0f MB/s of NMEA, %.1f bytes per sentence", gen.bytes / (double)gen.gen.stats.sentences * 1e3 / ns,
+         gen.bytes / (double)gen.gen.stats.sentences);
+    free(encode.items);
+}
@@ -0,0 +1,242 @@
+/* Loss under UART overflows. Each corpus is replayed with runs of bytes removed
+ * at random offsets, as a FIFO overflow loses them, through a model of the UART
+ * driver and task: an interrupt moves a block of received bytes into the ring
+ * buffer and queues a data event, an overflow queues its own event, and the
+ * task handles the events in order while the next interrupt may land during
+ * any of its reads. Every sentence the gaps left intact must be recovered.
+ * For comparison the same overflows are replayed the way the UART task used
+ * to handle them, draining the ring buffer before marking the gap, and by
+ * also flushing it. */
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_stream.h"
+
+#define OVERFLOWS (50)
+#define FIFO_SIZE (128)
+#define RING_SIZE (2048)
+#define IRQ_BLOCK (120)  /*!< RX FIFO full threshold, bytes per interrupt */
+#define READ_SIZE (1024) /*!< RD_BUF_SIZE of the task */
+
+typedef struct {
+    size_t start; /*!< First byte lost */
+    size_t end;   /*!< First byte received again */
+} gap_t;
+
+static int compare_gaps(const void *a, const void *b)
+{
+    const gap_t *x = a, *y = b;
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+// Sentences whose bytes do not overlap any gap and that frame on their own
+static size_t intact_sentences(const corpus_t *corpus, const gap_t *gaps, size_t count)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    size_t intact = 0;
+
+    for (size_t i = 0; i < corpus->count; i++) {
+        const line_t *line = &corpus->lines[i];
+        size_t start = line->ptr - corpus->data;
+        size_t end = start + line->len;
+        bool hit = false;
+        for (size_t g = 0; g < count && !hit; g++) {
+            hit = gaps[g].start < end && gaps[g].end > start;
+        }
+        if (hit) {
+            continue;
+        }
+        gps_parser_init(&parser);
+        gps_stream_init(&stream, &parser, NULL, NULL);
+        gps_stream_feed(&stream, (const uint8_t *)line->ptr, line->len);
+        intact += stream.sentences;
+    }
+    return intact;
+}
+
+// Replays the corpus without the gaps, returns the sentences decoded
+static size_t replay(const corpus_t *corpus, const gap_t *gaps, size_t count, gps_stream_t *stream)
+{
+    static gps_parser_t parser;
+    const uint8_t *data = (const uint8_t *)corpus->data;
+    size_t pos = 0;
+
+    gps_parser_init(&parser);
+    gps_stream_init(stream, &parser, NULL, NULL);
+    for (size_t g = 0; g < count; g++) {
+        if (gaps[g].start > pos) {
+            gps_stream_feed(stream, data + pos, gaps[g].start - pos);
+        }
+        gps_stream_mark_gap(stream);
+        if (gaps[g].end > pos) {
+            pos = gaps[g].end;
+        }
+    }
+    gps_stream_feed(stream, data + pos, corpus->size - pos);
+    return stream->sentences;
+}
+
+typedef enum {
+    ORDER_SNAPSHOT, /*!< Feeds what was buffered at the overflow event, marks the gap, then the rest */
+    ORDER_DRAIN,    /*!< Feeds until the ring buffer is empty, then marks the gap */
+} gap_order_t;
+
+typedef struct {
+    const corpus_t *corpus;
+    const gap_t *gaps;
+    size_t count;
+    size_t next_gap;
+    size_t pos;          /*!< Next byte of the corpus to arrive */
+    bool overflow;       /*!< The byte at pos comes after a lost run */
+    uint8_t *ring;       /*!< Bytes received so far, read from head to tail */
+    size_t head;
+    size_t tail;
+    uint8_t events[256]; /*!< true for an overflow, false for data */
+    uint8_t first;
+    uint8_t last;
+    bool irq_pending;    /*!< One interrupt may land during the current event */
+    gps_stream_t *stream;
+} uart_model_t;
+
+// One interrupt: the next block up to the next gap arrives, or the gap itself
+static void model_irq(uart_model_t *m)
+{
+    size_t size = m->corpus->size;
+    if (m->pos >= size) {
+        return;
+    }
+    if (m->overflow) {
+        m->overflow = false;
+        m->events[m->last++] = true;
+        return;
+    }
+    size_t end = m->pos + IRQ_BLOCK < size ? m->pos + IRQ_BLOCK : size;
+    const gap_t *gap = m->next_gap < m->count ? &m->gaps[m->next_gap] : NULL;
+    if (gap && gap->start < end) {
+        end = gap->start;
+    }
+    memcpy(m->ring + m->tail, m->corpus->data + m->pos, end - m->pos);
+    m->tail += end - m->pos;
+    m->pos = end;
+    // Gaps may overlap after sorting, the next byte is the first one past all of them
+    while (m->next_gap < m->count && m->gaps[m->next_gap].start <= m->pos) {
+        if (m->gaps[m->next_gap].end > m->pos) {
+            m->pos = m->gaps[m->next_gap].end;
+        }
+        m->overflow = true;
+        m->next_gap++;
+    }
+    if (m->tail > m->head || m->pos >= size) {
+        m->events[m->last++] = false;
+    }
+}
+
+// uart_read_bytes() of up to len bytes, the next interrupt lands in the first read of an event
+static size_t model_read(uart_model_t *m, size_t len)
+{
+    if (m->irq_pending) {
+        m->irq_pending = false;
+        model_irq(m);
+    }
+    size_t n = m->tail - m->head;
+    n = n < len ? n : len;
+    n = n < READ_SIZE ? n : READ_SIZE;
+    gps_stream_feed(m->stream, m->ring + m->head, n);
+    m->head += n;
+    return n;
+}
+
+static void model_drain(uart_model_t *m)
+{
+    while (model_read(m, SIZE_MAX) > 0) {
+    }
+}
+
+// Replays the corpus through the driver model, returns the sentences decoded
+static size_t replay_task(const corpus_t *corpus, const gap_t *gaps, size_t count, gap_order_t order)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    static uart_model_t m;
+
+    memset(&m, 0, sizeof(m));
+    m.corpus = corpus;
+    m.gaps = gaps;
+    m.count = count;
+    m.stream = &stream;
+    m.ring = malloc(corpus->size);
+    gps_parser_init(&parser);
+    gps_stream_init(&stream, &parser, NULL, NULL);
+    while (m.pos < corpus->size || m.first != m.last) {
+        model_irq(&m);
+        while (m.first != m.last) {
+            bool overflow = m.events[m.first++];
+            m.irq_pending = true;
+            if (!overflow) {
+                model_drain(&m);
+            } else if (order == ORDER_SNAPSHOT) {
+                for (size_t buffered = m.tail - m.head; buffered > 0;) {
+                    size_t n = model_read(&m, buffered);
+                    if (n == 0) {
+                        break;
+                    }
+                    buffered -= n;
+                }
+                gps_stream_mark_gap(&stream);
+                model_drain(&m);
+            } else {
+                model_drain(&m);
+                gps_stream_mark_gap(&stream);
+            }
+        }
+    }
+    free(m.ring);
+    return stream.sentences;
+}
+
+void bench_overflow(const corpus_t *corpora, size_t count)
+{
+    static gps_stream_t stream;
+    gap_t gaps[OVERFLOWS], flushed[OVERFLOWS];
+
+    for (size_t c = 0; c < count; c++) {
+        const corpus_t *corpus = &corpora[c];
+        if (corpus->size < 2 * RING_SIZE) {
+            continue;
+        }
+
+        uint32_t seed = 12345;
+        for (size_t g = 0; g < OVERFLOWS; g++) {
+            gaps[g].start = RING_SIZE + bench_rng(&seed) % (corpus->size - RING_SIZE - FIFO_SIZE);
+            gaps[g].end = gaps[g].start + 1 + bench_rng(&seed) % FIFO_SIZE;
+        }
+        qsort(gaps, OVERFLOWS, sizeof(gap_t), compare_gaps);
+        // Flushing also discards whatever the ring buffer held, up to its size
+        for (size_t g = 0; g < OVERFLOWS; g++) {
+            flushed[g].start = gaps[g].start - bench_rng(&seed) % RING_SIZE;
+            flushed[g].end = gaps[g].end;
+        }
+
+        qsort(flushed, OVERFLOWS, sizeof(gap_t), compare_gaps);
+
+        size_t intact = intact_sentences(corpus, gaps, OVERFLOWS);
+        size_t exact = replay(corpus, gaps, OVERFLOWS, &stream);
+        uint32_t dropped_bytes = stream.dropped_bytes;
+        size_t recovered = replay_task(corpus, gaps, OVERFLOWS, ORDER_SNAPSHOT);
+        size_t drained = replay_task(corpus, gaps, OVERFLOWS, ORDER_DRAIN);
+        size_t after_flush = replay(corpus, flushed, OVERFLOWS, &stream);
+        note("%s: %d overflows, %zu intact sentences, resync recovered %zu (%.1f%%), %u bytes dropped, "
+             "draining first %zu (%.1f%%), flushing %zu (%.1f%%)",
+             corpus->name, OVERFLOWS, intact, recovered, intact ? 100.0 * recovered / intact : 100.0,
+             (unsigned)dropped_bytes, drained, intact ? 100.0 * drained / intact : 100.0, after_flush,
+             intact ? 100.0 * after_flush / intact : 100.0);
+        if (exact != intact) {
+            fail("%s: resync recovered %zu of %zu intact sentences with the gaps marked in place", corpus->name,
+                 exact, intact);
+        }
+        if (recovered != intact) {
+            fail("%s: the UART task recovered %zu of %zu intact sentences", corpus->name, recovered, intact);
+        }
+    }
+}
@@ -0,0 +1,353 @@
+/* Sentence parsing cost per sentence type, for whole corpora and through the
+ * streaming framer. */
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_stream.h"
+#include "gps_epoch.h"
+
+/* Sentence formatter used to group lines, e.g. "GGA" for "$GPGGA,...". Lines
+ * that are too damaged to tell are grouped as "bad". */
+static void line_type(const line_t *line, char type[4])
+{
+    static const char *known[] = {"GGA", "GSA", "GSV", "RMC", "GLL", "VTG"};
+
+    if (line->len >= 7 && line->ptr[0] == '$' && line->ptr[6] == ',') {
+        for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+            if (memcmp(line->ptr + 3, known[i], 3) == 0) {
+                strcpy(type, known[i]);
+                return;
+            }
+        }
+    }
+    strcpy(type, "bad");
+}
+
+typedef struct {
+    gps_parser_t parser;
+    const line_t *lines;
+    size_t count;
+} parse_ctx_t;
+
+static void run_parse(void *arg)
+{
+    parse_ctx_t *ctx = arg;
+    for (size_t i = 0; i < ctx->count; i++) {
+        gps_parser_parse(&ctx->parser, ctx->lines[i].ptr, ctx->lines[i].len);
+    }
+}
+
+typedef struct {
+    gps_parser_t parser;
+    gps_stream_t stream;
+    const corpus_t *corpus;
+} stream_ctx_t;
+
+static void run_stream(void *arg)
+{
+    stream_ctx_t *ctx = arg;
+    gps_stream_feed(&ctx->stream, (const uint8_t *)ctx->corpus->data, ctx->corpus->size);
+}
+
+typedef struct {
+    gps_parser_t parser;
+    gps_stream_t stream;
+    gps_epoch_t epoch;
+    const corpus_t *corpus;
+} epoch_ctx_t;
+
+static void run_epoch(void *arg)
+{
+    epoch_ctx_t *ctx = arg;
+    gps_stream_feed(&ctx->stream, (const uint8_t *)ctx->corpus->data, ctx->corpus->size);
+    gps_epoch_flush(&ctx->epoch);
+}
+
+/* Epochs only hold what their own sentences sent. The second epoch lost the
+ * fix and has empty position fields, the parser still holds the position of
+ * the first one. */
+static void check_epoch_fields(void)
+{
+    static const char *const sentences[] = {
+        "GPGGA,120000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,120000.00,A,3414.86611,N,07155.58886,E,12.5,87.3,170424,,,A",
+        "GPGGA,120001.00,,,,,0,00,99.99,,,,,,",
+        "GPRMC,120001.00,V,,,,,,,170424,,,N",
+        "GPGGA,120002.00,,,,,0,00,99.99,,,,,,",
+    };
+    static gps_parser_t parser;
+    static gps_epoch_t epoch;
+    fix_list_t list = {0};
+
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, keep_fix, &list);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+        gps_epoch_add(&epoch, &parser.data, 0);
+    }
+    const gps_t *lost = list.count == 2 ? &list.fixes[1].data : NULL;
+    if (lost == NULL || !(list.fixes[0].data.fields & GPS_FIELD_POSITION) ||
+        list.fixes[0].data.latitude_e7 != 342477685) {
+        fail("epoch: %zu epochs, the first without its position", list.count);
+    } else if ((lost->fields & (GPS_FIELD_POSITION | GPS_FIELD_SPEED | GPS_FIELD_COURSE)) || lost->latitude_e7 ||
+               lost->longitude_e7 || lost->speed != 0.0f || lost->cog != 0.0f || lost->altitude != 0.0f ||
+               lost->fix != GPS_FIX_INVALID || lost->valid || lost->date.day != 17) {
+        fail("epoch: epoch without a fix carries %d,%d at %.1f kn from the one before", lost->latitude_e7,
+             lost->longitude_e7, lost->speed);
+    }
+
+    // Fields masked out are not sent either
+    list.count = 0;
+    gps_parser_init(&parser);
+    gps_parser_set_interest(&parser, GPS_SENTENCES_ALL, GPS_FIELD_TIME | GPS_FIELD_FIX);
+    parser.data.latitude_e7 = 1;
+    gps_epoch_init(&epoch, 1000, keep_fix, &list);
+    for (size_t i = 0; i < 3; i++) {
+        parse_body(&parser, sentences[i]);
+        gps_epoch_add(&epoch, &parser.data, 0);
+    }
+    if (list.count != 1 || list.fixes[0].data.fields != (GPS_FIELD_TIME | GPS_FIELD_FIX) ||
+        list.fixes[0].data.latitude_e7 || list.fixes[0].data.fix != GPS_FIX_GPS) {
+        fail("epoch: masked out members published, fields 0x%x", list.count ? list.fixes[0].data.fields : 0);
+    }
+    free(list.fixes);
+}
+
+/* Only a sentence that sent its time keys an epoch. An RMC with an empty time
+ * field joins the open epoch, or is dropped when there is none, instead of
+ * keying one with the parser's time of the sentence before. */
+static void check_epoch_time(void)
+{
+    static const char *const sentences[] = {
+        "GPRMC,,A,3414.86611,N,07155.58886,E,12.5,87.3,170424,,,A",
+        "GPGGA,120000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,,A,3414.86611,N,07155.58886,E,12.5,87.3,170424,,,A",
+        "GPGGA,120001.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+    };
+    static gps_parser_t parser;
+    static gps_epoch_t epoch;
+    fix_list_t list = {0};
+
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, keep_fix, &list);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+        gps_epoch_add(&epoch, &parser.data, 0);
+    }
+    gps_epoch_flush(&epoch);
+    const gps_epoch_fix_t *first = list.count == 2 ? &list.fixes[0] : NULL;
+    if (first == NULL || first->data.time_ms != 43200000 || list.fixes[1].data.time_ms != 43201000) {
+        fail("epoch: %zu epochs from 2 timed sentences and 2 RMC without a time", list.count);
+    } else if (!(first->sentences & GPS_SENTENCE_BIT(GPS_SENTENCE_RMC)) || first->data.speed != 12.5f ||
+               (list.fixes[1].sentences & GPS_SENTENCE_BIT(GPS_SENTENCE_RMC))) {
+        fail("epoch: RMC without a time not merged into the epoch it arrived in");
+    }
+    free(list.fixes);
+}
+
+/* Sentence types outside the interest mask are dropped with
+ * GPS_SENTENCE_IGNORED and leave gps_t as it was, apart from status. Members
+ * outside the field mask keep the values they held before. */
+static void check_interest(void)
+{
+    static const char *const sentences[] = {
+        "GPGGA,120000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,120000.00,A,3414.86611,N,07155.58886,E,12.5,87.3,170424,,,A",
+        "GPGSA,A,3,04,05,09,12,24,,,,,,,,2.5,1.36,2.1",
+        "GPGSV,1,1,02,04,45,090,40,05,12,270,35",
+        "GPVTG,87.3,T,,M,12.5,N,23.2,K,A",
+        "GPGLL,3414.86611,N,07155.58886,E,120000.00,A,A",
+    };
+    static gps_parser_t parser;
+    static gps_t before;
+
+    // Only GGA and RMC: every other type is ignored
+    gps_parser_init(&parser);
+    gps_parser_set_interest(&parser, GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC),
+                            GPS_FIELDS_ALL);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        before = parser.data;
+        gps_status_t status = parse_body(&parser, sentences[i]);
+        bool wanted = i < 2;
+        if (wanted ? status != GPS_OKAY : status != GPS_SENTENCE_IGNORED) {
+            fail("interest: %.5s returned status %d", sentences[i], status);
+        }
+        before.status = GPS_SENTENCE_IGNORED;
+        if (!wanted && memcmp(&before, &parser.data, sizeof(before)) != 0) {
+            fail("interest: ignored %.5s changed gps_t", sentences[i]);
+        }
+    }
+
+    // Every type, but only the time and the fix: the other members keep their sentinels
+    gps_parser_init(&parser);
+    gps_parser_set_interest(&parser, GPS_SENTENCES_ALL, GPS_FIELD_TIME | GPS_FIELD_FIX);
+    gps_t *data = &parser.data;
+    data->latitude_e7 = data->longitude_e7 = 7;
+    data->altitude = data->geoid_height = data->speed = data->speedkmh = data->cog = 7.0f;
+    data->dop_h = data->dop_p = data->dop_v = 7.0f;
+    data->sats_in_use = data->sats_in_view = 7;
+    data->date.day = 7;
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+    }
+    if (data->time_ms != 43200000 || data->fix != GPS_FIX_GPS || data->latitude_e7 != 7 || data->longitude_e7 != 7 ||
+        data->altitude != 7.0f || data->geoid_height != 7.0f || data->speed != 7.0f || data->speedkmh != 7.0f ||
+        data->cog != 7.0f || data->dop_h != 7.0f || data->dop_p != 7.0f || data->dop_v != 7.0f ||
+        data->sats_in_use != 7 || data->sats_in_view != 7 || data->date.day != 7 || data->date.year != 0) {
+        fail("interest: masked out members changed, %d,%d alt %.1f %.1f kn, %u in use, %u in view, day %u",
+             data->latitude_e7, data->longitude_e7, data->altitude, data->speed, data->sats_in_use,
+             data->sats_in_view, data->date.day);
+    }
+}
+
+/* A GSV group with a message missing, out of order, or mixing talkers or
+ * totals is dropped whole: the table committed by the last complete group
+ * stays as it was. */
+static void check_gsv_groups(void)
+{
+    static const char *const complete[] = {
+        "GPGSV,2,1,05,04,45,090,40,05,12,270,35,09,60,180,42,12,05,010,20",
+        "GPGSV,2,2,05,24,30,300,38",
+    };
+    static const struct {
+        const char *name;
+        const char *sentences[3];
+    } broken[] = {
+        {"missing message", {"GPGSV,3,1,09,01,10,010,10,02,10,020,10,03,10,030,10",
+                             "GPGSV,3,3,09,07,10,070,10"}},
+        {"last message alone", {"GPGSV,2,2,05,24,30,300,38"}},
+        {"reversed", {"GPGSV,2,2,05,24,30,300,38", "GPGSV,2,1,05,01,10,010,10,02,10,020,10,03,10,030,10,06,10,060,10"}},
+        {"total changed", {"GPGSV,2,1,05,01,10,010,10,02,10,020,10,03,10,030,10,06,10,060,10",
+                           "GPGSV,3,2,05,24,30,300,38"}},
+        {"talker changed", {"GPGSV,2,1,05,01,10,010,10,02,10,020,10,03,10,030,10,06,10,060,10",
+                            "GLGSV,2,2,05,70,30,300,38"}},
+    };
+    static gps_parser_t parser;
+    static gps_satellite_t table[GPS_MAX_SATELLITES_IN_VIEW];
+
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < sizeof(complete) / sizeof(complete[0]); i++) {
+        parse_body(&parser, complete[i]);
+    }
+    uint8_t count = parser.data.sats_in_view;
+    memcpy(table, parser.data.sats_desc_in_view, sizeof(table));
+    if (count != 5 || table[4].num != 24) {
+        fail("gsv: complete group committed %u satellites", count);
+        return;
+    }
+    for (size_t b = 0; b < sizeof(broken) / sizeof(broken[0]); b++) {
+        for (size_t i = 0; i < 3 && broken[b].sentences[i]; i++) {
+            parse_body(&parser, broken[b].sentences[i]);
+        }
+        if (parser.data.sats_in_view != count ||
+            memcmp(parser.data.sats_desc_in_view, table, count * sizeof(gps_satellite_t)) != 0) {
+            fail("gsv: %s changed the table, %u satellites", broken[b].name, parser.data.sats_in_view);
+        }
+    }
+
+    // The next complete group still replaces the table
+    parse_body(&parser, "GPGSV,1,1,01,31,20,200,30");
+    if (parser.data.sats_in_view != 1 || parser.data.sats_desc_in_view[0].num != 31) {
+        fail("gsv: complete group after broken ones left %u satellites", parser.data.sats_in_view);
+    }
+}
+
+/* The single instance wrappers decode every sentence type without any set up. */
+static void check_legacy(void)
+{
+    gps_t data = gps_parse("$GPGGA,120000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,*7A\r\n");
+    if (data.status != GPS_OKAY || data.sentence != GPS_SENTENCE_GGA || data.time_ms != 43200000 ||
+        data.latitude_e7 != 342477685 || data.fix != GPS_FIX_GPS || data.sats_in_use != 5) {
+        fail("gps_parse: GGA decoded with status %u to %d at %u ms, %u satellites", data.status, data.latitude_e7,
+             data.time_ms, data.sats_in_use);
+    }
+}
+
+static void bench_corpus(const corpus_t *corpus)
+{
+    static parse_ctx_t ctx;
+    line_t *group = malloc(corpus->count * sizeof(line_t));
+    char types[16][4];
+    size_t type_count = 0;
+
+    // One row per sentence type in order of first appearance
+    for (size_t i = 0; i < corpus->count && type_count < 16; i++) {
+        char type[4];
+        size_t t;
+        line_type(&corpus->lines[i], type);
+        for (t = 0; t < type_count && strcmp(types[t], type) != 0; t++) {
+        }
+        if (t == type_count) {
+            strcpy(types[type_count++], type);
+        }
+    }
+
+    for (size_t t = 0; t < type_count; t++) {
+        ctx.count = 0;
+        for (size_t i = 0; i < corpus->count; i++) {
+            char type[4];
+            line_type(&corpus->lines[i], type);
+            if (strcmp(type, types[t]) == 0) {
+                group[ctx.count++] = corpus->lines[i];
+            }
+        }
+        ctx.lines = group;
+        gps_parser_init(&ctx.parser);
+        double allocs = count_allocs(run_parse, &ctx, ctx.count);
+        report_no_alloc(corpus->name, types[t], ctx.count, measure(run_parse, &ctx, ctx.count), allocs);
+    }
+
+    // All sentences in the order they were recorded
+    ctx.lines = corpus->lines;
+    ctx.count = corpus->count;
+    gps_parser_init(&ctx.parser);
+    double allocs = count_allocs(run_parse, &ctx, ctx.count);
+    report_no_alloc(corpus->name, "all", ctx.count, measure(run_parse, &ctx, ctx.count), allocs);
+    if (ctx.parser.data.sats_in_view > 0) {
+        note("%s: %u satellites in view after the replay, table size %d", corpus->name,
+             ctx.parser.data.sats_in_view, GPS_MAX_SATELLITES_IN_VIEW);
+    }
+
+    // The same bytes through the streaming framer
+    static stream_ctx_t sctx;
+    gps_parser_init(&sctx.parser);
+    gps_stream_init(&sctx.stream, &sctx.parser, NULL, NULL);
+    sctx.corpus = corpus;
+    allocs = count_allocs(run_stream, &sctx, corpus->count);
+    report_no_alloc(corpus->name, "stream", corpus->count, measure(run_stream, &sctx, corpus->count), allocs);
+
+    // Stream plus epoch assembly, per published fix rather than per sentence
+    static epoch_ctx_t ectx;
+    gps_parser_init(&ectx.parser);
+    gps_epoch_init(&ectx.epoch, 1000, NULL, NULL);
+    gps_stream_init(&ectx.stream, &ectx.parser, add_to_epoch, &ectx.epoch);
+    ectx.corpus = corpus;
+    run_epoch(&ectx);
+    size_t fixes = ectx.epoch.published;
+    if (fixes > 0) {
+        allocs = count_allocs(run_epoch, &ectx, fixes);
+        report_no_alloc(corpus->name, "epoch", fixes, measure(run_epoch, &ectx, fixes), allocs);
+    }
+
+    // A tracker that only consumes position, time and fix validity
+    ctx.lines = corpus->lines;
+    ctx.count = corpus->count;
+    gps_parser_init(&ctx.parser);
+    gps_parser_set_interest(&ctx.parser, GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC),
+                            GPS_FIELD_POSITION | GPS_FIELD_TIME | GPS_FIELD_FIX);
+    report_no_alloc(corpus->name, "tracker", ctx.count, measure(run_parse, &ctx, ctx.count), count_allocs(run_parse, &ctx, ctx.count));
+
+    free(group);
+}
+
+void bench_parse(const corpus_t *corpora, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        bench_corpus(&corpora[i]);
+    }
+    check_epoch_fields();
+    check_epoch_time();
+    check_interest();
+    check_gsv_groups();
+    check_legacy();
+}
@@ -0,0 +1,149 @@
+/* Field scanning kernel against its byte at a time reference. Every corpus
+ * line and a large number of random buffers full of delimiters, checksum
+ * characters, line ends and bytes above 0x7F must give the same stop, checksum
+ * and field table with both, from any start offset and field count. The cost
+ * is measured per sentence over a replay of each corpus repeated to a few MB,
+ * more than the caches hold, the way a log file replay scans it. */
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_scan.h"
+
+#define RANDOM_BUFFERS (200000)
+#define RANDOM_LENGTH  (100)
+#define REPLAY_BYTES   (8u << 20)
+
+typedef size_t (*scan_fn_t)(const uint8_t *p, size_t i, size_t end, gps_fields_t *fields, uint8_t *checksum);
+
+typedef struct {
+    const line_t *lines;
+    size_t count;
+    scan_fn_t scan;
+    uint32_t sink;
+} scan_ctx_t;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// The way gps_parser_parse() walks a sentence up to its '*'
+static size_t scan_sentence(scan_fn_t scan, const uint8_t *p, size_t len, gps_fields_t *fields, uint8_t *checksum)
+{
+    size_t i = 1;
+    fields->count = 0;
+    fields->start[0] = 1;
+    *checksum = 0;
+    for (;;) {
+        i = scan(p, i, len, fields, checksum);
+        if (i == len || p[i] == '*' || p[i] == ',') {
+            return i;
+        }
+        *checksum ^= p[i++];
+    }
+}
+
+static void run_scan(void *arg)
+{
+    scan_ctx_t *ctx = arg;
+    gps_fields_t fields;
+    uint8_t checksum;
+    for (size_t i = 0; i < ctx->count; i++) {
+        const line_t *line = &ctx->lines[i];
+        ctx->sink += scan_sentence(ctx->scan, (const uint8_t *)line->ptr, line->len, &fields, &checksum) + checksum;
+    }
+}
+
+static bool same_scan(const uint8_t *p, size_t i, size_t end, const gps_fields_t *initial)
+{
+    gps_fields_t a = *initial, b = *initial;
+    uint8_t ca = 0x5A, cb = 0x5A;
+    size_t ra = gps_scan_fields(p, i, end, &a, &ca);
+    size_t rb = gps_scan_fields_scalar(p, i, end, &b, &cb);
+    return ra == rb && ca == cb && a.count == b.count && memcmp(a.start, b.start, a.count + 1) == 0;
+}
+
+static void verify(const corpus_t *corpora, size_t count)
+{
+    static const uint8_t alphabet[] = "0123456789.-ABCDEFGHNSEWMVT,,,,,*$\r\n !\x80\xb5\xff";
+    uint8_t buf[RANDOM_LENGTH];
+    gps_fields_t initial;
+
+    initial.count = 0;
+    initial.start[0] = 1;
+    for (size_t c = 0; c < count; c++) {
+        const corpus_t *corpus = &corpora[c];
+        for (size_t i = 0; i < corpus->count; i++) {
+            const line_t *line = &corpus->lines[i];
+            for (size_t from = 0; from < line->len; from++) {
+                if (!same_scan((const uint8_t *)line->ptr, from, line->len, &initial)) {
+                    fail("scan: %s line %zu from %zu differs from the scalar reference", corpus->name, i + 1, from);
+                    return;
+                }
+            }
+        }
+    }
+    for (size_t n = 0; n < RANDOM_BUFFERS; n++) {
+        size_t len = rng() % RANDOM_LENGTH;
+        // Mostly field bytes with a delimiter now and then, like a sentence
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = rng() % 4 ? alphabet[rng() % 12] : alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+        // Start close to a full field table now and then
+        initial.count = rng() % 3 ? 0 : GPS_MAX_FIELDS - 1 - rng() % 4;
+        for (size_t f = 0; f <= initial.count; f++) {
+            initial.start[f] = f;
+        }
+        size_t from = len ? rng() % len : 0;
+        if (!same_scan(buf, from, len, &initial)) {
+            fail("scan: random buffer %zu of %zu bytes from %zu differs from the scalar reference", n, len, from);
+            return;
+        }
+    }
+}
+
+void bench_scan(const corpus_t *corpora, size_t count)
+{
+    static scan_ctx_t ctx;
+
+    note("scan kernel: %s", gps_scan_kernel());
+    verify(corpora, count);
+
+    for (size_t c = 0; c < count; c++) {
+        const corpus_t *corpus = &corpora[c];
+        if (corpus->count == 0) {
+            continue;
+        }
+        // The corpus repeated in one buffer, so the lines run through memory
+        // like a long recording
+        size_t copies = REPLAY_BYTES / corpus->size + 1;
+        char *replay = malloc(copies * corpus->size);
+        line_t *lines = malloc(copies * corpus->count * sizeof(line_t));
+        for (size_t k = 0; k < copies; k++) {
+            memcpy(replay + k * corpus->size, corpus->data, corpus->size);
+            for (size_t i = 0; i < corpus->count; i++) {
+                lines[k * corpus->count + i].ptr = replay + k * corpus->size + (corpus->lines[i].ptr - corpus->data);
+                lines[k * corpus->count + i].len = corpus->lines[i].len;
+            }
+        }
+        ctx.lines = lines;
+        ctx.count = copies * corpus->count;
+
+        ctx.scan = gps_scan_fields_scalar;
+        double ref = measure(run_scan, &ctx, ctx.count);
+        report(corpus->name, "scan_ref", ctx.count, ref, 0.0);
+        ctx.scan = gps_scan_fields;
+        double allocs = count_allocs(run_scan, &ctx, ctx.count);
+        double ns = measure(run_scan, &ctx, ctx.count);
+        report(corpus->name, "scan", ctx.count, ns, allocs);
+        note("%s: %.0f MB/s with %s, %.0f MB/s byte at a time", corpus->name,
+             corpus->size / (double)corpus->count / ns * 1e3, gps_scan_kernel(),
+             corpus->size / (double)corpus->count / ref * 1e3);
+
+        free(lines);
+        free(replay);
+    }
+}
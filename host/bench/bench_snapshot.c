@@ -0,0 +1,119 @@
+/* Seqlock snapshot cost, and a stress run of one writer against several
+ * reader threads that checks every snapshot a reader accepted for torn
+ * copies. */
+#include <pthread.h>
+#include <stdatomic.h>
+#include "bench.h"
+#include "gps_snapshot.h"
+
+#define READERS (4)
+#define STRESS_NS (300e6)
+
+static gps_snapshot_t snapshot;
+static atomic_bool writer_done;
+
+typedef struct {
+    size_t reads;
+    size_t busy;
+    size_t torn;
+} reader_stats_t;
+
+// Members spread over the whole record all derive from n
+static void fill(gps_epoch_fix_t *fix, uint32_t n)
+{
+    fix->data.tim.thousand = n & 0xFFFF;
+    fix->data.latitude_e7 = (int32_t)n;
+    fix->data.longitude_e7 = -(int32_t)n;
+    fix->data.sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW - 1].num = n & 0xFF;
+    fix->sentences = n;
+}
+
+static bool consistent(const gps_epoch_fix_t *fix)
+{
+    uint32_t n = fix->sentences;
+    return fix->data.tim.thousand == (n & 0xFFFF) && fix->data.latitude_e7 == (int32_t)n &&
+           fix->data.longitude_e7 == -(int32_t)n &&
+           fix->data.sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW - 1].num == (n & 0xFF);
+}
+
+// Publishes as fast as it can for STRESS_NS, returns the number of publishes
+static void *writer(void *arg)
+{
+    static gps_epoch_fix_t fix;
+    uint32_t *publishes = arg;
+    double end = now_ns() + STRESS_NS;
+    uint32_t n = 1;
+    do {
+        fill(&fix, ++n);
+        gps_snapshot_publish(&snapshot, &fix);
+    } while ((n & 0xFF) || now_ns() < end);
+    *publishes = n - 1;
+    atomic_store(&writer_done, true);
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    reader_stats_t *stats = arg;
+    gps_epoch_fix_t fix;
+    while (!atomic_load(&writer_done)) {
+        if (gps_snapshot_read(&snapshot, &fix) == 0) {
+            stats->busy++;
+        } else if (!consistent(&fix)) {
+            stats->torn++;
+        } else {
+            stats->reads++;
+        }
+    }
+    return NULL;
+}
+
+static void run_publish(void *arg)
+{
+    gps_snapshot_publish(&snapshot, arg);
+}
+
+static void run_read(void *arg)
+{
+    gps_snapshot_read(&snapshot, arg);
+}
+
+void bench_snapshot(const corpus_t *corpora, size_t count)
+{
+    static gps_epoch_fix_t fix;
+
+    gps_snapshot_init(&snapshot);
+    fill(&fix, 1);
+    report("snapshot", "publish", 1, measure(run_publish, &fix, 1), count_allocs(run_publish, &fix, 1));
+    report("snapshot", "read", 1, measure(run_read, &fix, 1), count_allocs(run_read, &fix, 1));
+    note("a snapshot copies %zu bytes, gps_t takes %zu, %zu of them fix members", sizeof(gps_epoch_fix_t),
+         sizeof(gps_t), (size_t)GPS_T_HOT_SIZE);
+
+    pthread_t threads[READERS + 1];
+    reader_stats_t stats[READERS] = {0};
+    reader_stats_t total = {0};
+
+    uint32_t publishes = 0;
+
+    gps_snapshot_init(&snapshot);
+    fill(&fix, 1);
+    gps_snapshot_publish(&snapshot, &fix);
+    atomic_store(&writer_done, false);
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&threads[i], NULL, reader, &stats[i]);
+    }
+    pthread_create(&threads[READERS], NULL, writer, &publishes);
+    for (int i = 0; i <= READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < READERS; i++) {
+        total.reads += stats[i].reads;
+        total.busy += stats[i].busy;
+        total.torn += stats[i].torn;
+    }
+    note("%u publishes against %d readers: %zu consistent reads, %zu busy, %zu torn", (unsigned)publishes, READERS,
+         total.reads, total.busy, total.torn);
+    if (total.torn > 0) {
+        fail("snapshot: %zu torn reads", total.torn);
+    }
+}
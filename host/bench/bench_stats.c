@@ -0,0 +1,107 @@
+/* Parser counters. Every corpus is framed by the stream at block sizes of 1
+ * byte to 4 KB and the counters must agree with the stream's own counters and
+ * with each line parsed on its own, whatever the block size. The cost of
+ * recording a sentence is reported per sentence, together with the parse
+ * cost percentiles the histogram collected. */
+#include <string.h>
+#include "bench.h"
+#include "gps_stream.h"
+
+#if CONFIG_GPS_PARSER_STATS
+
+typedef struct {
+    gps_histogram_t hist;
+    uint32_t start;
+} record_ctx_t;
+
+// The work gps_parser_finish() adds per decoded sentence
+static void run_record(void *arg)
+{
+    record_ctx_t *ctx = arg;
+    for (int i = 0; i < 1000; i++) {
+        ctx->start = gps_cycles();
+        gps_histogram_add(&ctx->hist, gps_cycles() - ctx->start);
+    }
+}
+
+static void check_percentiles(void)
+{
+    gps_histogram_t hist = {0};
+    for (uint32_t v = 0; v < 1000; v++) {
+        gps_histogram_add(&hist, v);
+    }
+    // 500 values are below 512, the 50th percentile is in the bucket [256, 512)
+    if (gps_histogram_percentile(&hist, 50) != 511 || gps_histogram_percentile(&hist, 100) != 999 ||
+        gps_histogram_percentile(&hist, 0) != 0 || hist.count != 1000 || hist.sum != 999 * 1000 / 2) {
+        fail("stats: histogram percentiles p50 %u p100 %u", gps_histogram_percentile(&hist, 50),
+             gps_histogram_percentile(&hist, 100));
+    }
+}
+
+static void bench_corpus(const corpus_t *corpus)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    uint32_t expected[GPS_SENTENCE_MAX] = {0};
+
+    // Each line on its own
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < corpus->count; i++) {
+        gps_status_t status = gps_parser_parse(&parser, corpus->lines[i].ptr, corpus->lines[i].len);
+        if (status == GPS_OKAY) {
+            expected[parser.data.sentence]++;
+        }
+    }
+    if (memcmp(expected, parser.stats.sentences, sizeof(expected)) != 0) {
+        fail("%s: sentence counters differ from the decoded sentences", corpus->name);
+    }
+
+    static const size_t chunks[] = {1, 7, 120, 4096};
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        gps_parser_init(&parser);
+        gps_stream_init(&stream, &parser, NULL, NULL);
+        feed_blocks(&stream, corpus->data, corpus->size, chunks[c]);
+        const gps_parser_stats_t *stats = &parser.stats;
+        uint32_t outcomes = 0;
+        for (int s = 0; s < GPS_STATUS_MAX; s++) {
+            outcomes += stats->status[s];
+        }
+        if (memcmp(expected, stats->sentences, sizeof(expected)) != 0 ||
+            stats->parse_cycles.count != stats->status[GPS_OKAY] || stats->status[GPS_CRC_ERROR] != stream.crc_errors ||
+            stats->status[GPS_INV_SENTENCE] != stream.framing_errors ||
+            outcomes != stream.sentences + stream.crc_errors + stream.framing_errors) {
+            fail("%s: counters in blocks of %zu disagree with the stream: %u outcomes for %u frames, "
+                 "%u of %u checksum and %u of %u framing errors",
+                 corpus->name, chunks[c], outcomes, stream.sentences + stream.crc_errors + stream.framing_errors,
+                 stats->status[GPS_CRC_ERROR], stream.crc_errors, stats->status[GPS_INV_SENTENCE],
+                 stream.framing_errors);
+        }
+        if (chunks[c] == 4096) {
+            const gps_histogram_t *hist = &stats->parse_cycles;
+            note("%s: parse cycles per sentence p50 %u p90 %u p99 %u max %u", corpus->name,
+                 gps_histogram_percentile(hist, 50), gps_histogram_percentile(hist, 90),
+                 gps_histogram_percentile(hist, 99), hist->max);
+        }
+    }
+}
+
+void bench_stats(const corpus_t *corpora, size_t count)
+{
+    static record_ctx_t ctx;
+
+    check_percentiles();
+    for (size_t c = 0; c < count; c++) {
+        bench_corpus(&corpora[c]);
+    }
+    double allocs = count_allocs(run_record, &ctx, 1000);
+    report("stats", "record", 1000, measure(run_record, &ctx, 1000), allocs);
+}
+
+#else
+
+void bench_stats(const corpus_t *corpora, size_t count)
+{
+    note("stats: built without CONFIG_GPS_PARSER_STATS");
+}
+
+#endif
@@ -0,0 +1,208 @@
+/* UTC time decoding. The time and date of every GGA and RMC of a corpus must
+ * decode to the same milliseconds as the C library computes from the text,
+ * utc_ms must keep growing across midnight before the RMC with the new date
+ * arrives and return to the date's day when the time only jumped back, and
+ * gps_local_time() must agree with gmtime() for any offset. The cost of
+ * converting a timestamp to local time is reported per call. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+typedef struct {
+    int64_t utc_ms[1024];
+    gps_date_t date;
+    gps_time_t tim;
+} local_ctx_t;
+
+// Milliseconds of the day of "hhmmss.sss", digits past the ms are dropped like the parser does
+static uint32_t reference_time(const char *field)
+{
+    unsigned h, m;
+    if (sscanf(field, "%2u%2u", &h, &m) != 2) {
+        return 0;
+    }
+    double seconds = strtod(field + 4, NULL);
+    return (h * 3600 + m * 60) * 1000 + (uint32_t)(seconds * 1000.0 + 1e-6);
+}
+
+static int64_t reference_utc(const char *date, uint32_t time_ms)
+{
+    struct tm tm = {0};
+    if (sscanf(date, "%2d%2d%2d", &tm.tm_mday, &tm.tm_mon, &tm.tm_year) != 3) {
+        return -1;
+    }
+    tm.tm_mon -= 1;
+    tm.tm_year += 100;
+    return (int64_t)timegm(&tm) * 1000 + time_ms;
+}
+
+// Field i of a sentence, copied and null terminated
+static void field(const line_t *line, int index, char *out, size_t size)
+{
+    const char *p = line->ptr, *end = line->ptr + line->len;
+    for (int i = 0; i < index && p < end; p++) {
+        i += *p == ',';
+    }
+    size_t n = 0;
+    while (p < end && *p != ',' && *p != '*' && n + 1 < size) {
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+}
+
+static void check_corpus(const corpus_t *corpus)
+{
+    static gps_parser_t parser;
+    size_t checked = 0;
+
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < corpus->count; i++) {
+        const line_t *line = &corpus->lines[i];
+        if (gps_parser_parse(&parser, line->ptr, line->len) != GPS_OKAY ||
+            (parser.data.sentence != GPS_SENTENCE_GGA && parser.data.sentence != GPS_SENTENCE_RMC)) {
+            continue;
+        }
+        char time[16], date[16];
+        field(line, 1, time, sizeof(time));
+        if (time[0] == '\0') {
+            continue;
+        }
+        uint32_t ms = reference_time(time);
+        if (parser.data.time_ms != ms || parser.data.tim.thousand != ms % 1000 ||
+            parser.data.tim.hour != ms / 3600000 || parser.data.tim.minute != ms / 60000 % 60) {
+            fail("%s: line %zu: time %s decoded as %u ms, expected %u", corpus->name, i + 1, time,
+                 parser.data.time_ms, ms);
+            return;
+        }
+        field(line, 9, date, sizeof(date));
+        if (parser.data.sentence == GPS_SENTENCE_RMC && strlen(date) == 6 &&
+            parser.data.utc_ms != reference_utc(date, ms)) {
+            fail("%s: line %zu: %s %s decoded as %lld ms since 1970, expected %lld", corpus->name, i + 1, date, time,
+                 (long long)parser.data.utc_ms, (long long)reference_utc(date, ms));
+            return;
+        }
+        checked++;
+    }
+    note("%s: %zu timestamps match the C library", corpus->name, checked);
+}
+
+// GGA comes first in every epoch, the first GGA after midnight still has yesterday's date
+static void check_midnight(void)
+{
+    static const char *const sentences[] = {
+        "GPRMC,235959.00,A,3414.86611,N,07155.58886,E,0.1,0.0,311223,,,A",
+        "GPGGA,235959.50,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,235959.50,A,3414.86611,N,07155.58886,E,0.1,0.0,311223,,,A",
+        "GPGGA,000000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,000000.00,A,3414.86611,N,07155.58886,E,0.1,0.0,010124,,,A",
+        "GPGGA,000000.50,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+    };
+    static const int32_t offsets_ms[] = {-1000, -500, -500, 0, 0, 500};
+    static const int64_t midnight_ms = (int64_t)1704067200 * 1000; // 2024-01-01T00:00:00Z
+    static gps_parser_t parser;
+
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+        int64_t expected = midnight_ms + offsets_ms[i];
+        if (parser.data.utc_ms != expected) {
+            fail("time: sentence %zu around midnight: utc_ms %lld, expected %lld", i + 1,
+                 (long long)parser.data.utc_ms, (long long)expected);
+        }
+    }
+    // 2024 is a leap year
+    parse_body(&parser, "GPRMC,120000.00,A,3414.86611,N,07155.58886,E,0.1,0.0,290224,,,A");
+    if (parser.data.utc_ms != (int64_t)1709208000 * 1000) {
+        fail("time: 29 February 2024 decoded as %lld", (long long)parser.data.utc_ms);
+    }
+}
+
+/* A time more than 12 h earlier is taken for midnight until a date says
+ * otherwise, e.g. after the receiver restarted its clock. */
+static void check_time_back(void)
+{
+    static const char *const sentences[] = {
+        "GPRMC,230000.00,A,3414.86611,N,07155.58886,E,0.1,0.0,170424,,,A",
+        "GPGGA,100000.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+        "GPRMC,100000.00,A,3414.86611,N,07155.58886,E,0.1,0.0,170424,,,A",
+        "GPGGA,100001.00,3414.86611,N,07155.58886,E,1,05,1.36,353.9,M,-40.6,M,,",
+    };
+    static const int64_t day_ms = (int64_t)1713312000 * 1000; // 2024-04-17T00:00:00Z
+    static const int64_t expected[] = {
+        day_ms + 23 * 3600000, day_ms + 34 * 3600000, day_ms + 10 * 3600000, day_ms + 10 * 3600000 + 1000,
+    };
+    static gps_parser_t parser;
+
+    gps_parser_init(&parser);
+    for (size_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        parse_body(&parser, sentences[i]);
+        if (parser.data.utc_ms != expected[i]) {
+            fail("time: sentence %zu after the time went back: utc_ms %lld, expected %lld", i + 1,
+                 (long long)parser.data.utc_ms, (long long)expected[i]);
+        }
+    }
+}
+
+static void check_local(void)
+{
+    static const int16_t offsets[] = {-720, -210, 0, 300, 330, 345, 840};
+    uint32_t seed = 12345;
+
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        // 1970 to 2106, in ms
+        int64_t utc_ms = (int64_t)seed * 1000 + seed % 1000;
+        int16_t offset = offsets[i % (sizeof(offsets) / sizeof(offsets[0]))];
+        gps_date_t date;
+        gps_time_t tim;
+        struct tm tm;
+
+        gps_set_utc_offset(offset);
+        gps_local_time(utc_ms, &date, &tim);
+        time_t local = (time_t)(utc_ms / 1000) + offset * 60;
+        gmtime_r(&local, &tm);
+        if (date.year != tm.tm_year + 1900 || date.month != tm.tm_mon + 1 || date.day != tm.tm_mday ||
+            tim.hour != tm.tm_hour || tim.minute != tm.tm_min || (int)tim.second != tm.tm_sec ||
+            tim.thousand != utc_ms % 1000) {
+            fail("time: local time of %lld at %+d min is %04u-%02u-%02u %02u:%02u:%06.3f", (long long)utc_ms, offset,
+                 date.year, date.month, date.day, tim.hour, tim.minute, tim.second);
+            break;
+        }
+        gps_date_t back = date;
+        if (gps_days_from_civil(&back) != (int32_t)((utc_ms / 1000 + offset * 60) / 86400)) {
+            fail("time: day number of %04u-%02u-%02u", date.year, date.month, date.day);
+            break;
+        }
+    }
+    gps_set_utc_offset(CONFIG_GPS_PARSER_UTC_OFFSET);
+}
+
+static void run_local(void *arg)
+{
+    local_ctx_t *ctx = arg;
+    for (size_t i = 0; i < sizeof(ctx->utc_ms) / sizeof(ctx->utc_ms[0]); i++) {
+        gps_local_time(ctx->utc_ms[i], &ctx->date, &ctx->tim);
+    }
+}
+
+void bench_time(const corpus_t *corpora, size_t count)
+{
+    static local_ctx_t ctx;
+    size_t n = sizeof(ctx.utc_ms) / sizeof(ctx.utc_ms[0]);
+
+    for (size_t c = 0; c < count; c++) {
+        check_corpus(&corpora[c]);
+    }
+    check_midnight();
+    check_time_back();
+    check_local();
+
+    // A timestamp every 997 s from 2024-04-17
+    for (size_t i = 0; i < n; i++) {
+        ctx.utc_ms[i] = (int64_t)(1713312000 + i * 997) * 1000;
+    }
+    report("time", "local", n, measure(run_local, &ctx, n), count_allocs(run_local, &ctx, n));
+}
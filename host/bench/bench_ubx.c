@@ -0,0 +1,257 @@
+/* UBX NAV-PVT next to NMEA. Every epoch of a corpus is re-encoded as the
+ * NAV-PVT frame a u-blox receiver would send for it. The frames must decode to
+ * the same position, date and time as the NMEA sentences did, and a stream
+ * that interleaves both protocols, plus a long UBX message the framer skips
+ * and a frame with a broken checksum, must frame the same way at any block
+ * size. A NAV-PVT whose date or time is not flagged valid, or out of range,
+ * must leave them unset. The cost per fix of NAV-PVT is reported next to the
+ * NMEA "epoch" row. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "gps_epoch.h"
+#include "gps_stream.h"
+#include "gps_ubx.h"
+
+#define NAV_PVT_FRAME (GPS_UBX_HEADER_LENGTH + GPS_UBX_NAV_PVT_LENGTH + 2)
+#define LONG_PAYLOAD (600) /*!< Longer than the stream stores, like NAV-SAT */
+
+typedef struct {
+    gps_parser_t parser;
+    gps_stream_t stream;
+    gps_epoch_t epoch;
+    const uint8_t *data;
+    size_t size;
+    size_t chunk;
+    uint32_t pvt;
+} ubx_ctx_t;
+
+static void put_u2(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u4(uint8_t *p, uint32_t v)
+{
+    put_u2(p, v);
+    put_u2(p + 2, v >> 16);
+}
+
+// Complete frame with sync characters and checksum, returns its length
+static size_t ubx_frame(uint8_t *out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t a = 0, b = 0;
+    out[0] = GPS_UBX_SYNC1;
+    out[1] = GPS_UBX_SYNC2;
+    out[2] = cls;
+    out[3] = id;
+    put_u2(out + 4, len);
+    memcpy(out + GPS_UBX_HEADER_LENGTH, payload, len);
+    for (size_t i = 2; i < GPS_UBX_HEADER_LENGTH + (size_t)len; i++) {
+        a += out[i];
+        b += a;
+    }
+    out[GPS_UBX_HEADER_LENGTH + len] = a;
+    out[GPS_UBX_HEADER_LENGTH + len + 1] = b;
+    return GPS_UBX_HEADER_LENGTH + len + 2;
+}
+
+// The NAV-PVT frame of an epoch, the reverse of the component's decoder
+static size_t encode_pvt(uint8_t *out, const gps_t *fix)
+{
+    uint8_t pvt[GPS_UBX_NAV_PVT_LENGTH] = {0};
+    uint32_t ms = fix->time_ms;
+
+    put_u2(pvt + 4, fix->date.year);
+    pvt[6] = fix->date.month;
+    pvt[7] = fix->date.day;
+    pvt[8] = ms / 3600000;
+    pvt[9] = ms / 60000 % 60;
+    pvt[10] = ms / 1000 % 60;
+    pvt[11] = GPS_UBX_PVT_VALID_TIME | (fix->date.year != 0 ? GPS_UBX_PVT_VALID_DATE : 0);
+    put_u4(pvt + 16, ms % 1000 * 1000000);
+    pvt[20] = fix->fix_mode == GPS_MODE_2D ? 2 : 3;
+    pvt[21] = 0x01;
+    pvt[23] = fix->sats_in_use;
+    put_u4(pvt + 24, (uint32_t)fix->longitude_e7);
+    put_u4(pvt + 28, (uint32_t)fix->latitude_e7);
+    put_u4(pvt + 32, (uint32_t)lroundf((fix->altitude + fix->geoid_height) * 1000.0f));
+    put_u4(pvt + 36, (uint32_t)lroundf(fix->altitude * 1000.0f));
+    put_u4(pvt + 60, (uint32_t)lroundf(fix->speed * (1852.0f / 3.6f)));
+    put_u4(pvt + 64, (uint32_t)lroundf(fix->cog * 1e5f));
+    put_u2(pvt + 76, (uint16_t)lroundf(fix->dop_p * 100.0f));
+    return ubx_frame(out, GPS_UBX_CLASS_NAV, GPS_UBX_ID_NAV_PVT, pvt, sizeof(pvt));
+}
+
+static void on_pvt_sentence(const gps_t *data, void *arg)
+{
+    ubx_ctx_t *ctx = arg;
+    if (data->status == GPS_OKAY && data->sentence == GPS_SENTENCE_UBX_PVT) {
+        ctx->pvt++;
+    }
+    gps_epoch_add(&ctx->epoch, data, 0);
+}
+
+static void run_ubx(void *arg)
+{
+    ubx_ctx_t *ctx = arg;
+    feed_blocks(&ctx->stream, ctx->data, ctx->size, ctx->chunk);
+    gps_epoch_flush(&ctx->epoch);
+}
+
+static void start(ubx_ctx_t *ctx, const uint8_t *data, size_t size, size_t chunk)
+{
+    gps_parser_init(&ctx->parser);
+    gps_epoch_init(&ctx->epoch, 1000, NULL, NULL);
+    gps_stream_init(&ctx->stream, &ctx->parser, on_pvt_sentence, ctx);
+    ctx->data = data;
+    ctx->size = size;
+    ctx->chunk = chunk;
+    ctx->pvt = 0;
+}
+
+// a is decoded from the NAV-PVT, b from NMEA, whose epochs without RMC have no date
+static bool same_fix(const gps_t *a, const gps_t *b)
+{
+    return a->latitude_e7 == b->latitude_e7 && a->longitude_e7 == b->longitude_e7 && a->time_ms == b->time_ms &&
+           (b->date.year == 0 || a->utc_ms == b->utc_ms) && a->date.year == b->date.year && a->date.month == b->date.month && a->date.day == b->date.day;
+}
+
+// Date and time the receiver has not resolved yet, or that are out of range, must not be taken
+static void check_unresolved(void)
+{
+    static const struct {
+        const char *name;
+        uint8_t valid, month, day, hour;
+        uint32_t fields;
+    } cases[] = {
+        {"resolved", GPS_UBX_PVT_VALID_DATE | GPS_UBX_PVT_VALID_TIME, 4, 17, 12, GPS_FIELD_DATE | GPS_FIELD_TIME},
+        {"unresolved", 0, 4, 17, 12, 0},
+        {"time only", GPS_UBX_PVT_VALID_TIME, 4, 17, 12, GPS_FIELD_TIME},
+        {"month 13", GPS_UBX_PVT_VALID_DATE | GPS_UBX_PVT_VALID_TIME, 13, 17, 12, GPS_FIELD_TIME},
+        {"day 0", GPS_UBX_PVT_VALID_DATE | GPS_UBX_PVT_VALID_TIME, 4, 0, 12, GPS_FIELD_TIME},
+        {"hour 24", GPS_UBX_PVT_VALID_DATE | GPS_UBX_PVT_VALID_TIME, 4, 17, 24, GPS_FIELD_DATE},
+    };
+    static gps_parser_t parser;
+    uint8_t pvt[GPS_UBX_NAV_PVT_LENGTH] = {0};
+    uint8_t frame[NAV_PVT_FRAME];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        put_u2(pvt + 4, 2024);
+        pvt[6] = cases[i].month;
+        pvt[7] = cases[i].day;
+        pvt[8] = cases[i].hour;
+        pvt[11] = cases[i].valid;
+        pvt[20] = 3;
+        pvt[21] = 0x01;
+        size_t len = ubx_frame(frame, GPS_UBX_CLASS_NAV, GPS_UBX_ID_NAV_PVT, pvt, sizeof(pvt));
+        gps_parser_init(&parser);
+        if (gps_parser_parse_ubx(&parser, frame, len) != GPS_OKAY) {
+            fail("ubx: %s NAV-PVT not decoded", cases[i].name);
+            continue;
+        }
+        const gps_t *data = &parser.data;
+        uint32_t fields = data->fields & (GPS_FIELD_DATE | GPS_FIELD_TIME);
+        bool has_date = data->date.year != 0;
+        bool has_time = data->time_ms != 0;
+        if (fields != cases[i].fields || has_date != !!(cases[i].fields & GPS_FIELD_DATE) ||
+            has_time != !!(cases[i].fields & GPS_FIELD_TIME)) {
+            fail("ubx: %s NAV-PVT took date %u-%u-%u time %u ms, fields 0x%x", cases[i].name, data->date.year,
+                 data->date.month, data->date.day, data->time_ms, (unsigned)fields);
+        }
+    }
+}
+
+static void bench_corpus(const corpus_t *corpus)
+{
+    static gps_parser_t parser;
+    static ubx_ctx_t ctx;
+    // The NMEA epochs of the corpus that GGA or RMC timed
+    fix_list_t list = {.fields = GPS_FIELD_TIME};
+    const gps_stream_t *nmea = collect_fixes(corpus, &list);
+    size_t nmea_sentences = nmea->sentences;
+    uint32_t crc_errors = nmea->crc_errors;
+    if (list.count == 0) {
+        free(list.fixes);
+        return;
+    }
+
+    // NAV-PVT only
+    uint8_t *pvt = malloc(list.count * NAV_PVT_FRAME);
+    size_t pvt_size = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        size_t len = encode_pvt(pvt + pvt_size, &list.fixes[i].data);
+        gps_parser_init(&parser);
+        if (gps_parser_parse_ubx(&parser, pvt + pvt_size, len) != GPS_OKAY ||
+            !same_fix(&parser.data, &list.fixes[i].data)) {
+            fail("%s: NAV-PVT of epoch %zu decodes differently from its NMEA sentences", corpus->name, i);
+            list.count = i;
+            break;
+        }
+        pvt_size += len;
+    }
+
+    // NMEA with the epoch's NAV-PVT after every GGA, now and then followed by
+    // a long message or a copy with a broken checksum
+    static uint8_t long_payload[LONG_PAYLOAD];
+    uint8_t *mixed = malloc(corpus->size + pvt_size + list.count * (LONG_PAYLOAD + 2 * NAV_PVT_FRAME));
+    size_t mixed_size = 0, inserted = 0, broken = 0, skipped = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        const line_t *line = &corpus->lines[i];
+        memcpy(mixed + mixed_size, line->ptr, line->len);
+        mixed_size += line->len;
+        mixed[mixed_size++] = '\r';
+        mixed[mixed_size++] = '\n';
+        if (line->len < 6 || memcmp(line->ptr + 3, "GGA", 3) != 0 || inserted == list.count) {
+            continue;
+        }
+        memcpy(mixed + mixed_size, pvt + inserted * NAV_PVT_FRAME, NAV_PVT_FRAME);
+        mixed_size += NAV_PVT_FRAME;
+        if (inserted % 8 == 0) {
+            mixed_size += ubx_frame(mixed + mixed_size, GPS_UBX_CLASS_NAV, 0x35, long_payload, LONG_PAYLOAD);
+            skipped++;
+        }
+        if (inserted % 8 == 4) {
+            memcpy(mixed + mixed_size, pvt + inserted * NAV_PVT_FRAME, NAV_PVT_FRAME);
+            mixed[mixed_size + 30] ^= 0x40;
+            mixed_size += NAV_PVT_FRAME;
+            broken++;
+        }
+        inserted++;
+    }
+
+    // Every block size must see every frame of the mixed stream
+    static const size_t chunks[] = {1, 7, 120, 4096};
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        start(&ctx, mixed, mixed_size, chunks[c]);
+        run_ubx(&ctx);
+        if (ctx.pvt != inserted || ctx.stream.sentences != nmea_sentences + inserted + skipped ||
+            ctx.stream.crc_errors != crc_errors + broken) {
+            fail("%s: mixed stream in blocks of %zu: %u NAV-PVT of %zu, %u frames of %zu, %u checksum errors of %zu",
+                 corpus->name, chunks[c], ctx.pvt, inserted, ctx.stream.sentences, nmea_sentences + inserted + skipped,
+                 ctx.stream.crc_errors, crc_errors + broken);
+        }
+    }
+
+    // Cost per fix, NAV-PVT through the stream and the epoch assembler
+    start(&ctx, pvt, pvt_size, pvt_size);
+    double allocs = count_allocs(run_ubx, &ctx, list.count);
+    report(corpus->name, "ubx", list.count, measure(run_ubx, &ctx, list.count), allocs);
+    start(&ctx, mixed, mixed_size, mixed_size);
+    allocs = count_allocs(run_ubx, &ctx, list.count);
+    report(corpus->name, "mixed", list.count, measure(run_ubx, &ctx, list.count), allocs);
+
+    free(mixed);
+    free(pvt);
+    free(list.fixes);
+}
+
+void bench_ubx(const corpus_t *corpora, size_t count)
+{
+    check_unresolved();
+    for (size_t c = 0; c < count; c++) {
+        bench_corpus(&corpora[c]);
+    }
+}
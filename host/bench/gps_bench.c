@@ -0,0 +1,409 @@
+/* Throughput benchmark of the gps_parser component on the host.
+ *
+ * Every corpus is replayed through gps_parser_parse() line by line, grouped by
+ * sentence type, and through the streaming framer as one byte stream. Each
+ * measurement is the fastest of several repeats after a warm up pass. Noise
+ * from other processes only ever adds time, so the minimum is what keeps the
+ * numbers stable enough to compare against a saved baseline:
+ *
+ *   gps_bench --csv > baseline.csv
+ *   gps_bench --check baseline.csv --tolerance 15
+ *
+ * exits with status 1 when a row got slower than the tolerance allows or when
+ * the parser started to allocate. Sections that check correctness, like the
+ * snapshot stress run, exit with status 1 when the check fails.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "bench.h"
+
+#define MAX_ROWS (128)
+
+typedef struct {
+    char corpus[32];
+    char row[16];
+    size_t items;
+    double ns;
+    double allocs;
+} result_t;
+
+bench_opts_t opts = {
+    .repeats = 7,
+    .min_items = 200000,
+    .tolerance = 10.0,
+};
+
+static const struct {
+    const char *name;
+    void (*run)(const corpus_t *corpora, size_t count);
+} sections[] = {
+    {"parse", bench_parse},
+    {"chunked", bench_chunked},
+    {"scan", bench_scan},
+    {"coord", bench_coord},
+    {"ubx", bench_ubx},
+    {"fixlog", bench_fixlog},
+    {"stats", bench_stats},
+    {"time", bench_time},
+    {"dr", bench_dr},
+    {"fence", bench_fence},
+    {"gen", bench_gen},
+    {"bus", bench_bus},
+    {"snapshot", bench_snapshot},
+    {"overflow", bench_overflow},
+    {"cmd", bench_cmd},
+};
+
+static result_t results[MAX_ROWS];
+static size_t result_count;
+static int failures;
+
+/* Every heap allocation made by the process is counted, glibc lets malloc be
+ * interposed and routes its own internal allocations through it as well. */
+size_t alloc_count;
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    alloc_count++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+double measure(void (*fn)(void *ctx), void *ctx, size_t items)
+{
+    double best = 0.0;
+    size_t loops = items ? (opts.min_items + items - 1) / items : 1;
+
+    // Warm up caches, branch predictors and the CPU clock
+    for (size_t i = 0; i < loops; i++) {
+        fn(ctx);
+    }
+    for (int r = 0; r < opts.repeats; r++) {
+        double start = now_ns();
+        for (size_t i = 0; i < loops; i++) {
+            fn(ctx);
+        }
+        double ns = (now_ns() - start) / (double)(loops * (items ? items : 1));
+        if (r == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+double count_allocs(void (*fn)(void *ctx), void *ctx, size_t items)
+{
+    size_t before = alloc_count;
+    fn(ctx);
+    return items ? (double)(alloc_count - before) / items : 0.0;
+}
+
+void report(const char *corpus, const char *row, size_t items, double ns, double allocs)
+{
+    if (result_count < MAX_ROWS) {
+        result_t *r = &results[result_count++];
+        snprintf(r->corpus, sizeof(r->corpus), "%s", corpus);
+        snprintf(r->row, sizeof(r->row), "%s", row);
+        r->items = items;
+        r->ns = ns;
+        r->allocs = allocs;
+    }
+    if (opts.csv) {
+        printf("%s,%s,%zu,%.2f,%.0f,%.3f\n", corpus, row, items, ns, 1e9 / ns, allocs);
+    } else {
+        printf("%-18s %-8s %8zu %10.1f %12.0f %10.3f\n", corpus, row, items, ns, 1e9 / ns, allocs);
+    }
+}
+
+void report_no_alloc(const char *corpus, const char *row, size_t items, double ns, double allocs)
+{
+    report(corpus, row, items, ns, allocs);
+    if (allocs > 0) {
+        fail("%s %s: %.3f heap allocations per item, the parser must not allocate", corpus, row, allocs);
+    }
+}
+
+void note(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printf(opts.csv ? "# " : "  ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+void fail(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "FAILED ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    failures++;
+}
+
+gps_status_t parse_body(gps_parser_t *parser, const char *body)
+{
+    char sentence[96];
+    uint8_t checksum = 0;
+    for (const char *p = body; *p; p++) {
+        checksum ^= (uint8_t)*p;
+    }
+    int len = snprintf(sentence, sizeof(sentence), "$%s*%02X", body, checksum);
+    return gps_parser_parse(parser, sentence, len);
+}
+
+void feed_blocks(gps_stream_t *stream, const void *data, size_t size, size_t block)
+{
+    for (size_t off = 0; off < size; off += block) {
+        size_t n = size - off < block ? size - off : block;
+        gps_stream_feed(stream, (const uint8_t *)data + off, n);
+    }
+}
+
+void add_to_epoch(const gps_t *data, void *arg)
+{
+    gps_epoch_add(arg, data, 0);
+}
+
+void keep_fix(const gps_epoch_fix_t *fix, void *arg)
+{
+    fix_list_t *list = arg;
+    if (list->fields && !(fix->data.fields & list->fields)) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->fixes = realloc(list->fixes, list->capacity * sizeof(gps_epoch_fix_t));
+    }
+    list->fixes[list->count++] = *fix;
+}
+
+const gps_stream_t *collect_fixes(const corpus_t *corpus, fix_list_t *list)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    static gps_epoch_t epoch;
+
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, keep_fix, list);
+    gps_stream_init(&stream, &parser, add_to_epoch, &epoch);
+    gps_stream_feed(&stream, (const uint8_t *)corpus->data, corpus->size);
+    gps_epoch_flush(&epoch);
+    return &stream;
+}
+
+uint32_t bench_rng(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static bool load_corpus(const char *path, corpus_t *corpus)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    corpus->size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    corpus->data = malloc(corpus->size + 1);
+    if (fread(corpus->data, 1, corpus->size, f) != corpus->size) {
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    corpus->data[corpus->size] = '\0';
+
+    const char *slash = strrchr(path, '/');
+    corpus->name = slash ? slash + 1 : path;
+
+    size_t capacity = 1024;
+    corpus->lines = malloc(capacity * sizeof(line_t));
+    corpus->count = 0;
+    for (const char *p = corpus->data, *end = corpus->data + corpus->size; p < end;) {
+        const char *eol = memchr(p, '\n', end - p);
+        size_t len = (eol ? eol : end) - p;
+        while (len > 0 && p[len - 1] == '\r') {
+            len--;
+        }
+        if (len > 0) {
+            if (corpus->count == capacity) {
+                capacity *= 2;
+                corpus->lines = realloc(corpus->lines, capacity * sizeof(line_t));
+            }
+            corpus->lines[corpus->count].ptr = p;
+            corpus->lines[corpus->count].len = len > UINT16_MAX ? UINT16_MAX : len;
+            corpus->count++;
+        }
+        p = eol ? eol + 1 : end;
+    }
+    return true;
+}
+
+/* Compares the results with a CSV written by --csv, returns the number of
+ * regressions. */
+static int check_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int regressions = 0;
+
+    if (f == NULL) {
+        fprintf(stderr, "cannot open baseline %s\n", path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char corpus[32], row[16];
+        size_t items;
+        double ns, rate, allocs;
+        if (sscanf(line, "%31[^,],%15[^,],%zu,%lf,%lf,%lf", corpus, row, &items, &ns, &rate, &allocs) != 6) {
+            continue;
+        }
+        for (size_t i = 0; i < result_count; i++) {
+            const result_t *r = &results[i];
+            if (strcmp(r->corpus, corpus) != 0 || strcmp(r->row, row) != 0) {
+                continue;
+            }
+            if (r->ns > ns * (1.0 + opts.tolerance / 100.0)) {
+                fprintf(stderr, "REGRESSION %s %s: %.1f ns, baseline %.1f ns\n", corpus, row, r->ns, ns);
+                regressions++;
+            }
+            if (r->allocs > allocs) {
+                fprintf(stderr, "REGRESSION %s %s: %.3f allocs, baseline %.3f\n", corpus, row, r->allocs, allocs);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options] [corpus.nmea ...]\n"
+            "  -r N            repeats per measurement, the fastest is reported (default %d)\n"
+            "  -n N            sentences processed per repeat at least (default %zu)\n"
+            "  --csv           machine readable output\n"
+            "  --check FILE    compare against a --csv baseline, exit 1 on regression\n"
+            "  --tolerance P   allowed slowdown in percent for --check (default %.0f)\n"
+            "  -s NAME         run only this section, may be repeated\n"
+            "  -v              keep the parser's log output\n"
+            "sections:",
+            prog, opts.repeats, opts.min_items, opts.tolerance);
+    for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        fprintf(stderr, " %s", sections[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const char *default_corpora[] = {
+        GPS_CORPUS_DIR "/drive.nmea",
+        GPS_CORPUS_DIR "/gnss.nmea",
+        GPS_CORPUS_DIR "/crc_broken.nmea",
+        GPS_CORPUS_DIR "/truncated.nmea",
+    };
+    const char *paths[32];
+    size_t path_count = 0;
+    const char *selected[16];
+    size_t selected_count = 0;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            opts.repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            opts.min_items = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            opts.csv = true;
+        } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            opts.baseline = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            opts.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc && selected_count < 16) {
+            selected[selected_count++] = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else if (path_count < 32) {
+            paths[path_count++] = argv[i];
+        }
+    }
+    if (opts.repeats < 1) {
+        opts.repeats = 1;
+    }
+    if (path_count == 0) {
+        for (size_t i = 0; i < sizeof(default_corpora) / sizeof(default_corpora[0]); i++) {
+            paths[path_count++] = default_corpora[i];
+        }
+    }
+    if (!verbose) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+    }
+
+    if (opts.csv) {
+        printf("corpus,row,items,ns_per_item,items_per_sec,allocs_per_item\n");
+    } else {
+        printf("%-18s %-8s %8s %10s %12s %10s\n", "corpus", "row", "items", "ns/item", "items/s", "allocs");
+    }
+    corpus_t corpora[32];
+    for (size_t i = 0; i < path_count; i++) {
+        if (!load_corpus(paths[i], &corpora[i])) {
+            return 2;
+        }
+    }
+    for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        bool run = selected_count == 0;
+        for (size_t j = 0; j < selected_count; j++) {
+            run |= strcmp(selected[j], sections[i].name) == 0;
+        }
+        if (run) {
+            sections[i].run(corpora, path_count);
+        }
+    }
+    for (size_t i = 0; i < path_count; i++) {
+        free(corpora[i].lines);
+        free(corpora[i].data);
+    }
+
+    if (opts.baseline && check_baseline(opts.baseline)) {
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/* Compiles geofences into the index of gps_fence.h and replays NMEA logs
+ * against it:
+ *
+ *   gps_fence compile fences.csv fences.gpsfence
+ *   gps_fence events fences.gpsfence drive.nmea
+ *
+ * fences.csv holds one vertex per line as "id,latitude,longitude" in degrees,
+ * consecutive lines with the same id form one polygon, '#' starts a comment.
+ * The index is written as it is used, so it can be flashed to a data partition
+ * or embedded with EMBED_FILES and passed to gps_fence_load(). events prints
+ * the time of every fix that entered or left a fence, -m sets the margin in
+ * meters.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "gps_epoch.h"
+#include "gps_fence.h"
+#include "gps_stream.h"
+
+typedef struct {
+    gps_fence_polygon_t *polygons;
+    size_t count;
+    size_t capacity;
+    int32_t *vertices;
+    size_t vertex_count;
+    size_t vertex_capacity;
+} fence_list_t;
+
+typedef struct {
+    gps_fence_tracker_t tracker;
+    const gps_t *fix;
+} replay_ctx_t;
+
+static void *grow(void *data, size_t *capacity, size_t count, size_t item)
+{
+    if (count < *capacity) {
+        return data;
+    }
+    *capacity = *capacity ? *capacity * 2 : 256;
+    void *grown = realloc(data, *capacity * item);
+    if (grown == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return grown;
+}
+
+static bool read_fences(const char *path, fence_list_t *list)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    unsigned long id, last_id = 0;
+    double lat, lon;
+    int line_no = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (sscanf(line, "%lu , %lf , %lf", &id, &lat, &lon) != 3 || lat < -90 || lat > 90 || lon < -180 ||
+            lon > 180) {
+            fprintf(stderr, "%s:%d: expected id,latitude,longitude\n", path, line_no);
+            fclose(f);
+            return false;
+        }
+        if (list->count == 0 || id != last_id) {
+            list->polygons = grow(list->polygons, &list->capacity, list->count, sizeof(gps_fence_polygon_t));
+            list->polygons[list->count++] = (gps_fence_polygon_t){.id = id, .count = 0};
+            last_id = id;
+        }
+        list->vertices = grow(list->vertices, &list->vertex_capacity, list->vertex_count, 2 * sizeof(int32_t));
+        list->vertices[2 * list->vertex_count] = (int32_t)(lat * 1e7 + (lat < 0 ? -0.5 : 0.5));
+        list->vertices[2 * list->vertex_count + 1] = (int32_t)(lon * 1e7 + (lon < 0 ? -0.5 : 0.5));
+        list->vertex_count++;
+        list->polygons[list->count - 1].count++;
+    }
+    fclose(f);
+    // The vertex table may have moved while growing
+    size_t first = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        list->polygons[i].vertices = list->vertices + 2 * first;
+        first += list->polygons[i].count;
+    }
+    return true;
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0) {
+        perror(path);
+        if (f) {
+            fclose(f);
+        }
+        return NULL;
+    }
+    long end = ftell(f);
+    // malloc aligns for any type, the index needs 4 bytes
+    void *data = malloc(end > 0 ? end : 1);
+    rewind(f);
+    if (end < 0 || data == NULL || fread(data, 1, end, f) != (size_t)end) {
+        perror(path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *size = end;
+    return data;
+}
+
+static int compile(const char *in, const char *out)
+{
+    fence_list_t list = {0};
+    if (!read_fences(in, &list)) {
+        return 2;
+    }
+    size_t size = gps_fence_build(list.polygons, list.count, NULL, 0);
+    void *index = size ? malloc(size) : NULL;
+    if (index == NULL || gps_fence_build(list.polygons, list.count, index, size) != size) {
+        fprintf(stderr, "%s: every fence needs at least 3 vertices\n", in);
+        return 2;
+    }
+    FILE *f = fopen(out, "wb");
+    if (f == NULL || fwrite(index, 1, size, f) != size || fclose(f) != 0) {
+        perror(out);
+        return 2;
+    }
+    const gps_fence_index_t *header = index;
+    fprintf(stderr, "%zu fences, %zu vertices, %ux%u cells, %zu bytes\n", list.count, list.vertex_count,
+            header->rows, header->cols, size);
+    free(index);
+    free(list.polygons);
+    free(list.vertices);
+    return 0;
+}
+
+static void on_event(uint32_t id, bool inside, void *arg)
+{
+    const replay_ctx_t *ctx = arg;
+    const gps_t *fix = ctx->fix;
+    printf("%02u:%02u:%02u.%03u %s %lu at %.7f,%.7f\n", fix->tim.hour, fix->tim.minute, fix->time_ms / 1000 % 60,
+           fix->tim.thousand, inside ? "enter" : "leave", (unsigned long)id, fix->latitude_e7 / 1e7,
+           fix->longitude_e7 / 1e7);
+}
+
+static void on_fix(const gps_epoch_fix_t *fix, void *arg)
+{
+    replay_ctx_t *ctx = arg;
+    if ((fix->data.fields & GPS_FIELD_POSITION) && (fix->data.fix != GPS_FIX_INVALID || fix->data.valid)) {
+        ctx->fix = &fix->data;
+        gps_fence_check(&ctx->tracker, fix->data.latitude_e7, fix->data.longitude_e7);
+    }
+}
+
+static void on_sentence(const gps_t *data, void *arg)
+{
+    gps_epoch_add(arg, data, 0);
+}
+
+static int events(const char *fences, const char *log, float margin_m)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    static gps_epoch_t epoch;
+    static replay_ctx_t ctx;
+    size_t index_size, log_size;
+
+    void *data = read_file(fences, &index_size);
+    const gps_fence_index_t *index = data ? gps_fence_load(data, index_size) : NULL;
+    if (index == NULL) {
+        fprintf(stderr, "%s: not a fence index of version %d\n", fences, GPS_FENCE_VERSION);
+        free(data);
+        return 2;
+    }
+    uint8_t *nmea = read_file(log, &log_size);
+    uint32_t *inside = calloc(GPS_FENCE_WORDS(index->fence_count) + 1, sizeof(uint32_t));
+    if (nmea == NULL || inside == NULL) {
+        free(data);
+        free(nmea);
+        free(inside);
+        return 2;
+    }
+    gps_fence_tracker_init(&ctx.tracker, index, inside, margin_m, on_event, &ctx);
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, on_fix, &ctx);
+    gps_stream_init(&stream, &parser, on_sentence, &epoch);
+    gps_stream_feed(&stream, nmea, log_size);
+    gps_epoch_flush(&epoch);
+    fprintf(stderr, "%u fixes, %u events\n", epoch.published, ctx.tracker.events);
+    free(data);
+    free(nmea);
+    free(inside);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s compile fences.csv out.gpsfence\n"
+            "       %s [-m M] events fences.gpsfence log.nmea\n"
+            "  -m M    meters past the boundary before entering or leaving, default 5\n"
+            "  -v      keep the parser's log output\n",
+            prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *args[3] = {NULL};
+    int arg_count = 0;
+    float margin_m = 5.0f;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            margin_m = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] == '-' || arg_count == 3) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            args[arg_count++] = argv[i];
+        }
+    }
+    if (!verbose) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+    }
+    if (arg_count == 3 && strcmp(args[0], "compile") == 0) {
+        return compile(args[1], args[2]);
+    }
+    if (arg_count == 3 && strcmp(args[0], "events") == 0) {
+        return events(args[1], args[2], margin_m);
+    }
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,243 @@
+/* Conversion between NMEA logs and the binary fix log of gps_log.h:
+ *
+ *   gps_fixlog encode drive.nmea drive.gpslog
+ *   gps_fixlog csv drive.gpslog [out.csv]
+ *   gps_fixlog nmea drive.gpslog [out.nmea]
+ *
+ * encode assembles the epochs of an NMEA log and writes one record per epoch,
+ * then reports the size against the NMEA and the encoding speed. csv and nmea
+ * decode a fix log, nmea as one GGA and one RMC per record, to stdout when no
+ * output file is given. -b N sets the block size, which must be the one the
+ * log was written with.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "gps_epoch.h"
+#include "gps_log.h"
+#include "gps_stream.h"
+
+typedef struct {
+    gps_log_writer_t writer;
+    bool failed;
+} encode_ctx_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    uint8_t *data = NULL;
+    size_t capacity = 0;
+    *size = 0;
+    for (;;) {
+        if (*size == capacity) {
+            capacity = capacity ? capacity * 2 : 1 << 16;
+            uint8_t *grown = realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+                fclose(f);
+                return NULL;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + *size, 1, capacity - *size, f);
+        if (n == 0) {
+            break;
+        }
+        *size += n;
+    }
+    fclose(f);
+    return data;
+}
+
+static bool file_write(const uint8_t *data, size_t len, void *arg)
+{
+    return fwrite(data, 1, len, arg) == len;
+}
+
+static void on_fix(const gps_epoch_fix_t *fix, void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    ctx->failed |= !gps_log_write_fix(&ctx->writer, fix);
+}
+
+static void on_sentence(const gps_t *data, void *arg)
+{
+    gps_epoch_add(arg, data, 0);
+}
+
+static int encode(const char *in, const char *out, uint32_t block_size)
+{
+    static gps_parser_t parser;
+    static gps_stream_t stream;
+    static gps_epoch_t epoch;
+    static encode_ctx_t ctx;
+    size_t size;
+
+    uint8_t *data = read_file(in, &size);
+    if (data == NULL) {
+        perror(in);
+        return 2;
+    }
+    FILE *f = fopen(out, "wb");
+    if (f == NULL) {
+        perror(out);
+        free(data);
+        return 2;
+    }
+    double start = now_s();
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, on_fix, &ctx);
+    gps_stream_init(&stream, &parser, on_sentence, &epoch);
+    gps_log_writer_init(&ctx.writer, block_size, file_write, f);
+    gps_stream_feed(&stream, data, size);
+    gps_epoch_flush(&epoch);
+    double seconds = now_s() - start;
+    free(data);
+    if (fclose(f) != 0 || ctx.failed) {
+        perror(out);
+        return 2;
+    }
+    fprintf(stderr, "%u fixes, %zu bytes of NMEA to %u bytes, %.1f bytes per fix, %.1fx smaller, %.0f MB/s of NMEA\n",
+            ctx.writer.records, size, ctx.writer.bytes,
+            ctx.writer.records ? (double)ctx.writer.bytes / ctx.writer.records : 0.0,
+            ctx.writer.bytes ? (double)size / ctx.writer.bytes : 0.0, size / 1e6 / seconds);
+    return 0;
+}
+
+static void print_csv(FILE *f, const gps_log_record_t *rec)
+{
+    fprintf(f, "%04u-%02u-%02u,%u,%.7f,%.7f,%.1f,%.2f,%.2f,%.2f,%u,%u,%u,%u\n", rec->date.year, rec->date.month,
+            rec->date.day, rec->time_ms, rec->lat_e7 / 1e7, rec->lon_e7 / 1e7, rec->alt_dm / 10.0,
+            rec->speed_ckn / 100.0, rec->course_cdeg / 100.0, rec->hdop_c / 100.0, rec->fix, rec->fix_mode,
+            rec->valid, rec->sats);
+}
+
+// "ddmm.mmmmmmm" with 7 minute decimals, which decodes back to the same 1e-7 degrees
+static int put_coordinate(char *out, size_t size, int32_t e7, int degree_digits, char positive, char negative)
+{
+    uint32_t value = e7 < 0 ? -(uint32_t)e7 : (uint32_t)e7;
+    uint64_t minutes_e7 = (uint64_t)(value % 10000000u) * 60u;
+    return snprintf(out, size, "%0*u%02u.%07u,%c", degree_digits, value / 10000000u,
+                    (unsigned)(minutes_e7 / 10000000u), (unsigned)(minutes_e7 % 10000000u),
+                    e7 < 0 ? negative : positive);
+}
+
+static void put_sentence(FILE *f, const char *body)
+{
+    uint8_t checksum = 0;
+    for (const char *p = body; *p; p++) {
+        checksum ^= (uint8_t)*p;
+    }
+    fprintf(f, "$%s*%02X\r\n", body, checksum);
+}
+
+static void print_nmea(FILE *f, const gps_log_record_t *rec)
+{
+    uint32_t ms = rec->time_ms;
+    char time[16], lat[24], lon[24], body[128];
+
+    snprintf(time, sizeof(time), "%02u%02u%02u.%03u", ms / 3600000u, ms / 60000u % 60u, ms / 1000u % 60u,
+             ms % 1000u);
+    put_coordinate(lat, sizeof(lat), rec->lat_e7, 2, 'N', 'S');
+    put_coordinate(lon, sizeof(lon), rec->lon_e7, 3, 'E', 'W');
+    snprintf(body, sizeof(body), "GPGGA,%s,%s,%s,%u,%02u,%.2f,%.1f,M,,M,,", time, lat, lon, rec->fix, rec->sats,
+             rec->hdop_c / 100.0, rec->alt_dm / 10.0);
+    put_sentence(f, body);
+    snprintf(body, sizeof(body), "GPRMC,%s,%c,%s,%s,%.2f,%.2f,%02u%02u%02u,,,%c", time, rec->valid ? 'A' : 'V', lat,
+             lon, rec->speed_ckn / 100.0, rec->course_cdeg / 100.0, rec->date.day, rec->date.month,
+             rec->date.year % 100u, rec->valid ? 'A' : 'N');
+    put_sentence(f, body);
+}
+
+static int decode(const char *in, const char *out, uint32_t block_size, bool nmea)
+{
+    size_t size;
+    uint8_t *data = read_file(in, &size);
+    if (data == NULL) {
+        perror(in);
+        return 2;
+    }
+    FILE *f = out ? fopen(out, "w") : stdout;
+    if (f == NULL) {
+        perror(out);
+        free(data);
+        return 2;
+    }
+    if (!nmea) {
+        fprintf(f, "date,time_ms,lat,lon,alt,speed_kn,course,hdop,fix,fix_mode,valid,sats\n");
+    }
+    gps_log_reader_t reader;
+    gps_log_record_t rec;
+    gps_log_reader_init(&reader, data, size, block_size);
+    while (gps_log_read(&reader, &rec)) {
+        if (nmea) {
+            print_nmea(f, &rec);
+        } else {
+            print_csv(f, &rec);
+        }
+    }
+    free(data);
+    if (reader.bad_blocks) {
+        fprintf(stderr, "%u erased or corrupted blocks skipped\n", reader.bad_blocks);
+    }
+    if (f != stdout ? fclose(f) != 0 : fflush(f) != 0) {
+        perror(out ? out : "stdout");
+        return 2;
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-b N] encode log.nmea out.gpslog\n"
+            "       %s [-b N] csv log.gpslog [out.csv]\n"
+            "       %s [-b N] nmea log.gpslog [out.nmea]\n"
+            "  -b N    block size, default %u\n"
+            "  -v      keep the parser's log output\n",
+            prog, prog, prog, GPS_LOG_BLOCK_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    const char *args[3] = {NULL};
+    int arg_count = 0;
+    uint32_t block_size = GPS_LOG_BLOCK_SIZE;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            block_size = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] == '-' || arg_count == 3) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            args[arg_count++] = argv[i];
+        }
+    }
+    if (!verbose) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+    }
+    if (arg_count == 3 && strcmp(args[0], "encode") == 0) {
+        return encode(args[1], args[2], block_size);
+    }
+    if (arg_count >= 2 && (strcmp(args[0], "csv") == 0 || strcmp(args[0], "nmea") == 0)) {
+        return decode(args[1], args[2], block_size, strcmp(args[0], "nmea") == 0);
+    }
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,215 @@
+#include <math.h>
+#include <string.h>
+#include "gps_gen.h"
+
+#define METERS_PER_DEGREE (111320.0)
+
+static const uint8_t constellation_talkers[GPS_GEN_MAX_CONSTELLATIONS] = {
+    GPS_TALKER_GP, GPS_TALKER_GL, GPS_TALKER_GA, GPS_TALKER_GB,
+};
+// First PRN and PRN step of the satellites of each constellation
+static const uint8_t prn_first[GPS_GEN_MAX_CONSTELLATIONS] = {2, 65, 3, 6};
+static const uint8_t prn_step[GPS_GEN_MAX_CONSTELLATIONS] = {3, 2, 3, 4};
+
+static uint32_t next_random(gps_gen_t *gen)
+{
+    gen->rng = gen->rng * 1664525u + 1013904223u;
+    return gen->rng >> 8;
+}
+
+void gps_gen_default_config(gps_gen_config_t *config)
+{
+    *config = (gps_gen_config_t){
+        .rate_hz = 1,
+        .sentences = GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_GSA) |
+                     GPS_SENTENCE_BIT(GPS_SENTENCE_GSV) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC) |
+                     GPS_SENTENCE_BIT(GPS_SENTENCE_VTG),
+        .gsv_every = 1,
+        .talker = GPS_TALKER_GP,
+        .constellations = 1,
+        .sats = 8,
+        .start_utc_ms = 1713341112000LL, // 2024-04-17 08:05:12, like drive.nmea
+        .lat_e7 = 342478000,
+        .lon_e7 = 719264000,
+        .altitude = 353.9f,
+        .course = 50.5f,
+        .speed_mps = 13.9f,
+        .seed = 1,
+    };
+}
+
+void gps_gen_init(gps_gen_t *gen, const gps_gen_config_t *config)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->config = *config;
+    if (gen->config.rate_hz == 0 || gen->config.rate_hz > 100) {
+        gen->config.rate_hz = 1;
+    }
+    if (gen->config.gsv_every == 0) {
+        gen->config.gsv_every = 1;
+    }
+    if (gen->config.constellations == 0 || gen->config.constellations > GPS_GEN_MAX_CONSTELLATIONS) {
+        gen->config.constellations = 1;
+    }
+    if (gen->config.constellations * gen->config.sats > GPS_MAX_SATELLITES_IN_VIEW) {
+        gen->config.sats = GPS_MAX_SATELLITES_IN_VIEW / gen->config.constellations;
+    }
+    gen->lat = config->lat_e7 / 1e7;
+    gen->lon = config->lon_e7 / 1e7;
+    gen->course = config->course;
+    gen->utc_ms = config->start_utc_ms;
+    gen->rng = config->seed;
+}
+
+// Satellites slowly move across the sky, their signals are noisy
+static void update_sky(gps_gen_t *gen)
+{
+    gps_t *t = &gen->truth;
+    uint32_t minutes = (uint32_t)(gen->utc_ms / 60000);
+    uint8_t n = 0;
+
+    for (uint8_t c = 0; c < gen->config.constellations; c++) {
+        for (uint8_t s = 0; s < gen->config.sats; s++) {
+            gps_satellite_t *sat = &t->sats_desc_in_view[n++];
+            sat->num = prn_first[c] + s * prn_step[c];
+            sat->elevation = 5 + (s * 37 + c * 13) % 80;
+            sat->azimuth = (s * 83 + c * 47 + minutes) % 360;
+            sat->snr = 20 + next_random(gen) % 30;
+            sat->talker = constellation_talkers[c];
+        }
+    }
+    t->sats_in_view = n;
+    t->sats_in_use = n < GPS_MAX_SATELLITES_IN_USE ? n : GPS_MAX_SATELLITES_IN_USE;
+    memset(t->sats_id_in_use, 0, sizeof(t->sats_id_in_use));
+    for (uint8_t i = 0; i < t->sats_in_use; i++) {
+        t->sats_id_in_use[i] = t->sats_desc_in_view[i].num;
+    }
+    // More satellites, better geometry, in the 0.01 steps of the sentences
+    t->dop_h = roundf(100.0f * (0.5f + 4.0f / (t->sats_in_use + 1))) / 100.0f;
+    t->dop_v = roundf(100.0f * (0.7f + 5.0f / (t->sats_in_use + 1))) / 100.0f;
+    t->dop_p = roundf(100.0f * sqrtf(t->dop_h * t->dop_h + t->dop_v * t->dop_v)) / 100.0f;
+}
+
+static void fill_truth(gps_gen_t *gen)
+{
+    gps_t *t = &gen->truth;
+    // Sentences carry hundredths of a second
+    int64_t utc_ms = gen->utc_ms - gen->utc_ms % 10;
+    int32_t day = (int32_t)(utc_ms / 86400000);
+
+    t->utc_ms = utc_ms;
+    t->utc_day = day;
+    t->date_day = day;
+    t->time_ms = (uint32_t)(utc_ms - (int64_t)day * 86400000);
+    t->tim.hour = t->time_ms / 3600000;
+    t->tim.minute = t->time_ms / 60000 % 60;
+    t->tim.second = t->time_ms % 60000 / 1000.0f;
+    t->tim.thousand = t->time_ms % 1000;
+    gps_civil_from_days(day, &t->date);
+
+    t->latitude_e7 = (int32_t)lround(gen->lat * 1e7);
+    t->longitude_e7 = (int32_t)lround(gen->lon * 1e7);
+    t->latitude = (float)gen->lat;
+    t->longitude = (float)gen->lon;
+    t->altitude = gen->config.altitude;
+    t->fix = GPS_FIX_GPS;
+    t->fix_mode = GPS_MODE_3D;
+    t->mode = 'A';
+    t->valid = true;
+    t->speed = gen->config.speed_mps * 3600.0f / 1852.0f;
+    t->speedkmh = gen->config.speed_mps * 3.6f;
+    t->cog = (float)gen->course;
+    t->talker = gen->config.talker;
+}
+
+static void move(gps_gen_t *gen)
+{
+    const gps_gen_config_t *c = &gen->config;
+    double dt = 1.0 / c->rate_hz;
+    double turn = c->turn_dps;
+
+    if (c->weave_s > 0.0f) {
+        double elapsed = (gen->utc_ms - c->start_utc_ms) / 1000.0;
+        if ((int64_t)(elapsed / c->weave_s) % 2) {
+            turn = -turn;
+        }
+    }
+    gen->course = fmod(gen->course + turn * dt + 360.0, 360.0);
+    double north = c->speed_mps * dt * cos(gen->course * M_PI / 180.0);
+    double east = c->speed_mps * dt * sin(gen->course * M_PI / 180.0);
+    gen->lat += north / METERS_PER_DEGREE;
+    gen->lon += east / (METERS_PER_DEGREE * cos(gen->lat * M_PI / 180.0));
+    if (gen->lon >= 180.0) {
+        gen->lon -= 360.0;
+    } else if (gen->lon < -180.0) {
+        gen->lon += 360.0;
+    }
+    gen->utc_ms = c->start_utc_ms + (int64_t)(gen->stats.epochs + 1) * 1000 / c->rate_hz;
+}
+
+/* Copies the sentences in src[0..len) to out, damaging some of them. The
+ * address is left alone, a damaged sentence of a known type must still reach
+ * the checksum or framing check instead of being ignored. */
+static size_t emit(gps_gen_t *gen, const char *src, size_t len, char *out)
+{
+    char *p = out;
+    const char *end = src + len;
+
+    while (src < end) {
+        const char *eol = memchr(src, '\n', end - src) + 1;
+        size_t n = eol - src;
+        // "$GPGGA," up to the '*', "*hh\r\n" excluded
+        size_t body = n - 5;
+        uint32_t roll = next_random(gen) % 1000;
+        memcpy(p, src, n);
+        gen->stats.sentences++;
+        if (roll < gen->config.corrupt_permille) {
+            p[7 + next_random(gen) % (body - 7)] ^= 0x01;
+            gen->stats.corrupted++;
+        } else if (roll < gen->config.corrupt_permille + gen->config.truncate_permille) {
+            n = 7 + next_random(gen) % (body - 7);
+            p[n++] = '\r';
+            p[n++] = '\n';
+            gen->stats.truncated++;
+        }
+        p += n;
+        src = eol;
+    }
+    return p - out;
+}
+
+size_t gps_gen_epoch(gps_gen_t *gen, char *out, size_t size)
+{
+    static const uint8_t order[] = {GPS_SENTENCE_GGA, GPS_SENTENCE_GSA, GPS_SENTENCE_GSV, GPS_SENTENCE_RMC,
+                                    GPS_SENTENCE_VTG};
+    const gps_gen_config_t *c = &gen->config;
+    char group[GPS_ENCODE_MAX_GSV];
+    size_t len = 0;
+
+    if (size < GPS_GEN_MAX_EPOCH) {
+        return 0;
+    }
+    bool sky = gen->stats.epochs % c->gsv_every == 0;
+    if (sky) {
+        update_sky(gen);
+    }
+    fill_truth(gen);
+    for (size_t i = 0; i < sizeof(order); i++) {
+        if (!(c->sentences & GPS_SENTENCE_BIT(order[i]))) {
+            continue;
+        }
+        if (order[i] != GPS_SENTENCE_GSV) {
+            size_t n = gps_encode(&gen->truth, order[i], c->talker, group, sizeof(group));
+            len += emit(gen, group, n, out + len);
+            continue;
+        }
+        for (uint8_t k = 0; sky && k < c->constellations; k++) {
+            size_t n = gps_encode_gsv(&gen->truth, constellation_talkers[k], group, sizeof(group));
+            len += emit(gen, group, n, out + len);
+        }
+    }
+    move(gen);
+    gen->stats.epochs++;
+    gen->stats.bytes += len;
+    return len;
+}
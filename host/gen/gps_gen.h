@@ -0,0 +1,67 @@
+#pragma once
+
+/* Synthetic NMEA streams on the host. A vehicle moves along a trajectory of
+ * straight lines, circles or weaving turns and every epoch its true state is
+ * encoded with gps_encode.h into the configured sentences, with the satellites
+ * of up to four constellations in GSV groups. A share of the sentences can be
+ * damaged on the way, a flipped character fails the checksum and a cut
+ * sentence fails framing, both are counted so a consumer can be checked
+ * against exactly what was sent. The same seed produces the same stream. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gps_encode.h"
+
+#define GPS_GEN_MAX_CONSTELLATIONS (4) /*!< GP, GL, GA and GB */
+/* Largest output of gps_gen_epoch() */
+#define GPS_GEN_MAX_EPOCH          (4 * GPS_ENCODE_MAX_SENTENCE + GPS_GEN_MAX_CONSTELLATIONS * GPS_ENCODE_MAX_GSV)
+
+typedef struct {
+    uint16_t rate_hz;          /*!< Epochs per second, 1 to 100 */
+    uint32_t sentences;        /*!< GPS_SENTENCE_BIT() of GGA, GSA, RMC, VTG and GSV to send every epoch */
+    uint16_t gsv_every;        /*!< GSV groups only every this many epochs, receivers send them at 1 Hz */
+    gps_talker_t talker;       /*!< Talker of GGA, GSA, RMC and VTG, e.g. GPS_TALKER_GN for several constellations */
+    uint8_t constellations;    /*!< 1 to GPS_GEN_MAX_CONSTELLATIONS, each reports its own GSV group */
+    uint8_t sats;              /*!< Satellites in view per constellation, all of them together at most GPS_MAX_SATELLITES_IN_VIEW */
+    int64_t start_utc_ms;      /*!< UTC of the first epoch, ms since 1970-01-01 */
+    int32_t lat_e7;            /*!< Start position, 1e-7 degrees */
+    int32_t lon_e7;
+    float altitude;            /*!< Meters above mean sea level */
+    float course;              /*!< Initial course, degrees from north */
+    float speed_mps;           /*!< Ground speed, 0 for a receiver standing still */
+    float turn_dps;            /*!< Turn rate in degrees per second, positive to the right, 0 for a straight line */
+    float weave_s;             /*!< The turn changes direction every weave_s seconds, 0 to keep turning one way */
+    uint16_t corrupt_permille; /*!< Sentences with one character changed */
+    uint16_t truncate_permille; /*!< Sentences cut off before their checksum, ending in "\r\n" */
+    uint32_t seed;             /*!< Random state of satellite signals and damage */
+} gps_gen_config_t;
+
+typedef struct {
+    uint32_t epochs;    /*!< Epochs generated */
+    uint32_t sentences; /*!< Sentences sent, damaged ones included */
+    uint32_t corrupted; /*!< Sentences that fail their checksum */
+    uint32_t truncated; /*!< Sentences that fail framing */
+    uint64_t bytes;     /*!< Bytes generated */
+} gps_gen_stats_t;
+
+typedef struct {
+    gps_gen_config_t config;
+    gps_t truth;            /*!< State encoded by the last epoch, as the parser should decode it */
+    double lat;             /*!< Position in degrees, kept in double so slow motion is not rounded away */
+    double lon;
+    double course;
+    int64_t utc_ms;         /*!< UTC of the next epoch */
+    uint32_t rng;
+    gps_gen_stats_t stats;
+} gps_gen_t;
+
+/* 1 Hz GGA, GSA, RMC and VTG from GP with a GSV group of 8 satellites, 50 km/h
+ * in a straight line, nothing damaged. */
+void gps_gen_default_config(gps_gen_config_t *config);
+
+void gps_gen_init(gps_gen_t *gen, const gps_gen_config_t *config);
+
+/* Moves the vehicle to the next epoch and writes its sentences to out.
+ * Returns the bytes written, 0 when size is smaller than GPS_GEN_MAX_EPOCH. */
+size_t gps_gen_epoch(gps_gen_t *gen, char *out, size_t size);
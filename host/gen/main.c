@@ -0,0 +1,225 @@
+/* Writes a synthetic NMEA stream of gps_gen.h to a file, stdout or a
+ * pseudo-terminal that stands in for the receiver's UART:
+ *
+ *   gps_nmeagen -r 10 -c 4 -s 4 -t GN -d 600 -o drive10hz.nmea
+ *   gps_nmeagen -p -R -b 11520 -e 5
+ *
+ * With -p the slave device path is printed and anything that opens it as a
+ * serial port, e.g. an ESP-IDF Linux target build or a terminal program,
+ * reads the stream. -R sends the epochs in real time at their rate, -b limits
+ * the output to that many bytes per second like a UART of ten times the baud
+ * rate. Without either the stream is written as fast as possible.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "gps_gen.h"
+
+static const char *const talker_names[] = {"", "GP", "GL", "GA", "GB", "BD", "GQ", "GI", "GN"};
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_until(double deadline)
+{
+    double wait = deadline - now_s();
+    if (wait > 0) {
+        struct timespec ts = {.tv_sec = (time_t)wait, .tv_nsec = (long)((wait - (time_t)wait) * 1e9)};
+        nanosleep(&ts, NULL);
+    }
+}
+
+static bool write_all(int fd, const char *data, size_t n)
+{
+    while (n > 0) {
+        ssize_t written = write(fd, data, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        n -= written;
+    }
+    return true;
+}
+
+static int open_pty(void)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("pseudo-terminal");
+        return -1;
+    }
+    // Raw bytes, no echo or line editing on the way to the reader
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    fprintf(stderr, "serving NMEA on %s\n", ptsname(fd));
+    return fd;
+}
+
+static bool parse_talker(const char *name, gps_talker_t *talker)
+{
+    for (size_t i = 1; i < sizeof(talker_names) / sizeof(talker_names[0]); i++) {
+        if (strcmp(name, talker_names[i]) == 0) {
+            *talker = (gps_talker_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_sentences(const char *list, uint32_t *mask)
+{
+    static const char *const names[GPS_SENTENCE_MAX] = {
+        [GPS_SENTENCE_GGA] = "GGA", [GPS_SENTENCE_GSA] = "GSA", [GPS_SENTENCE_GSV] = "GSV",
+        [GPS_SENTENCE_RMC] = "RMC", [GPS_SENTENCE_VTG] = "VTG",
+    };
+    *mask = 0;
+    for (const char *p = list; *p;) {
+        size_t n = strcspn(p, ",");
+        int type = 0;
+        while (type < GPS_SENTENCE_MAX && (names[type] == NULL || strncmp(p, names[type], n) != 0 || n != 3)) {
+            type++;
+        }
+        if (type == GPS_SENTENCE_MAX) {
+            return false;
+        }
+        *mask |= GPS_SENTENCE_BIT(type);
+        p += n + (p[n] == ',');
+    }
+    return *mask != 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -r HZ     epochs per second, default 1\n"
+            "  -S LIST   sentences, default GGA,GSA,GSV,RMC,VTG\n"
+            "  -g N      GSV groups every N epochs, default 1\n"
+            "  -t ID     talker of the position sentences, GP, GL, GA, GB or GN, default GP\n"
+            "  -c N      constellations in view, 1 to 4, default 1\n"
+            "  -s N      satellites per constellation, default 8\n"
+            "  -v MPS    ground speed in m/s, default 13.9\n"
+            "  -T DPS    turn rate in degrees per second, default 0\n"
+            "  -w S      reverse the turn every S seconds, default never\n"
+            "  -e N      sentences per 1000 with a checksum error, default 0\n"
+            "  -x N      sentences per 1000 cut off, default 0\n"
+            "  -z SEED   random seed, default 1\n"
+            "  -d S      seconds of stream, default 60, 0 without end\n"
+            "  -R        send the epochs in real time\n"
+            "  -b BPS    at most BPS bytes per second\n"
+            "  -o FILE   write to FILE instead of stdout\n"
+            "  -p        write to a new pseudo-terminal and print its path\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    gps_gen_config_t config;
+    static gps_gen_t gen;
+    static char epoch[GPS_GEN_MAX_EPOCH];
+    double duration_s = 60, bytes_per_s = 0;
+    bool real_time = false, pty = false;
+    const char *path = NULL;
+
+    gps_gen_default_config(&config);
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-R") == 0) {
+            real_time = true;
+            continue;
+        }
+        if (strcmp(arg, "-p") == 0) {
+            pty = true;
+            continue;
+        }
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        switch (arg[1]) {
+            case 'r': config.rate_hz = atoi(value); break;
+            case 'g': config.gsv_every = atoi(value); break;
+            case 'c': config.constellations = atoi(value); break;
+            case 's': config.sats = atoi(value); break;
+            case 'v': config.speed_mps = strtof(value, NULL); break;
+            case 'T': config.turn_dps = strtof(value, NULL); break;
+            case 'w': config.weave_s = strtof(value, NULL); break;
+            case 'e': config.corrupt_permille = atoi(value); break;
+            case 'x': config.truncate_permille = atoi(value); break;
+            case 'z': config.seed = strtoul(value, NULL, 0); break;
+            case 'd': duration_s = strtod(value, NULL); break;
+            case 'b': bytes_per_s = strtod(value, NULL); break;
+            case 'o': path = value; break;
+            case 't':
+                if (!parse_talker(value, &config.talker)) {
+                    fprintf(stderr, "unknown talker %s\n", value);
+                    return 2;
+                }
+                break;
+            case 'S':
+                if (!parse_sentences(value, &config.sentences)) {
+                    fprintf(stderr, "expected sentences like GGA,RMC, not %s\n", value);
+                    return 2;
+                }
+                break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    int fd = STDOUT_FILENO;
+    if (pty) {
+        fd = open_pty();
+    } else if (path) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(path);
+        }
+    }
+    if (fd < 0) {
+        return 2;
+    }
+
+    gps_gen_init(&gen, &config);
+    uint64_t epochs = (uint64_t)(duration_s * gen.config.rate_hz);
+    double start = now_s();
+    while (duration_s == 0 || gen.stats.epochs < epochs) {
+        double deadline = start;
+        if (real_time) {
+            deadline += (double)gen.stats.epochs / gen.config.rate_hz;
+        }
+        if (bytes_per_s > 0 && start + gen.stats.bytes / bytes_per_s > deadline) {
+            deadline = start + gen.stats.bytes / bytes_per_s;
+        }
+        sleep_until(deadline);
+        size_t n = gps_gen_epoch(&gen, epoch, sizeof(epoch));
+        if (!write_all(fd, epoch, n)) {
+            perror(pty ? "pseudo-terminal" : path ? path : "stdout");
+            return 1;
+        }
+    }
+    fprintf(stderr, "%u epochs, %u sentences, %u with checksum errors, %u cut off, %llu bytes\n", gen.stats.epochs,
+            gen.stats.sentences, gen.stats.corrupted, gen.stats.truncated, (unsigned long long)gen.stats.bytes);
+    if (fd != STDOUT_FILENO) {
+        close(fd);
+    }
+    return 0;
+}
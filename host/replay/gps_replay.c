@@ -0,0 +1,302 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "gps_replay.h"
+#include "gps_epoch.h"
+#include "gps_stream.h"
+
+/* Chunks do not depend on the number of threads, so every thread count
+ * produces the same rows. Many more chunks than cores on large logs keep all
+ * cores busy until the end. */
+#define CHUNK_SIZE (1u << 20)
+
+typedef struct {
+    uint32_t time_ms;
+    int32_t lat_e7;
+    int32_t lon_e7;
+    float alt;
+    float speed;
+    uint8_t fix;
+} row_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    row_t *rows;
+    size_t count;
+    size_t capacity;
+    bool failed;
+    gps_stream_t stream;
+} chunk_t;
+
+typedef struct {
+    chunk_t *chunks;
+    size_t count;
+    atomic_size_t next;
+} work_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *next_line(const char *p, const char *end)
+{
+    const char *eol = memchr(p, '\n', end - p);
+    return eol ? eol + 1 : end;
+}
+
+/* The time field of a GGA or RMC line at p, NULL for any other line and for
+ * an empty time. Only these two open epochs. */
+static const char *time_field(const char *p, const char *end, size_t *len)
+{
+    if (end - p < 8 || p[0] != '$' || p[6] != ',' ||
+        (memcmp(p + 3, "GGA", 3) != 0 && memcmp(p + 3, "RMC", 3) != 0)) {
+        return NULL;
+    }
+    const char *field = p + 7;
+    const char *comma = memchr(field, ',', end - field);
+    *len = (comma ? comma : end) - field;
+    return *len ? field : NULL;
+}
+
+/* Moves a split point at the start of a line forward to the first line that
+ * opens a new epoch: a valid GGA or RMC whose time differs from the one
+ * before it. The epoch assembler closes the previous epoch at exactly this
+ * line, so a chunk starting there assembles the same epochs as a single
+ * pass. */
+static const char *epoch_start(const char *p, const char *end)
+{
+    static const uint32_t timed = GPS_SENTENCE_BIT(GPS_SENTENCE_GGA) | GPS_SENTENCE_BIT(GPS_SENTENCE_RMC);
+    gps_parser_t parser;
+    const char *first = NULL;
+    size_t first_len = 0;
+
+    gps_parser_init(&parser);
+    gps_parser_set_interest(&parser, timed, 0);
+    for (const char *next; p < end; p = next) {
+        next = next_line(p, end);
+        size_t line_len = next - p;
+        while (line_len > 0 && (p[line_len - 1] == '\n' || p[line_len - 1] == '\r')) {
+            line_len--;
+        }
+        size_t len;
+        const char *field = time_field(p, p + line_len, &len);
+        // A line with a broken checksum does not close the epoch
+        if (field == NULL || line_len > UINT16_MAX || gps_parser_parse(&parser, p, line_len) != GPS_OKAY) {
+            continue;
+        }
+        if (first == NULL) {
+            first = field;
+            first_len = len;
+        } else if (len != first_len || memcmp(field, first, len) != 0) {
+            return p;
+        }
+    }
+    return end;
+}
+
+static void on_fix(const gps_epoch_fix_t *fix, void *arg)
+{
+    chunk_t *chunk = arg;
+    const gps_t *data = &fix->data;
+
+    if (chunk->count == chunk->capacity) {
+        size_t capacity = chunk->capacity ? chunk->capacity * 2 : 4096;
+        row_t *rows = realloc(chunk->rows, capacity * sizeof(row_t));
+        if (rows == NULL) {
+            chunk->failed = true;
+            return;
+        }
+        chunk->rows = rows;
+        chunk->capacity = capacity;
+    }
+    row_t *row = &chunk->rows[chunk->count++];
+    row->time_ms = data->time_ms;
+    row->lat_e7 = data->latitude_e7;
+    row->lon_e7 = data->longitude_e7;
+    row->alt = data->altitude;
+    // VTG reports km/h, RMC only knots
+    row->speed = (fix->sentences & GPS_SENTENCE_BIT(GPS_SENTENCE_VTG)) ? data->speedkmh : data->speed * 1.852f;
+    row->fix = data->fix;
+}
+
+static void on_sentence(const gps_t *data, void *arg)
+{
+    gps_epoch_add(arg, data, 0);
+}
+
+static void parse_chunk(chunk_t *chunk)
+{
+    gps_parser_t parser;
+    gps_epoch_t epoch;
+
+    gps_parser_init(&parser);
+    gps_epoch_init(&epoch, 1000, on_fix, chunk);
+    gps_stream_init(&chunk->stream, &parser, on_sentence, &epoch);
+    gps_stream_feed(&chunk->stream, (const uint8_t *)chunk->data, chunk->size);
+    gps_epoch_flush(&epoch);
+}
+
+static void *worker(void *arg)
+{
+    work_t *work = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&work->next, 1);
+        if (i >= work->count) {
+            return NULL;
+        }
+        parse_chunk(&work->chunks[i]);
+    }
+}
+
+static bool merge(const chunk_t *chunks, size_t count, gps_columns_t *columns)
+{
+    size_t rows = 0;
+    for (size_t c = 0; c < count; c++) {
+        if (chunks[c].failed) {
+            return false;
+        }
+        rows += chunks[c].count;
+    }
+
+    memset(columns, 0, sizeof(gps_columns_t));
+    columns->time_ms = malloc(rows * sizeof(uint32_t) + 1);
+    columns->lat_e7 = malloc(rows * sizeof(int32_t) + 1);
+    columns->lon_e7 = malloc(rows * sizeof(int32_t) + 1);
+    columns->alt = malloc(rows * sizeof(float) + 1);
+    columns->speed = malloc(rows * sizeof(float) + 1);
+    columns->fix = malloc(rows + 1);
+    if (!columns->time_ms || !columns->lat_e7 || !columns->lon_e7 || !columns->alt || !columns->speed ||
+        !columns->fix) {
+        gps_columns_free(columns);
+        return false;
+    }
+    for (size_t c = 0; c < count; c++) {
+        for (size_t r = 0; r < chunks[c].count; r++) {
+            const row_t *row = &chunks[c].rows[r];
+            size_t i = columns->count++;
+            columns->time_ms[i] = row->time_ms;
+            columns->lat_e7[i] = row->lat_e7;
+            columns->lon_e7[i] = row->lon_e7;
+            columns->alt[i] = row->alt;
+            columns->speed[i] = row->speed;
+            columns->fix[i] = row->fix;
+        }
+    }
+    return true;
+}
+
+bool gps_replay_buffer(const char *data, size_t size, int threads, gps_columns_t *columns, gps_replay_stats_t *stats)
+{
+    double start = now_s();
+    const char *end = data + size;
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+
+    // Split points at the first epoch boundary after every CHUNK_SIZE bytes
+    size_t capacity = size / CHUNK_SIZE + 1;
+    chunk_t *chunks = calloc(capacity, sizeof(chunk_t));
+    if (chunks == NULL) {
+        return false;
+    }
+    size_t count = 0;
+    for (const char *p = data; p < end && count < capacity; count++) {
+        const char *split = end;
+        if (count + 1 < capacity && (size_t)(end - p) > CHUNK_SIZE) {
+            split = epoch_start(next_line(p + CHUNK_SIZE, end), end);
+        }
+        chunks[count].data = p;
+        chunks[count].size = split - p;
+        p = split;
+    }
+
+    work_t work = {.chunks = chunks, .count = count};
+    atomic_init(&work.next, 0);
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    if (ids != NULL) {
+        for (; started < threads - 1; started++) {
+            if (pthread_create(&ids[started], NULL, worker, &work) != 0) {
+                break;
+            }
+        }
+    }
+    // The calling thread works too, and alone when no thread could be started
+    worker(&work);
+    for (int t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+
+    bool ok = merge(chunks, count, columns);
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(gps_replay_stats_t));
+        stats->bytes = size;
+        stats->chunks = count;
+        stats->threads = started + 1;
+        for (size_t c = 0; c < count; c++) {
+            stats->sentences += chunks[c].stream.sentences;
+            stats->crc_errors += chunks[c].stream.crc_errors;
+            stats->framing_errors += chunks[c].stream.framing_errors;
+        }
+        stats->seconds = now_s() - start;
+    }
+    for (size_t c = 0; c < count; c++) {
+        free(chunks[c].rows);
+    }
+    free(chunks);
+    return ok;
+}
+
+bool gps_replay_file(const char *path, int threads, gps_columns_t *columns, gps_replay_stats_t *stats)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return gps_replay_buffer("", 0, threads, columns, stats);
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved;
+        return false;
+    }
+    // Every chunk is read front to back exactly once
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    bool ok = gps_replay_buffer(map, st.st_size, threads, columns, stats);
+    munmap(map, st.st_size);
+    return ok;
+}
+
+void gps_columns_free(gps_columns_t *columns)
+{
+    free(columns->time_ms);
+    free(columns->lat_e7);
+    free(columns->lon_e7);
+    free(columns->alt);
+    free(columns->speed);
+    free(columns->fix);
+    memset(columns, 0, sizeof(gps_columns_t));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+/* Offline replay of recorded NMEA logs on the host. A log is memory-mapped,
+ * split into chunks at epoch boundaries and the chunks are parsed in parallel
+ * by the gps_parser component, one gps_parser_t, gps_stream_t and
+ * gps_epoch_t per chunk. The fixes of all chunks are merged in log order into
+ * one column per value. Chunks do not depend on the number of threads, so any
+ * thread count produces the same columns. A chunk starts with a fresh parser,
+ * so a field that is empty in the first epoch of a chunk reads 0 where one
+ * parser over the whole log would still hold the value of an earlier epoch. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* One row per epoch, column by column. */
+typedef struct {
+    size_t count;       /*!< Rows in every column */
+    uint32_t *time_ms;  /*!< UTC time of the day, ms */
+    int32_t *lat_e7;    /*!< Latitude, 1e-7 degrees, north positive */
+    int32_t *lon_e7;    /*!< Longitude, 1e-7 degrees, east positive */
+    float *alt;         /*!< Altitude above mean sea level, m */
+    float *speed;       /*!< Ground speed, km/h */
+    uint8_t *fix;       /*!< gps_fix_t */
+} gps_columns_t;
+
+typedef struct {
+    size_t bytes;            /*!< Log size */
+    size_t chunks;           /*!< Chunks the log was split into */
+    int threads;             /*!< Worker threads used */
+    uint64_t sentences;      /*!< Sentences decoded */
+    uint64_t crc_errors;     /*!< Sentences dropped on checksum mismatch */
+    uint64_t framing_errors; /*!< Sentences dropped as truncated or malformed */
+    double seconds;          /*!< Wall time of splitting, parsing and merging */
+} gps_replay_stats_t;
+
+/* Replays size bytes of NMEA at data with threads worker threads, 0 for one
+ * per online core, into columns, which must be released with
+ * gps_columns_free(). stats may be NULL. Returns false when memory ran out. */
+bool gps_replay_buffer(const char *data, size_t size, int threads, gps_columns_t *columns, gps_replay_stats_t *stats);
+
+/* gps_replay_buffer() of the memory-mapped file at path. Returns false when
+ * the file cannot be mapped, errno tells why. */
+bool gps_replay_file(const char *path, int threads, gps_columns_t *columns, gps_replay_stats_t *stats);
+
+void gps_columns_free(gps_columns_t *columns);
@@ -0,0 +1,187 @@
+/* Batch replay of NMEA log files:
+ *
+ *   gps_replay [-j N] [-o DIR] [--csv FILE] drive.nmea
+ *
+ * parses the log on N threads, one per core by default, and reports the
+ * throughput. -o writes one raw little endian file per column into DIR
+ * (time_ms.u32, lat_e7.i32, lon_e7.i32, alt.f32, speed.f32, fix.u8), --csv
+ * writes the same rows as text. --scaling replays the log with 1, 2, 4, ...
+ * threads up to the number of cores, reports the speedup of each and exits
+ * with status 1 when any thread count produced different columns.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "gps_replay.h"
+
+static void print_stats(const gps_replay_stats_t *stats, size_t rows)
+{
+    fprintf(stderr, "%.1f MB in %.3f s, %.0f MB/s, %llu sentences, %zu fixes, %llu checksum and %llu framing errors, "
+                    "%zu chunks on %d threads\n",
+            stats->bytes / 1e6, stats->seconds, stats->bytes / 1e6 / stats->seconds,
+            (unsigned long long)stats->sentences, rows, (unsigned long long)stats->crc_errors,
+            (unsigned long long)stats->framing_errors, stats->chunks, stats->threads);
+}
+
+static bool write_column(const char *dir, const char *name, const void *data, size_t size)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+static bool write_columns(const char *dir, const gps_columns_t *columns)
+{
+    size_t n = columns->count;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        return false;
+    }
+    return write_column(dir, "time_ms.u32", columns->time_ms, n * sizeof(uint32_t)) &&
+           write_column(dir, "lat_e7.i32", columns->lat_e7, n * sizeof(int32_t)) &&
+           write_column(dir, "lon_e7.i32", columns->lon_e7, n * sizeof(int32_t)) &&
+           write_column(dir, "alt.f32", columns->alt, n * sizeof(float)) &&
+           write_column(dir, "speed.f32", columns->speed, n * sizeof(float)) &&
+           write_column(dir, "fix.u8", columns->fix, n);
+}
+
+static bool write_csv(const char *path, const gps_columns_t *columns)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+    fprintf(f, "time_ms,lat,lon,alt,speed,fix\n");
+    for (size_t i = 0; i < columns->count; i++) {
+        fprintf(f, "%u,%.7f,%.7f,%.1f,%.2f,%u\n", columns->time_ms[i], columns->lat_e7[i] / 1e7,
+                columns->lon_e7[i] / 1e7, columns->alt[i], columns->speed[i], columns->fix[i]);
+    }
+    return fclose(f) == 0;
+}
+
+static bool same_columns(const gps_columns_t *a, const gps_columns_t *b)
+{
+    size_t n = a->count;
+    return n == b->count && memcmp(a->time_ms, b->time_ms, n * sizeof(uint32_t)) == 0 &&
+           memcmp(a->lat_e7, b->lat_e7, n * sizeof(int32_t)) == 0 &&
+           memcmp(a->lon_e7, b->lon_e7, n * sizeof(int32_t)) == 0 &&
+           memcmp(a->alt, b->alt, n * sizeof(float)) == 0 && memcmp(a->speed, b->speed, n * sizeof(float)) == 0 &&
+           memcmp(a->fix, b->fix, n) == 0;
+}
+
+static int scaling(const char *path)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    gps_columns_t reference, columns;
+    gps_replay_stats_t stats;
+    double single = 0.0;
+    int status = 0;
+
+    if (!gps_replay_file(path, 1, &reference, &stats)) {
+        perror(path);
+        return 2;
+    }
+    long max = cores > 0 ? cores : 1;
+    for (long threads = 1;; threads *= 2) {
+        if (threads > max) {
+            threads = max;
+        }
+        if (!gps_replay_file(path, threads, &columns, &stats)) {
+            perror(path);
+            return 2;
+        }
+        if (threads == 1) {
+            single = stats.seconds;
+        }
+        printf("%3ld threads %8.0f MB/s  speedup %5.2f\n", threads, stats.bytes / 1e6 / stats.seconds,
+               single / stats.seconds);
+        if (!same_columns(&reference, &columns)) {
+            fprintf(stderr, "FAILED %ld threads produced different columns than 1 thread\n", threads);
+            status = 1;
+        }
+        gps_columns_free(&columns);
+        if (threads == max) {
+            break;
+        }
+    }
+    if (max == 1) {
+        printf("only one core online, no speedup to measure\n");
+    }
+    gps_columns_free(&reference);
+    return status;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options] log.nmea\n"
+            "  -j N          worker threads, default one per online core\n"
+            "  -o DIR        write one raw little endian file per column into DIR\n"
+            "  --csv FILE    write the rows as CSV\n"
+            "  --scaling     replay with 1, 2, 4, ... threads and compare the results\n"
+            "  -v            keep the parser's log output\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL, *dir = NULL, *csv = NULL;
+    bool scale = false, verbose = false;
+    int threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv = argv[++i];
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scale = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] == '-' || path != NULL) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == NULL) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!verbose) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+    }
+    if (scale) {
+        return scaling(path);
+    }
+
+    gps_columns_t columns;
+    gps_replay_stats_t stats;
+    if (!gps_replay_file(path, threads, &columns, &stats)) {
+        perror(path);
+        return 2;
+    }
+    print_stats(&stats, columns.count);
+    int status = 0;
+    if (dir != NULL && !write_columns(dir, &columns)) {
+        perror(dir);
+        status = 2;
+    }
+    if (csv != NULL && !write_csv(csv, &columns)) {
+        perror(csv);
+        status = 2;
+    }
+    gps_columns_free(&columns);
+    return status;
+}
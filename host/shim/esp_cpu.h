@@ -0,0 +1,26 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's esp_cpu.h. The time stamp counter stands in
+ * for the CPU cycle counter, other architectures count nanoseconds. */
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return (esp_cpu_cycle_count_t)__rdtsc();
+}
+#else
+#include <time.h>
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#endif
@@ -0,0 +1,29 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include "esp_log.h"
+
+esp_log_level_t esp_log_host_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    esp_log_host_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    (void)level;
+    (void)tag;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/* Host stand-in for the generated sdkconfig.h. Options default to the values
+ * in the components' Kconfig files and can be overridden with -D. */
+
+#ifndef CONFIG_GPS_PARSER_LOG_LEVEL
+#define CONFIG_GPS_PARSER_LOG_LEVEL 1
+#endif
+
+#ifndef CONFIG_GPS_PARSER_MAX_SATELLITES_IN_VIEW
+#define CONFIG_GPS_PARSER_MAX_SATELLITES_IN_VIEW 16
+#endif
+
+#ifndef CONFIG_GPS_PARSER_UTC_OFFSET
+#define CONFIG_GPS_PARSER_UTC_OFFSET 300
+#endif
+
+#ifndef CONFIG_GPS_PARSER_TRACE
+#define CONFIG_GPS_PARSER_TRACE 0
+#endif
+
+#ifndef CONFIG_GPS_PARSER_TRACE_DEPTH
+#define CONFIG_GPS_PARSER_TRACE_DEPTH 64
+#endif
+
+#ifndef CONFIG_GPS_PARSER_STATS
+#define CONFIG_GPS_PARSER_STATS 1
+#endif
+
+#ifndef CONFIG_GPS_PARSER_BUS_SUBSCRIBERS
+#define CONFIG_GPS_PARSER_BUS_SUBSCRIBERS 16
+#endif
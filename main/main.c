@@ -1,6 +1,16 @@
 #include "gps_uart.h"
 
+static const char *TAG = "main";
+
+static void on_fix_change(const gps_bus_msg_t *msg, void *arg)
+{
+    ESP_LOGI(TAG, "fix %s at %lu ms of the day", msg->topic == GPS_EVENT_FIX_LOST ? "lost" : "acquired",
+             (unsigned long)msg->data->time_ms);
+}
+
 void app_main(void)
 {
     uart_init();
+    gps_uart_subscribe(GPS_EVENT_FIX_ACQUIRED, on_fix_change, NULL);
+    gps_uart_subscribe(GPS_EVENT_FIX_LOST, on_fix_change, NULL);
 }